@@ -7,28 +7,30 @@
 #include "emulator_config.h"
 
 void AudioCoprocessor::ram_write(uint16_t address, uint8_t value) {
+	CatchUp();
 	state.ram[address & 0xFFF] = value;
 }
 
 uint8_t AudioCoprocessor::ram_read(uint16_t address) {
+	CatchUp();
 	return state.ram[address & 0xFFF];
 }
 
 void AudioCoprocessor::register_write(uint16_t address, uint8_t value) {
     //printf("audio register %x written with %x\n", (address), value);
+	CatchUp();
 	switch(address & 7) {
 		case ACP_RESET:
 			state.resetting = true;
             state.irqCounter = 255;
             break;
 		case ACP_NMI:
-            SDL_LockAudioDevice(state.device);
+            state.monitor.NMI();
             state.cpu->NMI();
-            state.cpu->Run(state.cycles_per_sample, state.cycle_counter);
+            run_acp(last_updated_cycle * state.clkMult);
 #ifdef WRAPPER_MODE
-            state.cpu->Run(state.cycles_per_sample, state.cycle_counter);
+            run_acp(last_updated_cycle * state.clkMult);
 #endif
-            SDL_UnlockAudioDevice(state.device);
 			break;
 		case ACP_RATE:
 			state.irqRate = (((value << 1) & 0xFE) | (value & 1));
@@ -40,43 +42,130 @@ void AudioCoprocessor::register_write(uint16_t address, uint8_t value) {
 	}
 }
 
+//Run the ACP for one sample period starting at the given ACP clock
+void AudioCoprocessor::run_acp(uint64_t acp_clock) {
+    state.run_clock_base = acp_clock - state.cycle_counter;
+    state.cpu->Run(state.cycles_per_sample, state.cycle_counter);
+}
+
+//Move finished samples out of the band-limited synth into the playback buffer
+void AudioCoprocessor::flush_samples() {
+    int16_t chunk[256];
+    state.dac_blip->EndFrame(last_updated_cycle * state.clkMult);
+    while(state.dac_blip->SamplesAvailable() >= 256) {
+        size_t count = state.dac_blip->ReadSamples(chunk, 256);
+        if(state.capture != NULL) {
+            state.capture->Write(chunk, count);
+            continue;
+        }
+        if(state.samples == NULL) {
+            //capture finished and there's no sound card to play to
+            continue;
+        }
+        for(size_t i = 0; i < count; ++i) {
+            if(!state.samples->push(chunk[i])) {
+                ++state.overruns;
+            }
+        }
+    }
+}
+
+//Step the ACP up to the main CPU's current cycle count.
+//The IRQ timer counts system clocks, the ACP itself runs clkMult times faster.
+void AudioCoprocessor::CatchUp() {
+    uint64_t now = timekeeper->totalCyclesCount;
+    if(now <= last_updated_cycle) {
+        return;
+    }
+    uint64_t clock = last_updated_cycle;
+
+    while(clock < now) {
+        uint64_t step = (state.irqCounter < 0) ? 1 : (state.irqCounter + 1);
+        if(step > (now - clock)) {
+            step = now - clock;
+        }
+        clock += step;
+        state.irqCounter -= step;
+
+        if(state.irqCounter < 0) {
+            if(state.resetting) {
+                state.resetting = false;
+                state.cpu->Reset();
+                state.monitor.CPUReset();
+                state.cpu->cycleProfile = NULL;
+            }
+            state.irqCounter += state.irqRate;
+            state.cycle_counter = 0;
+            if(state.running) {
+                state.monitor.Tick(clock * state.clkMult, state.cycles_per_sample, !(state.cpu->status & INTERRUPT));
+                state.cpu->cycleProfile = state.monitor.ActiveProfile();
+                state.cpu->IRQ();
+                state.cpu->ClearIRQ();
+                run_acp(clock * state.clkMult);
+            }
+        }
+    }
+    last_updated_cycle = now;
+
+    if(state.dac_blip != NULL) {
+        flush_samples();
+    }
+}
+
 void AudioCoprocessor::fill_audio(void *udata, uint8_t *stream, int len) {
     ACPState *state = (ACPState*) udata;
-    uint16_t *stream16 = (uint16_t*) stream;
+    int16_t *stream16 = (int16_t*) stream;
+    int count = len/sizeof(int16_t);
 
-    // If emulation is paused, just fill buffer with zeroes without advancing the apu
+    // If emulation is paused, just fill buffer with zeroes without consuming samples
     if (state->isEmulationPaused) {
-	for(int i = 0; i < len/sizeof(uint16_t); i++) {
-	    if(stream16 != NULL) {
-		stream16[i] = 0;
-	    }
-	}
-
-	return;
+        for(int i = 0; i < count; i++) {
+            stream16[i] = 0;
+        }
+        return;
     }
 
-    for(int i = 0; i < len/sizeof(uint16_t); i++) {
-        if(stream16 != NULL) {
-            stream16[i] = state->dacReg;
-            stream16[i] -= 128;
-            stream16[i] *= state->volume;
-            stream16[i] *= state->isMuted ? 0 : 1;
-        }
-        state->irqCounter -= state->clksPerHostSample;
-        if(state->irqCounter < 0) {
-            if(state->resetting) {
-                state->resetting = false;
-                state->cpu->Reset();
+    //Nudge playback speed so the buffer hovers around target_fill,
+    //absorbing drift between the emulated clock and the sound card's clock
+    size_t fill = state->samples->size();
+    if(state->priming) {
+        if(fill >= state->target_fill) {
+            state->priming = false;
+        } else {
+            for(int i = 0; i < count; i++) {
+                stream16[i] = 0;
             }
-            state->irqCounter += state->irqRate;
-            state->cycle_counter = 0;
-            if(state->running) {
-                state->cpu->IRQ();
-                state->cpu->ClearIRQ();
-                state->cpu->Run(state->cycles_per_sample, state->cycle_counter);
+            state->buffer_fill = fill;
+            return;
+        }
+    }
+    double error = ((double) fill - (double) state->target_fill) / (double) state->target_fill;
+    if(error > 1.0) error = 1.0;
+    if(error < -1.0) error = -1.0;
+    double desired_ratio = 1.0 + (ACP_RATE_CONTROL_RANGE * error);
+    state->playback_ratio += (desired_ratio - state->playback_ratio) * 0.1;
+
+    int gain = state->isMuted ? 0 : state->volume;
+    bool starved = false;
+    for(int i = 0; i < count; i++) {
+        while(state->resample_pos >= 1.0) {
+            state->resample_prev = state->resample_next;
+            if(!state->samples->pop(state->resample_next)) {
+                //hold the last level instead of snapping to zero
+                ++state->underrun_samples;
+                starved = true;
             }
+            state->resample_pos -= 1.0;
         }
+        double level = state->resample_prev + (state->resample_next - state->resample_prev) * state->resample_pos;
+        stream16[i] = (int16_t) (((int32_t) level * gain) >> 8);
+        state->resample_pos += state->playback_ratio;
     }
+    if(starved) {
+        ++state->underruns;
+        state->priming = true;
+    }
+    state->buffer_fill = state->samples->size();
 }
 
 ACPState* AudioCoprocessor::singleton_acp_state;
@@ -85,19 +174,23 @@ uint8_t ACP_MemoryRead(uint16_t address) {
     return AudioCoprocessor::singleton_acp_state->ram[address & 0xFFF];
 }
 
-uint8_t ACP_CPUSync(uint16_t address) {
-    uint8_t opcode = ACP_MemoryRead(address);
-    if(opcode == 0x40) {
-        //If opcode is ReTurn from Interrupt
-        AudioCoprocessor::singleton_acp_state->last_irq_cycles = AudioCoprocessor::singleton_acp_state->cycle_counter;
-    }
-    return opcode;
+//Called by the core as RTI executes
+void ACP_CPUReturned() {
+    ACPState* state = AudioCoprocessor::singleton_acp_state;
+    state->last_irq_cycles = state->cycle_counter;
+    state->monitor.Return(state->run_clock_base + state->cycle_counter);
+    state->cpu->cycleProfile = state->monitor.ActiveProfile();
 }
 
+//RAM writes are handled inside the core, this only sees the DAC latch at 0x8000 and up
 void ACP_MemoryWrite(uint16_t address, uint8_t value) {
-    AudioCoprocessor::singleton_acp_state->ram[address & 0xFFF] = value;
+    ACPState* state = AudioCoprocessor::singleton_acp_state;
+    state->ram[address & 0xFFF] = value;
     if(address & 0x8000) {
-        AudioCoprocessor::singleton_acp_state->dacReg = value;
+        if((state->dac_blip != NULL) && (value != state->dacReg)) {
+            state->dac_blip->AddDelta(state->run_clock_base + state->cycle_counter, (int32_t) value - (int32_t) state->dacReg);
+        }
+        state->dacReg = value;
     }
 }
 
@@ -128,7 +221,7 @@ void AudioCoprocessor::StartAudio() {
     SDL_AudioSpec wanted, obtained;
 
     /* Set the audio format */
-    wanted.freq = 44100;
+    wanted.freq = EmulatorConfig::sampleRate;
     wanted.format = AUDIO_S16SYS;
     wanted.channels = 1;    /* 1 = mono, 2 = stereo */
     wanted.samples = 512;  /* Good low-latency value for callback */
@@ -146,22 +239,80 @@ void AudioCoprocessor::StartAudio() {
         printf("Opened audio device:\n\tFreq: %d\n\tFormat %s\n\tChannels: %d\n\tSamples: %d\n",
             obtained.freq, AudioFormatString(obtained.format), obtained.channels, obtained.samples);
         state.format = obtained.format;
+        state.host_freq = obtained.freq;
+        state.target_fill = obtained.freq / 30;
+        if(state.target_fill < (2 * obtained.samples)) {
+            state.target_fill = 2 * obtained.samples;
+        }
+        state.samples = new ACPSampleBuffer();
+        state.dac_blip = new BlipBuffer(ACP_SAMPLE_BUFFER_SIZE / 2);
+        state.dac_blip->SetRates((double) timekeeper->system_clock * state.clkMult, obtained.freq);
+        state.dac_blip->Clear(last_updated_cycle * state.clkMult);
         SDL_PauseAudioDevice(state.device, 0);
+    }
+}
 
-        state.clksPerHostSample = 315000000 / (88 * obtained.freq);
+//Send ACP output to a .wav file instead of the sound card
+bool AudioCoprocessor::StartCapture(const char* filename) {
+    state.capture = new WavWriter(filename, state.host_freq);
+    if(!state.capture->IsOpen()) {
+        delete state.capture;
+        state.capture = NULL;
+        return false;
+    }
+    if(state.dac_blip == NULL) {
+        state.dac_blip = new BlipBuffer(ACP_SAMPLE_BUFFER_SIZE / 2);
+        state.dac_blip->SetRates((double) timekeeper->system_clock * state.clkMult, state.host_freq);
+        state.dac_blip->Clear(last_updated_cycle * state.clkMult);
     }
+    return true;
 }
 
-AudioCoprocessor::AudioCoprocessor() {
+void AudioCoprocessor::StopCapture() {
+    if(state.capture == NULL) return;
+    int16_t chunk[256];
+    CatchUp();
+    state.dac_blip->EndFrame(last_updated_cycle * state.clkMult);
+    while(state.dac_blip->SamplesAvailable() > 0) {
+        size_t count = state.dac_blip->ReadSamples(chunk, 256);
+        state.capture->Write(chunk, count);
+    }
+    state.capture->Close();
+    printf("Wrote %llu samples at %d Hz\n", (unsigned long long) state.capture->SamplesWritten(), state.host_freq);
+    delete state.capture;
+    state.capture = NULL;
+}
+
+AudioCoprocessor::AudioCoprocessor(Timekeeper* timekeeper) : timekeeper(timekeeper) {
 	AudioCoprocessor::singleton_acp_state = &state;
 
-    state.cpu = new mos6502(ACP_MemoryRead, ACP_MemoryWrite, ACP_CPUStopped, ACP_CPUSync);
+    state.cpu = new mos6502(ACP_MemoryRead, ACP_MemoryWrite, ACP_CPUStopped);
+    state.cpu->SetFlatMemory(state.ram, AUDIO_RAM_SIZE - 1, 0x8000);
+    state.cpu->idleSkip = true;
+    state.cpu->cycleProfileMask = AUDIO_RAM_SIZE - 1;
+    state.cpu->Returned = ACP_CPUReturned;
 
     state.irqCounter = 0;
     state.irqRate = 0;
     state.resetting = false;
     state.running = false;
-    state.clksPerHostSample = 0;
+    state.host_freq = EmulatorConfig::sampleRate;
+    state.dac_blip = NULL;
+    state.capture = NULL;
+    state.run_clock_base = 0;
+    state.dacReg = 128;
+    state.cycle_counter = 0;
+    state.samples = NULL;
+    state.target_fill = 0;
+    state.resample_pos = 0;
+    state.resample_prev = 0;
+    state.resample_next = 0;
+    state.playback_ratio = 1.0;
+    state.priming = true;
+    state.buffer_fill = 0;
+    state.underruns = 0;
+    state.underrun_samples = 0;
+    state.overruns = 0;
     state.cycles_per_sample = 1024;
     state.last_irq_cycles = 0;
     state.volume = 256;
@@ -169,10 +320,6 @@ AudioCoprocessor::AudioCoprocessor() {
     state.isEmulationPaused = false;
     state.clkMult = 4;
 
-	for(int i = 0; i < AUDIO_RAM_SIZE; i ++) {
-		state.ram[i] = rand() % 256;
-	}
-
     if(!EmulatorConfig::noSound) {
         StartAudio();
     }
@@ -186,6 +333,66 @@ void AudioCoprocessor::dump_ram(const char* filename) {
     dumpfile.close();
 }
 
+//Power-on contents of the audio RAM
+void AudioCoprocessor::RandomizeMemory(Rng& rng) {
+	for(int i = 0; i < AUDIO_RAM_SIZE; i ++) {
+		state.ram[i] = rng.NextByte();
+	}
+}
+
+bool AudioCoprocessor::write_budget_report(const char* filename) {
+    CatchUp();
+    return state.monitor.WriteJSON(filename);
+}
+
+void AudioCoprocessor::SaveState(StateWriter& writer) {
+    CatchUp();
+    writer.Section("ACP ");
+    writer.Put(state.ram);
+    writer.Put(state.irqCounter);
+    writer.Put(state.irqRate);
+    writer.Put(state.running);
+    writer.Put(state.resetting);
+    writer.Put(state.dacReg);
+    writer.Put(state.cycles_per_sample);
+    writer.Put(state.clkMult);
+    writer.Put(state.last_irq_cycles);
+    writer.Put(state.cycle_counter);
+    writer.Put(state.run_clock_base);
+    writer.Put(last_updated_cycle);
+    writer.Put(state.cpu->GetState());
+}
+
+bool AudioCoprocessor::LoadState(StateReader& reader) {
+    mos6502State cpuState;
+    reader.Section("ACP ");
+    reader.Get(state.ram);
+    reader.Get(state.irqCounter);
+    reader.Get(state.irqRate);
+    reader.Get(state.running);
+    reader.Get(state.resetting);
+    reader.Get(state.dacReg);
+    reader.Get(state.cycles_per_sample);
+    reader.Get(state.clkMult);
+    reader.Get(state.last_irq_cycles);
+    reader.Get(state.cycle_counter);
+    reader.Get(state.run_clock_base);
+    reader.Get(last_updated_cycle);
+    reader.Get(cpuState);
+    if(!reader.Ok()) {
+        return false;
+    }
+    state.cpu->SetState(cpuState, NULL);
+    state.cpu->cycleProfile = NULL;
+    state.monitor.CPUReset();
+    if(state.dac_blip != NULL) {
+        //samples not yet handed to the host belong to the old timeline
+        state.dac_blip->Clear(last_updated_cycle * state.clkMult);
+        state.dac_blip->SetLevel((int32_t) state.dacReg - 128);
+    }
+    return true;
+}
+
 uint16_t AudioCoprocessor::get_irq_cycle_count() {
     return state.last_irq_cycles;
 }
@@ -1,7 +1,15 @@
+#pragma once
 using namespace std;
 
 #include "mos6502/mos6502.h"
 #include "SDL_inc.h"
+#include "timekeeper.h"
+#include "ring_buffer.h"
+#include "blip_buffer.h"
+#include "wav_writer.h"
+#include "devtools/acp_monitor.h"
+#include "savestate.h"
+#include "rng.h"
 
 #define ACP_RESET 0
 #define ACP_NMI 1
@@ -9,6 +17,13 @@ using namespace std;
 
 #define AUDIO_RAM_SIZE 4096
 
+//Samples waiting between the emulation thread and the SDL audio callback
+#define ACP_SAMPLE_BUFFER_SIZE 16384
+//Max deviation from 1:1 playback used to steer the buffer fill level
+#define ACP_RATE_CONTROL_RANGE 0.005
+
+typedef RingBuffer<int16_t, ACP_SAMPLE_BUFFER_SIZE> ACPSampleBuffer;
+
 typedef struct ACPState {
 	uint8_t ram[AUDIO_RAM_SIZE];
 	mos6502 *cpu;
@@ -17,7 +32,6 @@ typedef struct ACPState {
 	bool running;
     bool resetting;
     uint8_t dacReg;
-    uint16_t clksPerHostSample;
     uint64_t cycles_per_sample;
 	uint8_t clkMult;
 	SDL_AudioFormat format;
@@ -27,21 +41,51 @@ typedef struct ACPState {
 	int volume;
 	bool isMuted;
 	bool isEmulationPaused;
+
+	//host output, produced on the emulation thread and drained by fill_audio
+	int host_freq;
+	BlipBuffer *dac_blip;
+	uint64_t run_clock_base; //ACP clock at which cycle_counter was zero
+	ACPSampleBuffer *samples;
+	WavWriter *capture;
+	uint32_t target_fill;
+	double resample_pos;
+	int16_t resample_prev;
+	int16_t resample_next;
+	double playback_ratio;
+	bool priming;
+	uint32_t buffer_fill;
+	uint64_t underruns;
+	uint64_t underrun_samples;
+	uint64_t overruns;
+
+	ACPMonitor monitor;
 } ACPState;
 
 class AudioCoprocessor {
 private:
 	//emulated registers/memory
 	ACPState state;
+	Timekeeper* timekeeper;
+	uint64_t last_updated_cycle = 0;
 	void capture_snapshot();
+	void run_acp(uint64_t acp_clock);
+	void flush_samples();
 public:
 	static ACPState* singleton_acp_state;
-	AudioCoprocessor();
+	AudioCoprocessor(Timekeeper* timekeeper);
 	void StartAudio();
+	bool StartCapture(const char* filename);
+	void StopCapture();
+	void CatchUp();
 	void ram_write(uint16_t address, uint8_t value);
 	uint8_t ram_read(uint16_t address);
 	void register_write(uint16_t address, uint8_t value);
 	void dump_ram(const char* filename);
+	void RandomizeMemory(Rng& rng);
+	bool write_budget_report(const char* filename);
+	void SaveState(StateWriter& writer);
+	bool LoadState(StateReader& reader);
 	uint16_t get_irq_cycle_count();
 	static void fill_audio(void *udata, uint8_t *stream, int len);
 };
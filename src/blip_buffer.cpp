@@ -0,0 +1,118 @@
+#include "blip_buffer.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <numbers>
+
+int32_t BlipBuffer::kernel[BLIP_PHASES][BLIP_TAPS];
+bool BlipBuffer::kernel_ready = false;
+
+//Blackman-windowed sinc, cut off a bit below the output Nyquist rate.
+//Each phase is normalized to sum to exactly 1 << BLIP_KERNEL_UNIT so the
+//integrated output settles on the exact step height.
+void BlipBuffer::BuildKernel() {
+    const double cutoff = 0.9;
+    const double half = BLIP_TAPS / 2;
+    for(int p = 0; p < BLIP_PHASES; ++p) {
+        double frac = (double) p / BLIP_PHASES;
+        double taps[BLIP_TAPS];
+        double sum = 0;
+        for(int k = 0; k < BLIP_TAPS; ++k) {
+            double d = k - half + 1 - frac;
+            double x = std::numbers::pi * cutoff * d;
+            double sinc = (d == 0) ? 1.0 : sin(x) / x;
+            double w = (d + half) / BLIP_TAPS;
+            double window = 0.42 - 0.5 * cos(2 * std::numbers::pi * w) + 0.08 * cos(4 * std::numbers::pi * w);
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+        int32_t total = 0;
+        int biggest = 0;
+        for(int k = 0; k < BLIP_TAPS; ++k) {
+            kernel[p][k] = (int32_t) lround(taps[k] * (1 << BLIP_KERNEL_UNIT) / sum);
+            total += kernel[p][k];
+            if(kernel[p][k] > kernel[p][biggest]) biggest = k;
+        }
+        kernel[p][biggest] += (1 << BLIP_KERNEL_UNIT) - total;
+    }
+    kernel_ready = true;
+}
+
+BlipBuffer::BlipBuffer(size_t size) : buffer(size + BLIP_TAPS, 0) {
+    if(!kernel_ready) {
+        BuildKernel();
+    }
+}
+
+void BlipBuffer::SetRates(double clock_rate, double sample_rate) {
+    factor = (uint64_t) ((sample_rate / clock_rate) * 4294967296.0);
+}
+
+void BlipBuffer::Clear(uint64_t clock_time) {
+    std::fill(buffer.begin(), buffer.end(), 0);
+    high_water = 0;
+    frame_clock = clock_time;
+    frame_pos = 0;
+}
+
+//Jump the output straight to a level, eg. after restoring a savestate
+void BlipBuffer::SetLevel(int32_t level) {
+    integrator = level << BLIP_KERNEL_UNIT;
+}
+
+void BlipBuffer::AddDelta(uint64_t clock_time, int32_t delta) {
+    uint64_t pos = frame_pos;
+    if(clock_time > frame_clock) {
+        pos += (clock_time - frame_clock) * factor;
+    }
+    size_t index = pos >> 32;
+    if((index + BLIP_TAPS) > buffer.size()) {
+        //reader has fallen too far behind, drop rather than overrun
+        return;
+    }
+    const int32_t* k = kernel[(pos >> (32 - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1)];
+    int32_t* out = &buffer[index];
+    //fixed-width multiply-add, written so the compiler can vectorize it
+    for(int i = 0; i < BLIP_TAPS; ++i) {
+        out[i] += delta * k[i];
+    }
+    if((index + BLIP_TAPS) > high_water) {
+        high_water = index + BLIP_TAPS;
+    }
+}
+
+void BlipBuffer::EndFrame(uint64_t clock_time) {
+    if(clock_time <= frame_clock) return;
+    frame_pos += (clock_time - frame_clock) * factor;
+    frame_clock = clock_time;
+    uint64_t limit = ((uint64_t) (buffer.size() - BLIP_TAPS)) << 32;
+    if(frame_pos > limit) {
+        frame_pos = limit;
+    }
+}
+
+size_t BlipBuffer::SamplesAvailable() const {
+    return frame_pos >> 32;
+}
+
+size_t BlipBuffer::ReadSamples(int16_t* out, size_t count) {
+    size_t avail = SamplesAvailable();
+    if(count > avail) count = avail;
+    int32_t sum = integrator;
+    for(size_t i = 0; i < count; ++i) {
+        sum += buffer[i];
+        //integrator holds DAC levels scaled by 1 << BLIP_KERNEL_UNIT, output is level << 8
+        int32_t s = sum >> (BLIP_KERNEL_UNIT - 8);
+        if(s > 32767) s = 32767;
+        if(s < -32768) s = -32768;
+        out[i] = (int16_t) s;
+    }
+    integrator = sum;
+    //only the region that has been written to needs shifting down
+    size_t live = (high_water > count) ? (high_water - count) : 0;
+    memmove(buffer.data(), buffer.data() + count, live * sizeof(int32_t));
+    memset(buffer.data() + live, 0, (high_water > live ? high_water - live : 0) * sizeof(int32_t));
+    high_water = live;
+    frame_pos -= ((uint64_t) count) << 32;
+    return count;
+}
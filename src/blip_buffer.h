@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#define BLIP_PHASE_BITS 5
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS)
+#define BLIP_TAPS 16
+#define BLIP_KERNEL_UNIT 15
+
+// Band-limited step synthesis.
+// Amplitude changes are added at arbitrary input clock times and spread over
+// BLIP_TAPS output samples with a windowed-sinc kernel, so a square edge that
+// lands between two output samples doesn't alias. Output samples are the
+// running sum of everything added so far.
+class BlipBuffer {
+private:
+    std::vector<int32_t> buffer;
+    uint64_t factor = 0;      //output samples per input clock, 32.32 fixed point
+    uint64_t frame_clock = 0; //input clock of the last EndFrame
+    uint64_t frame_pos = 0;   //sample position of frame_clock relative to buffer[0], 32.32
+    size_t high_water = 0;    //one past the last buffer index touched by AddDelta
+    int32_t integrator = 0;
+    static int32_t kernel[BLIP_PHASES][BLIP_TAPS];
+    static bool kernel_ready;
+    static void BuildKernel();
+public:
+    BlipBuffer(size_t size);
+    void SetRates(double clock_rate, double sample_rate);
+    void Clear(uint64_t clock_time);
+    void SetLevel(int32_t level);
+    void AddDelta(uint64_t clock_time, int32_t delta);
+    void EndFrame(uint64_t clock_time);
+    size_t SamplesAvailable() const;
+    size_t ReadSamples(int16_t* out, size_t count);
+};
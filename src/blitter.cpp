@@ -26,6 +26,27 @@ void Blitter::SetParam(uint8_t address, uint8_t value) {
         if(trigger) {
             uint32_t cycles = ((params[Blitter::PARAM_HEIGHT] & 0x7F) * (params[Blitter::PARAM_WIDTH] & 0x7F));
             cpu_core->ScheduleIRQ(cycles, &(system_state->dma_control_irq));
+            if(timeline && timeline->enabled) {
+                BlitRecord blit = {};
+                blit.start = timekeeper->totalCyclesCount;
+                blit.end = blit.start + cycles;
+                blit.vx = params[PARAM_VX];
+                blit.vy = params[PARAM_VY];
+                blit.gx = params[PARAM_GX];
+                blit.gy = params[PARAM_GY];
+                blit.width = params[PARAM_WIDTH];
+                blit.height = params[PARAM_HEIGHT];
+                blit.color = params[PARAM_COLOR];
+                blit.gram_bank = system_state->banking & BANK_GRAM_MASK;
+                if(system_state->dma_control & DMA_COLORFILL_ENABLE_BIT) {
+                    blit.mode = BLIT_FILL;
+                } else if(system_state->dma_control & DMA_TRANSPARENCY_BIT) {
+                    blit.mode = BLIT_COPY;
+                } else {
+                    blit.mode = BLIT_TRANSPARENT;
+                }
+                timeline->Blit(blit);
+            }
             if(instant_mode) {
                 CatchUp(cycles);
             }
@@ -48,6 +69,7 @@ void Blitter::CatchUp(uint64_t cycles) {
     }
     last_updated_cycle = timekeeper->totalCyclesCount;
     uint8_t colorbus;
+    MemoryHeatmap* heat = (heatmap && heatmap->enabled) ? heatmap : NULL;
     while(cycles--) {
         //PHASE 0
             //Decrement Width Counter
@@ -114,6 +136,9 @@ void Blitter::CatchUp(uint64_t cycles) {
                             (!!(counterGY & 0x80) << 15) +
                             (!!(counterGX & 0x80) << 14);
                     colorbus = system_state->gram[((counterGY & 0x7F) << 7) | (counterGX & 0x7F) | gOffset];
+                    if(heat) {
+                        heat->Read(HEAT_GRAM, ((counterGY & 0x7F) << 7) | (counterGX & 0x7F) | gOffset);
+                    }
                 }
                 counterGX = XDIR ? ~counterGX : counterGX;
                 counterGY = YDIR ? ~counterGY : counterGY;
@@ -125,6 +150,9 @@ void Blitter::CatchUp(uint64_t cycles) {
                         int yShift = (system_state->banking & BANK_VRAM_MASK) ? 128 : 0;
                         int vOffset = yShift << 7;
                         system_state->vram[((counterVY & 0x7F) << 7) | (counterVX & 0x7F) | vOffset] = colorbus;
+                        if(heat) {
+                            heat->Write(HEAT_VRAM, ((counterVY & 0x7F) << 7) | (counterVX & 0x7F) | vOffset);
+                        }
                         put_pixel32(vram_surface, counterVX & 0x7F, (counterVY & 0x7F) + yShift, Palette::ConvertColor(vram_surface, colorbus));
                     }
                     ++pixels_this_frame;
@@ -132,4 +160,39 @@ void Blitter::CatchUp(uint64_t cycles) {
             }
 
     }
-}
\ No newline at end of file
+}
+
+void Blitter::SaveState(StateWriter& writer) {
+    writer.Section("BLIT");
+    writer.Put(counterVX);
+    writer.Put(counterVY);
+    writer.Put(counterGX);
+    writer.Put(counterGY);
+    writer.Put(counterW);
+    writer.Put(counterH);
+    writer.Put(params);
+    writer.Put(trigger);
+    writer.Put(init);
+    writer.Put(irq);
+    writer.Put(running);
+    writer.Put(gram_mid_bits);
+    writer.Put(last_updated_cycle);
+}
+
+bool Blitter::LoadState(StateReader& reader) {
+    reader.Section("BLIT");
+    reader.Get(counterVX);
+    reader.Get(counterVY);
+    reader.Get(counterGX);
+    reader.Get(counterGY);
+    reader.Get(counterW);
+    reader.Get(counterH);
+    reader.Get(params);
+    reader.Get(trigger);
+    reader.Get(init);
+    reader.Get(irq);
+    reader.Get(running);
+    reader.Get(gram_mid_bits);
+    reader.Get(last_updated_cycle);
+    return reader.Ok();
+}
@@ -4,6 +4,9 @@
 #include "SDL_inc.h"
 #include "mos6502/mos6502.h"
 #include "palette.h"
+#include "savestate.h"
+#include "devtools/memory_heatmap.h"
+#include "devtools/blit_timeline.h"
 
 #define DMA_PARAMS_COUNT 8
 
@@ -56,9 +59,15 @@ public:
     uint64_t pixels_this_frame = 0;
     
     uint8_t gram_mid_bits;
+    //counts the blitter's GRAM reads and VRAM writes while enabled
+    MemoryHeatmap* heatmap = NULL;
+    //gets every triggered blit while enabled
+    BlitTimeline* timeline = NULL;
 
     Blitter(mos6502*& cpu_core, Timekeeper* timekeeper, SystemState* system_state, SDL_Surface*& vram_surface) : cpu_core(cpu_core), timekeeper(timekeeper), system_state(system_state), vram_surface(vram_surface) {};
 
     void SetParam(uint8_t address, uint8_t value);
     void CatchUp(uint64_t cycles=0);
+    void SaveState(StateWriter& writer);
+    bool LoadState(StateReader& reader);
 };
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "acp_monitor.h"
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+
+//A sample timer tick. acp_clock is the ACP clock the tick lands on.
+void ACPMonitor::Tick(uint64_t acp_clock, uint64_t cycles_per_sample, bool taken) {
+    ++ticks;
+    budget = cycles_per_sample;
+    if(in_isr) {
+        ++late_ticks;
+        overrun_flag = true;
+    } else if(taken) {
+        in_isr = true;
+        isr_start = acp_clock;
+    } else {
+        ++masked_ticks;
+    }
+}
+
+void ACPMonitor::NMI() {
+    ++nmi_depth;
+}
+
+//The ACP was reset, so whatever handler was running is gone
+void ACPMonitor::CPUReset() {
+    in_isr = false;
+    nmi_depth = 0;
+}
+
+void ACPMonitor::Return(uint64_t acp_clock) {
+    if(nmi_depth > 0) {
+        --nmi_depth;
+        return;
+    }
+    if(!in_isr) {
+        return;
+    }
+    in_isr = false;
+    Record(acp_clock - isr_start);
+}
+
+void ACPMonitor::Record(uint64_t cycles) {
+    ++isr_count;
+    last_cycles = cycles;
+    total_isr_cycles += cycles;
+    if(cycles < min_cycles) min_cycles = cycles;
+    if(cycles > max_cycles) max_cycles = cycles;
+    if((budget != 0) && (cycles > budget)) {
+        ++overruns;
+        overrun_flag = true;
+    }
+
+    float ratio = (budget != 0) ? ((float) cycles / (float) budget) : 0.0f;
+    size_t bucket = (size_t) (ratio * (100 / ACP_MONITOR_BUCKET_PERCENT));
+    if(bucket >= ACP_MONITOR_BUCKETS) bucket = ACP_MONITOR_BUCKETS - 1;
+    ++histogram[bucket];
+
+    history[history_num] = ratio;
+    ++history_num;
+    history_num %= ACP_MONITOR_HISTORY;
+}
+
+void ACPMonitor::Clear() {
+    ticks = 0;
+    isr_count = 0;
+    overruns = 0;
+    late_ticks = 0;
+    masked_ticks = 0;
+    total_isr_cycles = 0;
+    min_cycles = UINT64_MAX;
+    max_cycles = 0;
+    last_cycles = 0;
+    overrun_flag = false;
+    std::fill(std::begin(histogram), std::end(histogram), 0);
+    std::fill(std::begin(history), std::end(history), 0.0f);
+    history_num = 0;
+    std::fill(std::begin(addr_cycles), std::end(addr_cycles), 0);
+}
+
+uint64_t ACPMonitor::TotalCycles() const {
+    uint64_t total = 0;
+    for(uint64_t cycles : addr_cycles) {
+        total += cycles;
+    }
+    return total;
+}
+
+std::vector<std::pair<uint16_t, uint64_t>> ACPMonitor::HotAddresses(size_t count) const {
+    std::vector<std::pair<uint16_t, uint64_t>> hot;
+    for(int i = 0; i < ACP_MONITOR_ADDRESSES; ++i) {
+        if(addr_cycles[i] != 0) {
+            hot.emplace_back((uint16_t) i, addr_cycles[i]);
+        }
+    }
+    std::sort(hot.begin(), hot.end(),
+        [](const auto& a, const auto& b) { return a.second > b.second; });
+    if(hot.size() > count) {
+        hot.resize(count);
+    }
+    return hot;
+}
+
+bool ACPMonitor::WriteJSON(const char* filename) const {
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        printf("Unable to write ACP report to %s\n", filename);
+        return false;
+    }
+    file << "{\n";
+    file << "\t\"cycles_per_sample\": " << budget << ",\n";
+    file << "\t\"ticks\": " << ticks << ",\n";
+    file << "\t\"isr_count\": " << isr_count << ",\n";
+    file << "\t\"overruns\": " << overruns << ",\n";
+    file << "\t\"late_ticks\": " << late_ticks << ",\n";
+    file << "\t\"masked_ticks\": " << masked_ticks << ",\n";
+    file << "\t\"min_cycles\": " << (isr_count ? min_cycles : 0) << ",\n";
+    file << "\t\"max_cycles\": " << max_cycles << ",\n";
+    file << "\t\"mean_cycles\": " << (isr_count ? ((double) total_isr_cycles / isr_count) : 0.0) << ",\n";
+    file << "\t\"peak_usage\": " << (budget ? ((double) max_cycles / budget) : 0.0) << ",\n";
+    file << "\t\"histogram_bucket_percent\": " << ACP_MONITOR_BUCKET_PERCENT << ",\n";
+    file << "\t\"histogram\": [";
+    for(int i = 0; i < ACP_MONITOR_BUCKETS; ++i) {
+        file << (i ? ", " : "") << histogram[i];
+    }
+    file << "],\n";
+    file << "\t\"total_cycles\": " << TotalCycles() << ",\n";
+    file << "\t\"addresses\": [";
+    auto hot = HotAddresses(ACP_MONITOR_ADDRESSES);
+    for(size_t i = 0; i < hot.size(); ++i) {
+        char addr[8];
+        snprintf(addr, sizeof(addr), "%04X", hot[i].first);
+        file << (i ? "," : "") << "\n\t\t{\"address\": \"" << addr << "\", \"cycles\": " << hot[i].second << "}";
+    }
+    file << "\n\t]\n";
+    file << "}\n";
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+#define ACP_MONITOR_HISTORY 1024
+//Histogram buckets are 5% of the sample budget wide, the last one collects everything past 200%
+#define ACP_MONITOR_BUCKET_PERCENT 5
+#define ACP_MONITOR_BUCKETS (200 / ACP_MONITOR_BUCKET_PERCENT + 1)
+#define ACP_MONITOR_ADDRESSES 4096
+
+// Tracks how much of each sample period the audio coprocessor's IRQ handler uses.
+// An ISR starts when the sample timer IRQ is taken and ends at its RTI.
+// Cycles spent inside the handler are also totalled per code address.
+class ACPMonitor {
+private:
+    bool in_isr = false;
+    uint64_t isr_start = 0;
+    int nmi_depth = 0;
+    void Record(uint64_t cycles);
+public:
+    uint64_t budget = 0;
+    uint64_t ticks = 0;
+    uint64_t isr_count = 0;
+    uint64_t overruns = 0;
+    uint64_t late_ticks = 0;   //ticks that arrived while the previous ISR was still running
+    uint64_t masked_ticks = 0; //ticks dropped because interrupts were disabled outside the ISR
+    uint64_t total_isr_cycles = 0;
+    uint64_t min_cycles = UINT64_MAX;
+    uint64_t max_cycles = 0;
+    uint64_t last_cycles = 0;
+    bool overrun_flag = false; //sticky, cleared from the profiler window
+    uint32_t histogram[ACP_MONITOR_BUCKETS] = {0};
+    float history[ACP_MONITOR_HISTORY] = {0};
+    int history_num = 0;
+    uint64_t addr_cycles[ACP_MONITOR_ADDRESSES] = {0};
+
+    void Tick(uint64_t acp_clock, uint64_t cycles_per_sample, bool taken);
+    void Return(uint64_t acp_clock);
+    void NMI();
+    void CPUReset();
+    void Clear();
+    //Per-address counters for the CPU core to charge while a handler runs, NULL otherwise
+    uint64_t* ActiveProfile() { return in_isr ? addr_cycles : NULL; }
+    //Handler cycles charged to addr_cycles
+    uint64_t TotalCycles() const;
+    std::vector<std::pair<uint16_t, uint64_t>> HotAddresses(size_t count) const;
+    bool WriteJSON(const char* filename) const;
+};
@@ -0,0 +1,239 @@
+#include "bank_profiler.h"
+#include "trace_writer.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <tuple>
+#include <cstdio>
+
+//No bank: RAM, or a cart without banks
+#define NO_BANK 0xFF
+
+//Bank holding the code at an address, the last bank above the window
+static uint8_t code_bank(uint16_t address, int bank) {
+    if((bank == SYMBOL_ANY_BANK) || (address < 0x8000)) {
+        return NO_BANK;
+    }
+    if(address >= 0xC000) {
+        return 127;
+    }
+    return bank & 127;
+}
+
+static int bank_number(uint8_t bank) {
+    return (bank == NO_BANK) ? SYMBOL_ANY_BANK : bank;
+}
+
+static uint64_t site_key(uint16_t a, uint8_t a_bank, uint16_t b, uint8_t b_bank) {
+    return ((uint64_t) a << 32) | ((uint64_t) a_bank << 24) | ((uint64_t) b << 8) | b_bank;
+}
+
+BankProfiler::BankProfiler() : transitions(BANK_PROFILER_BANKS * BANK_PROFILER_BANKS, 0) {}
+
+void BankProfiler::ShiftWrite(uint16_t pc, int bank, uint64_t cycle) {
+    if(shifting) {
+        return;
+    }
+    shifting = true;
+    shift_start = cycle;
+    shift_routine = {pc, code_bank(pc, bank)};
+    //inline switching code is its own caller
+    shift_caller = stack_depth ? stack[std::min(stack_depth, (size_t) BANK_PROFILER_STACK_DEPTH) - 1] : shift_routine;
+    awaiting_callee = false;
+}
+
+void BankProfiler::Latch(uint8_t from, uint8_t to, uint64_t cycle) {
+    uint64_t spent = shifting ? (cycle - shift_start) : 0;
+    if(!shifting) {
+        //latched without any shifting seen, charge it to whatever is running
+        shift_caller = shift_routine = {0, NO_BANK};
+    }
+    shifting = false;
+    ++switches;
+    ++frame_switches;
+    cycles += spent;
+    if(from == to) {
+        ++redundant;
+    }
+    ++transitions[from * BANK_PROFILER_BANKS + to];
+    Counter& counter = callers[site_key(shift_caller.site, shift_caller.bank, shift_routine.site, shift_routine.bank)];
+    ++counter.switches;
+    counter.cycles += spent;
+    awaiting_callee = true;
+    last_caller = shift_caller;
+    last_cycles = spent;
+}
+
+void BankProfiler::Call(uint16_t site, int bank, uint16_t destination, int destination_bank) {
+    uint8_t site_bank = code_bank(site, bank);
+    if(stack_depth < BANK_PROFILER_STACK_DEPTH) {
+        stack[stack_depth] = {site, site_bank};
+    }
+    ++stack_depth;
+    if(awaiting_callee && (destination >= 0x8000) && (destination < 0xC000)) {
+        Counter& counter = pairs[site_key(last_caller.site, last_caller.bank, destination, code_bank(destination, destination_bank))];
+        ++counter.switches;
+        counter.cycles += last_cycles;
+        awaiting_callee = false;
+    }
+}
+
+void BankProfiler::Return() {
+    if(stack_depth) {
+        --stack_depth;
+    }
+}
+
+void BankProfiler::EndFrame() {
+    ++frames;
+    last_frame_switches = frame_switches;
+    max_frame_switches = std::max(max_frame_switches, frame_switches);
+    history[history_num] = (float) frame_switches;
+    history_num = (history_num + 1) % BANK_PROFILER_HISTORY;
+    frame_switches = 0;
+}
+
+void BankProfiler::Clear() {
+    switches = redundant = cycles = frames = 0;
+    frame_switches = last_frame_switches = max_frame_switches = 0;
+    std::fill(std::begin(history), std::end(history), 0.0f);
+    history_num = 0;
+    std::fill(transitions.begin(), transitions.end(), 0);
+    callers.clear();
+    pairs.clear();
+    shifting = false;
+    awaiting_callee = false;
+}
+
+std::vector<uint8_t> BankProfiler::BusiestBanks(size_t count) const {
+    std::vector<std::pair<uint64_t, int>> totals;
+    for(int bank = 0; bank < BANK_PROFILER_BANKS; ++bank) {
+        uint64_t total = 0;
+        for(int other = 0; other < BANK_PROFILER_BANKS; ++other) {
+            total += Transitions(bank, other) + Transitions(other, bank);
+        }
+        if(total) {
+            totals.push_back({total, bank});
+        }
+    }
+    std::sort(totals.begin(), totals.end(), [](auto& a, auto& b) {
+        return a.first > b.first;
+    });
+    std::vector<uint8_t> banks;
+    for(size_t i = 0; (i < totals.size()) && (i < count); ++i) {
+        banks.push_back((uint8_t) totals[i].second);
+    }
+    std::sort(banks.begin(), banks.end());
+    return banks;
+}
+
+std::string BankProfiler::FunctionName(MemoryMap* memory_map, uint16_t address, int bank) {
+    const Symbol* symbol = (memory_map != NULL) ? memory_map->Nearest(address, bank) : NULL;
+    if(symbol != NULL) {
+        return symbol->name;
+    }
+    char text[8];
+    snprintf(text, sizeof(text), "$%04X", address);
+    return text;
+}
+
+std::vector<BankSwitchCaller> BankProfiler::Callers(MemoryMap* memory_map) const {
+    std::map<std::tuple<std::string, int, std::string>, BankSwitchCaller> merged;
+    for(auto& entry : callers) {
+        uint16_t site = entry.first >> 32;
+        int site_bank = bank_number((entry.first >> 24) & 0xFF);
+        uint16_t routine = (entry.first >> 8) & 0xFFFF;
+        int routine_bank = bank_number(entry.first & 0xFF);
+        std::string caller_name = FunctionName(memory_map, site, site_bank);
+        std::string routine_name = FunctionName(memory_map, routine, routine_bank);
+        auto found = merged.try_emplace({caller_name, site_bank, routine_name},
+            BankSwitchCaller{caller_name, site_bank, routine_name, 0, 0});
+        found.first->second.switches += entry.second.switches;
+        found.first->second.cycles += entry.second.cycles;
+    }
+    std::vector<BankSwitchCaller> out;
+    for(auto& entry : merged) {
+        out.push_back(entry.second);
+    }
+    std::sort(out.begin(), out.end(), [](const BankSwitchCaller& a, const BankSwitchCaller& b) {
+        return a.cycles > b.cycles;
+    });
+    return out;
+}
+
+std::vector<BankCoLocation> BankProfiler::CoLocations(MemoryMap* memory_map) const {
+    std::map<std::tuple<std::string, int, std::string, int>, BankCoLocation> merged;
+    for(auto& entry : pairs) {
+        uint16_t site = entry.first >> 32;
+        int site_bank = bank_number((entry.first >> 24) & 0xFF);
+        uint16_t callee = (entry.first >> 8) & 0xFFFF;
+        int callee_bank = bank_number(entry.first & 0xFF);
+        if(site_bank == callee_bank) {
+            continue;
+        }
+        std::string caller_name = FunctionName(memory_map, site, site_bank);
+        std::string callee_name = FunctionName(memory_map, callee, callee_bank);
+        auto found = merged.try_emplace({caller_name, site_bank, callee_name, callee_bank},
+            BankCoLocation{caller_name, site_bank, callee_name, callee_bank, 0, 0});
+        found.first->second.switches += entry.second.switches;
+        found.first->second.cycles += entry.second.cycles;
+    }
+    std::vector<BankCoLocation> out;
+    for(auto& entry : merged) {
+        out.push_back(entry.second);
+    }
+    std::sort(out.begin(), out.end(), [](const BankCoLocation& a, const BankCoLocation& b) {
+        return a.cycles > b.cycles;
+    });
+    return out;
+}
+
+bool BankProfiler::WriteJSON(const char* filename, MemoryMap* memory_map) const {
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        printf("Unable to write bank switch report to %s\n", filename);
+        return false;
+    }
+    file << "{\n";
+    file << "\t\"switches\": " << switches << ",\n";
+    file << "\t\"redundant_switches\": " << redundant << ",\n";
+    file << "\t\"cycles\": " << cycles << ",\n";
+    file << "\t\"frames\": " << frames << ",\n";
+    file << "\t\"mean_switches_per_frame\": " << (frames ? (double) switches / frames : 0.0) << ",\n";
+    file << "\t\"max_switches_per_frame\": " << max_frame_switches << ",\n";
+    file << "\t\"callers\": [";
+    auto found = Callers(memory_map);
+    for(size_t i = 0; i < found.size(); ++i) {
+        file << (i ? "," : "") << "\n\t\t{\"caller\": " << json_string(found[i].caller)
+            << ", \"caller_bank\": " << found[i].caller_bank
+            << ", \"via\": " << json_string(found[i].routine)
+            << ", \"switches\": " << found[i].switches
+            << ", \"cycles\": " << found[i].cycles << "}";
+    }
+    file << "\n\t],\n";
+    file << "\t\"transitions\": [";
+    bool first = true;
+    for(int from = 0; from < BANK_PROFILER_BANKS; ++from) {
+        for(int to = 0; to < BANK_PROFILER_BANKS; ++to) {
+            if(Transitions(from, to)) {
+                file << (first ? "" : ",") << "\n\t\t{\"from\": " << from << ", \"to\": " << to
+                    << ", \"count\": " << Transitions(from, to) << "}";
+                first = false;
+            }
+        }
+    }
+    file << "\n\t],\n";
+    file << "\t\"co_locate\": [";
+    auto pairs_found = CoLocations(memory_map);
+    for(size_t i = 0; i < pairs_found.size(); ++i) {
+        file << (i ? "," : "") << "\n\t\t{\"caller\": " << json_string(pairs_found[i].caller)
+            << ", \"caller_bank\": " << pairs_found[i].caller_bank
+            << ", \"callee\": " << json_string(pairs_found[i].callee)
+            << ", \"callee_bank\": " << pairs_found[i].callee_bank
+            << ", \"switches\": " << pairs_found[i].switches
+            << ", \"cycles\": " << pairs_found[i].cycles << "}";
+    }
+    file << "\n\t]\n";
+    file << "}\n";
+    return true;
+}
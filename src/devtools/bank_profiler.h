@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "memory_map.h"
+
+#define BANK_PROFILER_HISTORY 256
+//Calls followed to find who asked for a switch
+#define BANK_PROFILER_STACK_DEPTH 64
+//Values the bank latch can hold
+#define BANK_PROFILER_BANKS 256
+
+//Switches made from one function, through one piece of switching code
+struct BankSwitchCaller {
+    std::string caller;   //function the switching code was called from
+    int caller_bank;
+    std::string routine;  //function doing the shifting
+    uint64_t switches;
+    uint64_t cycles;
+};
+
+//A function calling into another bank right after switching to it
+struct BankCoLocation {
+    std::string caller;
+    int caller_bank;
+    std::string callee;
+    int callee_bank;
+    uint64_t switches;
+    uint64_t cycles;
+};
+
+// Counts flash cart bank switches and what they cost. A switch is the run of
+// VIA ORA writes that shifts a bank number out to the cartridge, timed from
+// the first write to the chip select that latches it. Each switch is charged
+// to the function that called the switching code, found by following
+// JSR/RTS, and to its (from, to) cell of the transition matrix. When the
+// first call after a switch lands in the banked window, the caller and callee
+// are recorded as a pair that would not need the switch if they shared a bank.
+// Nothing is followed unless enabled.
+class BankProfiler {
+private:
+    struct Call {
+        uint16_t site;
+        int bank;
+    };
+    struct Counter {
+        uint64_t switches;
+        uint64_t cycles;
+    };
+    Call stack[BANK_PROFILER_STACK_DEPTH];
+    size_t stack_depth = 0;
+    bool shifting = false;
+    uint64_t shift_start = 0;
+    Call shift_caller;
+    Call shift_routine;
+    //the switch waiting to see where the next call goes
+    bool awaiting_callee = false;
+    Call last_caller;
+    uint64_t last_cycles = 0;
+    //(caller site, caller bank, routine pc, routine bank) to counts
+    std::unordered_map<uint64_t, Counter> callers;
+    //(caller site, caller bank, callee, callee bank) to counts
+    std::unordered_map<uint64_t, Counter> pairs;
+    std::vector<uint32_t> transitions;
+    static std::string FunctionName(MemoryMap* memory_map, uint16_t address, int bank);
+public:
+    bool enabled = false;
+    uint64_t switches = 0;
+    uint64_t redundant = 0; //latched the bank that was already selected
+    uint64_t cycles = 0;
+    uint64_t frames = 0;
+    uint32_t frame_switches = 0;
+    uint32_t last_frame_switches = 0;
+    uint32_t max_frame_switches = 0;
+    float history[BANK_PROFILER_HISTORY] = {0};
+    int history_num = 0;
+
+    BankProfiler();
+    //Every write to ORA, pc and bank of the writing instruction
+    void ShiftWrite(uint16_t pc, int bank, uint64_t cycle);
+    //Chip select latched a new bank number
+    void Latch(uint8_t from, uint8_t to, uint64_t cycle);
+    void Call(uint16_t site, int bank, uint16_t destination, int destination_bank);
+    void Return();
+    void EndFrame();
+    void Clear();
+    uint32_t Transitions(uint8_t from, uint8_t to) const { return transitions[from * BANK_PROFILER_BANKS + to]; }
+    //Banks switched to or from, busiest first
+    std::vector<uint8_t> BusiestBanks(size_t count) const;
+    //Most expensive first, by function name
+    std::vector<BankSwitchCaller> Callers(MemoryMap* memory_map) const;
+    std::vector<BankCoLocation> CoLocations(MemoryMap* memory_map) const;
+    bool WriteJSON(const char* filename, MemoryMap* memory_map) const;
+};
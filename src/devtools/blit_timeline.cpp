@@ -0,0 +1,173 @@
+#include "blit_timeline.h"
+#include "trace_writer.h"
+#include <algorithm>
+#include <cstdio>
+
+static const char* mode_names[] = {
+    "copy",
+    "transparent",
+    "fill"
+};
+
+static const char* verdict_names[] = {
+    "headroom",
+    "CPU-bound",
+    "blitter-bound"
+};
+
+void BlitTimeline::Blit(const BlitRecord& blit) {
+    //a new trigger restarts the blitter
+    if(!current.blits.empty() && (current.blits.back().end > blit.start)) {
+        current.blits.back().end = blit.start;
+    }
+    if(current.blits.size() < BLIT_TIMELINE_FRAME_LIMIT) {
+        current.blits.push_back(blit);
+    } else {
+        ++current.dropped;
+    }
+}
+
+void BlitTimeline::EndWait(uint64_t cycle) {
+    waiting = false;
+    if(cycle > wait_start) {
+        current.waits.push_back({wait_start, cycle});
+    }
+}
+
+void BlitTimeline::Summarize(BlitFrame& frame) {
+    frame.blit_cycles = frame.wait_cycles = frame.stalled_cycles = 0;
+    for(const CycleSpan& wait : frame.waits) {
+        frame.wait_cycles += std::min(wait.end, frame.end) - std::min(wait.start, frame.end);
+    }
+    //both lists are in order and neither overlaps itself
+    size_t next_wait = 0;
+    for(const BlitRecord& blit : frame.blits) {
+        uint64_t end = std::min(blit.end, frame.end);
+        if(end <= blit.start) {
+            continue;
+        }
+        frame.blit_cycles += end - blit.start;
+        while((next_wait < frame.waits.size()) && (frame.waits[next_wait].end <= blit.start)) {
+            ++next_wait;
+        }
+        for(size_t i = next_wait; (i < frame.waits.size()) && (frame.waits[i].start < end); ++i) {
+            frame.stalled_cycles += std::min(end, frame.waits[i].end) - std::max(blit.start, frame.waits[i].start);
+        }
+    }
+    frame.overlap_cycles = frame.blit_cycles - frame.stalled_cycles;
+}
+
+void BlitTimeline::EndFrame() {
+    uint64_t cycle = timekeeper.totalCyclesCount;
+    if(!frame_open || (cycle < current.start)) {
+        //nothing seen since the last vsync, or time went back with a loaded state
+        current = BlitFrame();
+        current.start = cycle;
+        frame_open = true;
+        if(waiting) {
+            wait_start = cycle;
+        }
+        return;
+    }
+    if(waiting) {
+        EndWait(cycle);
+        waiting = true;
+    }
+    wait_start = cycle;
+    current.end = cycle;
+    Summarize(current);
+
+    BlitFrame next;
+    next.number = current.number + 1;
+    next.start = cycle;
+    if(!current.blits.empty() && (current.blits.back().end > cycle)) {
+        BlitRecord carried = current.blits.back();
+        carried.start = cycle;
+        carried.continued = true;
+        next.blits.push_back(carried);
+    }
+
+    uint64_t length = current.end - current.start;
+    busy_history[history_num] = length ? (100.0f * current.blit_cycles) / length : 0;
+    stalled_history[history_num] = length ? (100.0f * current.stalled_cycles) / length : 0;
+    history_num = (history_num + 1) % BLIT_TIMELINE_HISTORY;
+    ++total_frames;
+    BlitVerdict verdict = Verdict(current);
+    if(verdict == BLIT_BLITTER_BOUND) {
+        ++blitter_bound_frames;
+    } else if(verdict == BLIT_CPU_BOUND) {
+        ++cpu_bound_frames;
+    }
+
+    frames.push_back(std::move(current));
+    if(frames.size() > BLIT_TIMELINE_FRAMES) {
+        frames.pop_front();
+    }
+    current = std::move(next);
+}
+
+void BlitTimeline::Clear() {
+    current = BlitFrame();
+    frame_open = false;
+    waiting = false;
+    frames.clear();
+    std::fill(std::begin(busy_history), std::end(busy_history), 0.0f);
+    std::fill(std::begin(stalled_history), std::end(stalled_history), 0.0f);
+    history_num = 0;
+    total_frames = blitter_bound_frames = cpu_bound_frames = 0;
+}
+
+const char* BlitTimeline::ModeName(BlitMode mode) {
+    return mode_names[mode];
+}
+
+BlitVerdict BlitTimeline::Verdict(const BlitFrame& frame) {
+    uint64_t length = frame.end - frame.start;
+    if(frame.stalled_cycles * 10 >= length) {
+        return BLIT_BLITTER_BOUND;
+    }
+    if((length - frame.wait_cycles) * 10 >= length * 9) {
+        return BLIT_CPU_BOUND;
+    }
+    return BLIT_HEADROOM;
+}
+
+const char* BlitTimeline::VerdictName(BlitVerdict verdict) {
+    return verdict_names[verdict];
+}
+
+bool BlitTimeline::WriteTrace(const std::string& filename) const {
+    char otherData[128];
+    snprintf(otherData, sizeof(otherData), "\"frames\": %llu, \"blitter_bound_frames\": %llu, \"cpu_bound_frames\": %llu",
+        (unsigned long long) total_frames, (unsigned long long) blitter_bound_frames, (unsigned long long) cpu_bound_frames);
+    TraceWriter trace;
+    if(!trace.Open(filename, timekeeper.system_clock, frames.empty() ? 0 : frames.front().start, otherData)) {
+        printf("Unable to write blit timeline to %s\n", filename.c_str());
+        return false;
+    }
+    trace.ThreadName(1, "Frames");
+    trace.ThreadName(2, "Blitter");
+    trace.ThreadName(3, "CPU in WAI");
+    for(const BlitFrame& frame : frames) {
+        char args[256];
+        snprintf(args, sizeof(args), "\"blits\": %llu, \"blit_cycles\": %llu, \"wait_cycles\": %llu, \"stalled_cycles\": %llu, \"overlap_cycles\": %llu, \"verdict\": \"%s\"",
+            (unsigned long long) (frame.blits.size() + frame.dropped), (unsigned long long) frame.blit_cycles, (unsigned long long) frame.wait_cycles,
+            (unsigned long long) frame.stalled_cycles, (unsigned long long) frame.overlap_cycles, VerdictName(Verdict(frame)));
+        trace.Complete(1, "frame " + std::to_string(frame.number), frame.start, frame.end, args);
+        for(const BlitRecord& blit : frame.blits) {
+            char name[32];
+            snprintf(name, sizeof(name), "%s %dx%d", ModeName(blit.mode), blit.width & 0x7F, blit.height & 0x7F);
+            snprintf(args, sizeof(args), "\"vx\": %d, \"vy\": %d, \"gx\": %d, \"gy\": %d, \"width\": %d, \"height\": %d, \"color\": %d, \"gram_bank\": %d, \"continued\": %s",
+                blit.vx, blit.vy, blit.gx, blit.gy, blit.width, blit.height, blit.color, blit.gram_bank,
+                blit.continued ? "true" : "false");
+            trace.Complete(2, name, blit.start, std::min(blit.end, frame.end), args);
+        }
+        for(const CycleSpan& wait : frame.waits) {
+            trace.Complete(3, "WAI", wait.start, wait.end);
+        }
+    }
+    trace.Close();
+    printf("Blit timeline written to %s: %llu frames, %llu blitter-bound, %llu CPU-bound\n", filename.c_str(),
+        (unsigned long long) total_frames, (unsigned long long) blitter_bound_frames, (unsigned long long) cpu_bound_frames);
+    return true;
+}
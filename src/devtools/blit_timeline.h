@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+#include "../timekeeper.h"
+
+//Finished frames kept for the timeline view and the trace
+#define BLIT_TIMELINE_FRAMES 120
+#define BLIT_TIMELINE_HISTORY 256
+//Blits kept per frame, more are counted but not shown
+#define BLIT_TIMELINE_FRAME_LIMIT 4096
+//Cycles WAI itself takes before the CPU stops
+#define WAI_CYCLES 3
+
+enum BlitMode : uint8_t {
+    BLIT_COPY,
+    BLIT_TRANSPARENT, //copy that skips color 0
+    BLIT_FILL
+};
+
+enum BlitVerdict : uint8_t {
+    BLIT_HEADROOM,
+    BLIT_CPU_BOUND,     //nine tenths of the frame out of WAI
+    BLIT_BLITTER_BOUND  //a tenth of the frame in WAI with a blit running
+};
+
+struct BlitRecord {
+    uint64_t start;
+    uint64_t end;       //when the IRQ is due, or when the next blit cut it short
+    uint8_t vx, vy, gx, gy;
+    uint8_t width;      //with the flip bits
+    uint8_t height;
+    uint8_t color;
+    uint8_t gram_bank;
+    BlitMode mode;
+    bool continued;     //carried over from the frame before
+};
+
+struct CycleSpan {
+    uint64_t start;
+    uint64_t end;
+};
+
+struct BlitFrame {
+    uint64_t number = 0;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    std::vector<BlitRecord> blits;
+    std::vector<CycleSpan> waits;
+    uint64_t dropped = 0;
+    //filled in when the frame ends, all clipped to the frame
+    uint64_t blit_cycles = 0;
+    uint64_t wait_cycles = 0;
+    uint64_t stalled_cycles = 0; //in WAI while a blit ran
+    uint64_t overlap_cycles = 0; //blitting while the CPU ran
+};
+
+// Every blit of the last frames with its timing, size, mode and source GRAM
+// bank, and the spans the CPU spent stopped in WAI. A blit runs from its
+// trigger until its completion IRQ is due (width * height cycles) or until
+// the next trigger restarts the blitter. A WAI span runs from the end of the
+// WAI to the next instruction fetched, which is either the instruction after
+// it or an interrupt handler. Comparing the two tells how long the CPU sat
+// waiting on the blitter and how much blitting happened behind useful work;
+// a busy-wait loop counts as work.
+// Nothing is recorded unless enabled.
+class BlitTimeline {
+private:
+    Timekeeper& timekeeper;
+    BlitFrame current;
+    bool frame_open = false;  //current started at a vsync seen while recording
+    bool waiting = false;
+    uint64_t wait_start = 0;
+    void EndWait(uint64_t cycle);
+    static void Summarize(BlitFrame& frame);
+public:
+    bool enabled = false;
+    std::string traceFile = "blit_timeline.json";
+    std::deque<BlitFrame> frames; //oldest first
+    float busy_history[BLIT_TIMELINE_HISTORY] = {0};
+    float stalled_history[BLIT_TIMELINE_HISTORY] = {0};
+    int history_num = 0;
+    //over every frame recorded, not just the ones kept
+    uint64_t total_frames = 0;
+    uint64_t blitter_bound_frames = 0;
+    uint64_t cpu_bound_frames = 0;
+
+    BlitTimeline(Timekeeper& tk) : timekeeper(tk) {};
+    void Blit(const BlitRecord& blit);
+    //Every instruction fetch, with whether it is a WAI
+    inline void Fetch(bool wai) {
+        if(waiting) {
+            EndWait(timekeeper.totalCyclesCount);
+        }
+        if(wai) {
+            waiting = true;
+            wait_start = timekeeper.totalCyclesCount + WAI_CYCLES;
+        }
+    }
+    void EndFrame();
+    void Clear();
+    static const char* ModeName(BlitMode mode);
+    static BlitVerdict Verdict(const BlitFrame& frame);
+    static const char* VerdictName(BlitVerdict verdict);
+    //Chrome trace of the kept frames, one track each for frames, blits and WAI
+    bool WriteTrace(const std::string& filename) const;
+};
@@ -0,0 +1,281 @@
+#include "budget_monitor.h"
+#include "trace_writer.h"
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+bool BudgetMonitor::PortWrite(uint8_t old_value, uint8_t value) {
+    if(value & 0x80) {
+        if(payload_count < 4) {
+            payload[payload_count] = value;
+        }
+        if(payload_count <= 4) {
+            ++payload_count;
+        }
+        return false;
+    }
+    if(!(old_value & 0x80)) {
+        return false;
+    }
+    bool declaration = (payload_count == 4) && (payload[0] == 0xFF);
+    payload_count = 0;
+    if(!declaration) {
+        return false;
+    }
+
+    uint64_t budget = ((payload[1] & 0x7F) << 14) | ((payload[2] & 0x7F) << 7) | (payload[3] & 0x7F);
+    if(value & 0x40) {
+        frames.budget = budget;
+        printf("Frame cycle budget set to %llu\n", (unsigned long long) budget);
+    } else {
+        slots[value & 0x3F].budget = budget;
+        printf("Cycle budget for timer %d (%s) set to %llu\n", value & 0x3F, Name(value & 0x3F).c_str(), (unsigned long long) budget);
+    }
+    bool had_budgets = active;
+    active = (frames.budget != 0);
+    for(int i = 0; i < BUDGET_SLOTS; ++i) {
+        active = active || (slots[i].budget != 0);
+    }
+    if(active && !had_budgets) {
+        //calls made before now were never seen
+        stack_depth = 0;
+    }
+    return true;
+}
+
+void BudgetMonitor::Start(uint8_t slot, uint16_t pc, int bank) {
+    start_pc[slot] = pc;
+    start_bank[slot] = bank;
+}
+
+void BudgetMonitor::Stop(uint8_t slot, uint64_t cycles, uint16_t pc, int bank) {
+    BudgetStats& stats = slots[slot];
+    ++stats.measurements;
+    stats.total_cycles += cycles;
+    stats.worst_cycles = std::max(stats.worst_cycles, cycles);
+    if(stats.budget && (cycles > stats.budget)) {
+        ++stats.overruns;
+        Overrun(slot, cycles, stats.budget, pc, bank);
+    }
+}
+
+void BudgetMonitor::EndFrame() {
+    if(frames.budget) {
+        ++frames.measurements;
+        frames.total_cycles += frame_cycles;
+        frames.worst_cycles = std::max(frames.worst_cycles, frame_cycles);
+        if(frame_cycles > frames.budget) {
+            ++frames.overruns;
+            Overrun(BUDGET_FRAME_SLOT, frame_cycles, frames.budget, 0, SYMBOL_ANY_BANK);
+        }
+    }
+    frame_cycles = 0;
+    ++frame;
+}
+
+void BudgetMonitor::Overrun(int slot, uint64_t cycles, uint64_t budget, uint16_t pc, int bank) {
+    ++overrun_count;
+    overrun_flag = true;
+    if(overruns.size() >= BUDGET_LOG_LIMIT) {
+        return;
+    }
+    BudgetOverrun overrun;
+    overrun.frame = frame;
+    overrun.slot = slot;
+    overrun.cycles = cycles;
+    overrun.budget = budget;
+    overrun.pc = pc;
+    overrun.bank = bank;
+    overrun.stack.assign(stack, stack + std::min(stack_depth, (size_t) BUDGET_STACK_DEPTH));
+    overruns.push_back(overrun);
+
+    std::string calls;
+    for(const BudgetCall& call : overrun.stack) {
+        calls += (calls.empty() ? "" : " > ") + Describe(call);
+    }
+    if(slot == BUDGET_FRAME_SLOT) {
+        printf("Frame %llu over budget: %llu cycles of %llu\n", (unsigned long long) frame, (unsigned long long) cycles, (unsigned long long) budget);
+    } else {
+        printf("Frame %llu timer %d (%s) over budget: %llu cycles of %llu\n", (unsigned long long) frame, slot, Name(slot).c_str(),
+            (unsigned long long) cycles, (unsigned long long) budget);
+    }
+    if(!calls.empty()) {
+        printf("  in %s\n", calls.c_str());
+    }
+    if(overruns.size() == BUDGET_LOG_LIMIT) {
+        printf("Further overruns are counted but not logged\n");
+    }
+
+    if(!savestate_taken[slot + 1]) {
+        savestate_taken[slot + 1] = true;
+        pending_savestate = overruns.size() - 1;
+    }
+}
+
+void BudgetMonitor::Call(uint16_t site, int bank, uint16_t destination, bool interrupt) {
+    if(stack_depth < BUDGET_STACK_DEPTH) {
+        stack[stack_depth] = {site, destination, bank, interrupt};
+    }
+    ++stack_depth;
+}
+
+void BudgetMonitor::Return(bool from_interrupt) {
+    if(!from_interrupt) {
+        if(stack_depth) {
+            --stack_depth;
+        }
+        return;
+    }
+    //close everything above the interrupt, or everything if it isn't stored
+    while(stack_depth) {
+        --stack_depth;
+        if((stack_depth < BUDGET_STACK_DEPTH) && stack[stack_depth].interrupt) {
+            break;
+        }
+    }
+}
+
+void BudgetMonitor::CPUReset() {
+    stack_depth = 0;
+    payload_count = 0;
+    frame_cycles = 0;
+}
+
+void BudgetMonitor::Clear() {
+    for(BudgetStats& stats : slots) {
+        stats = BudgetStats{stats.budget};
+    }
+    frames = BudgetStats{frames.budget};
+    overruns.clear();
+    overrun_count = 0;
+    overrun_flag = false;
+    pending_savestate = -1;
+    std::fill(std::begin(savestate_taken), std::end(savestate_taken), false);
+}
+
+std::string BudgetMonitor::SavestateTag() const {
+    const BudgetOverrun& overrun = overruns[pending_savestate];
+    char tag[48];
+    if(overrun.slot == BUDGET_FRAME_SLOT) {
+        snprintf(tag, sizeof(tag), "frame_budget_%llu", (unsigned long long) overrun.frame);
+    } else {
+        snprintf(tag, sizeof(tag), "timer%d_budget_%llu", overrun.slot, (unsigned long long) overrun.frame);
+    }
+    return tag;
+}
+
+void BudgetMonitor::SavestateWritten(const std::string& path) {
+    if(pending_savestate >= 0) {
+        overruns[pending_savestate].savestate = path;
+    }
+    pending_savestate = -1;
+}
+
+std::string BudgetMonitor::Name(int slot) {
+    if(slot == BUDGET_FRAME_SLOT) {
+        return "frame";
+    }
+    if(named_from != memory_map) {
+        named_from = memory_map;
+        std::fill(std::begin(names), std::end(names), std::string());
+        if(memory_map != NULL) {
+            size_t prefix = strlen(BUDGET_NAME_PREFIX);
+            memory_map->forEach([&](const Symbol& symbol) {
+                if((symbol.address < BUDGET_SLOTS) && (symbol.name.compare(0, prefix, BUDGET_NAME_PREFIX) == 0)) {
+                    names[symbol.address] = symbol.name.substr(prefix);
+                }
+            });
+        }
+    }
+    if(!names[slot].empty()) {
+        return names[slot];
+    }
+    if(memory_map != NULL && start_pc[slot]) {
+        return memory_map->Describe(start_pc[slot], start_bank[slot]);
+    }
+    char fallback[8];
+    snprintf(fallback, sizeof(fallback), "%04x", start_pc[slot]);
+    return fallback;
+}
+
+std::string BudgetMonitor::Describe(const BudgetCall& call) const {
+    if(memory_map != NULL) {
+        return memory_map->Describe(call.destination, call.bank);
+    }
+    char address[8];
+    snprintf(address, sizeof(address), "$%04x", call.destination);
+    return address;
+}
+
+static void write_stats(std::ofstream& file, const BudgetStats& stats) {
+    file << "\"budget\": " << stats.budget
+        << ", \"measurements\": " << stats.measurements
+        << ", \"mean_cycles\": " << (stats.measurements ? stats.total_cycles / stats.measurements : 0)
+        << ", \"worst_cycles\": " << stats.worst_cycles
+        << ", \"overruns\": " << stats.overruns;
+}
+
+bool BudgetMonitor::WriteJSON(const char* filename) {
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        printf("Unable to write budget report to %s\n", filename);
+        return false;
+    }
+    file << "{\n";
+    file << "\t\"pass\": " << (Passed() ? "true" : "false") << ",\n";
+    file << "\t\"frames\": " << frame << ",\n";
+    file << "\t\"overruns\": " << overrun_count << ",\n";
+    file << "\t\"frame_budget\": {";
+    write_stats(file, frames);
+    file << "},\n";
+    file << "\t\"timers\": [";
+    bool first = true;
+    for(int slot = 0; slot < BUDGET_SLOTS; ++slot) {
+        if(!slots[slot].budget && !slots[slot].measurements) {
+            continue;
+        }
+        file << (first ? "" : ",") << "\n\t\t{\"timer\": " << slot << ", \"name\": ";
+        file << json_string(Name(slot));
+        file << ", ";
+        write_stats(file, slots[slot]);
+        file << "}";
+        first = false;
+    }
+    file << "\n\t],\n";
+    file << "\t\"log\": [";
+    for(size_t i = 0; i < overruns.size(); ++i) {
+        const BudgetOverrun& overrun = overruns[i];
+        char pc[8];
+        snprintf(pc, sizeof(pc), "%04X", overrun.pc);
+        file << (i ? "," : "") << "\n\t\t{\"frame\": " << overrun.frame << ", \"timer\": ";
+        if(overrun.slot == BUDGET_FRAME_SLOT) {
+            file << "\"frame\"";
+        } else {
+            file << overrun.slot;
+        }
+        file << ", \"name\": ";
+        file << json_string(Name(overrun.slot));
+        file << ", \"cycles\": " << overrun.cycles
+            << ", \"budget\": " << overrun.budget;
+        if(overrun.slot != BUDGET_FRAME_SLOT) {
+            file << ", \"pc\": \"" << pc << "\", \"bank\": " << overrun.bank;
+        }
+        file << ", \"stack\": [";
+        for(size_t j = 0; j < overrun.stack.size(); ++j) {
+            file << (j ? ", " : "");
+            file << json_string(Describe(overrun.stack[j]));
+        }
+        file << "]";
+        if(!overrun.savestate.empty()) {
+            file << ", \"savestate\": ";
+            file << json_string(overrun.savestate);
+        }
+        file << "}";
+    }
+    file << "\n\t]\n";
+    file << "}\n";
+    printf("Cycle budgets %s: %llu overruns in %llu frames\n", Passed() ? "passed" : "failed",
+        (unsigned long long) overrun_count, (unsigned long long) frame);
+    return true;
+}
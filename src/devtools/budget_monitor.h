@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "memory_map.h"
+
+#define BUDGET_SLOTS 64
+//Calls kept for overrun reports, deeper nesting is counted but not stored
+#define BUDGET_STACK_DEPTH 32
+//Overruns kept for the log and report, the counts go on past this
+#define BUDGET_LOG_LIMIT 1024
+//Slot number for the per frame budget in overrun records
+#define BUDGET_FRAME_SLOT -1
+//Slots get names from constants in the map named this plus anything
+#define BUDGET_NAME_PREFIX "PROFILE_"
+
+struct BudgetCall {
+    uint16_t site;        //the JSR, or where an interrupt was taken
+    uint16_t destination; //subroutine or handler
+    int bank;             //flash bank, SYMBOL_ANY_BANK off flash carts
+    bool interrupt;
+};
+
+struct BudgetOverrun {
+    uint64_t frame;
+    int slot;             //or BUDGET_FRAME_SLOT
+    uint64_t cycles;
+    uint64_t budget;
+    uint16_t pc;          //the write that stopped the stopwatch
+    int bank;
+    std::vector<BudgetCall> stack;
+    std::string savestate; //empty if none was written
+};
+
+struct BudgetStats {
+    uint64_t budget = 0;  //0 if none was declared
+    uint64_t measurements = 0;
+    uint64_t total_cycles = 0;
+    uint64_t worst_cycles = 0;
+    uint64_t overruns = 0;
+};
+
+// Cycle budgets the ROM declares for its VIA stopwatches, and for the CPU
+// time of a whole frame, checked as the stopwatches and frames complete.
+// A budget is declared on ORB with bit 7 set by a $FF marker and three writes
+// carrying 7 bits each of the cycle count, high bits first; the falling edge
+// that follows names the slot (bit 6 clear) or the frame (bit 6 set) instead
+// of starting or stopping a stopwatch. A budget of 0 removes it.
+// Overruns are logged with the frame number and the call stack, kept by
+// following JSR/RTS and interrupts once any budget is declared (an RTI drops
+// everything above the interrupt it returns from). The first overrun of each
+// slot, and of the frame budget, also asks for a savestate.
+class BudgetMonitor {
+private:
+    MemoryMap*& memory_map;
+    uint8_t payload[4];
+    int payload_count = 0;
+    uint16_t start_pc[BUDGET_SLOTS] = {0};
+    int start_bank[BUDGET_SLOTS] = {0};
+    BudgetCall stack[BUDGET_STACK_DEPTH];
+    size_t stack_depth = 0;
+    uint64_t frame_cycles = 0;
+    //overrun waiting for its savestate, -1 if none
+    int pending_savestate = -1;
+    //per slot, then the frame budget
+    bool savestate_taken[BUDGET_SLOTS + 1] = {false};
+    //names from the map they were last looked up in
+    const MemoryMap* named_from = NULL;
+    std::string names[BUDGET_SLOTS];
+    void Overrun(int slot, uint64_t cycles, uint64_t budget, uint16_t pc, int bank);
+public:
+    bool active = false;  //some budget has been declared
+    uint64_t frame = 0;
+    BudgetStats slots[BUDGET_SLOTS];
+    BudgetStats frames;
+    std::vector<BudgetOverrun> overruns;
+    uint64_t overrun_count = 0;
+    bool overrun_flag = false; //sticky, cleared from the profiler window
+
+    BudgetMonitor(MemoryMap*& map) : memory_map(map) {};
+    //Every ORB write. True if it completed a budget declaration,
+    //false if a falling edge is left for the stopwatches.
+    bool PortWrite(uint8_t old_value, uint8_t value);
+    void Start(uint8_t slot, uint16_t pc, int bank);
+    void Stop(uint8_t slot, uint64_t cycles, uint16_t pc, int bank);
+    inline void AddCycles(uint64_t cycles) { frame_cycles += cycles; }
+    void EndFrame();
+    void Call(uint16_t site, int bank, uint16_t destination, bool interrupt);
+    void Return(bool from_interrupt);
+    //The CPU was reset: no calls are open and no declaration is under way
+    void CPUReset();
+    void Clear();
+    bool SavestatePending() const { return pending_savestate >= 0; }
+    //"slot3_frame812" and so on, to tell the savestate files apart
+    std::string SavestateTag() const;
+    void SavestateWritten(const std::string& path);
+    bool Passed() const { return overrun_count == 0; }
+    //from the map if it names the slot, otherwise where the slot was last started
+    std::string Name(int slot);
+    std::string Describe(const BudgetCall& call) const;
+    bool WriteJSON(const char* filename);
+};
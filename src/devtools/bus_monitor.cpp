@@ -0,0 +1,77 @@
+#include "bus_monitor.h"
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+
+static uint64_t site_key(BusReadKind kind, uint16_t pc, uint8_t pc_bank, uint32_t address) {
+    return ((uint64_t) kind << 56) | ((uint64_t) pc_bank << 48) | ((uint64_t) pc << 32) | address;
+}
+
+void BusMonitor::Record(BusReadKind kind, uint16_t pc, uint8_t pc_bank, uint32_t address, uint64_t cycle) {
+    ++totals[kind];
+    auto found = sites.try_emplace(site_key(kind, pc, pc_bank, address), Counter{0, cycle});
+    ++found.first->second.count;
+}
+
+void BusMonitor::Clear() {
+    sites.clear();
+    std::fill(std::begin(totals), std::end(totals), 0);
+}
+
+std::vector<BusReadSite> BusMonitor::Sites() const {
+    std::vector<BusReadSite> out;
+    out.reserve(sites.size());
+    for(auto& site : sites) {
+        uint64_t key = site.first;
+        out.push_back({
+            (BusReadKind) (key >> 56),
+            (uint16_t) (key >> 32),
+            (uint8_t) (key >> 48),
+            (uint32_t) key,
+            site.second.count,
+            site.second.first_cycle});
+    }
+    std::sort(out.begin(), out.end(), [](const BusReadSite& a, const BusReadSite& b) {
+        if(a.count != b.count) return a.count > b.count;
+        return a.first_cycle < b.first_cycle;
+    });
+    return out;
+}
+
+const char* BusMonitor::KindName(BusReadKind kind) {
+    switch(kind) {
+        case BUS_UNINITIALIZED_RAM:
+        return "uninitialized_ram";
+        case BUS_OPEN_BUS:
+        return "open_bus";
+        default:
+        return "unknown";
+    }
+}
+
+bool BusMonitor::WriteJSON(const char* filename) const {
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        printf("Unable to write bus report to %s\n", filename);
+        return false;
+    }
+    file << "{\n";
+    file << "\t\"uninitialized_ram_reads\": " << totals[BUS_UNINITIALIZED_RAM] << ",\n";
+    file << "\t\"open_bus_reads\": " << totals[BUS_OPEN_BUS] << ",\n";
+    file << "\t\"sites\": [";
+    auto found = Sites();
+    for(size_t i = 0; i < found.size(); ++i) {
+        char pc[8], address[8];
+        snprintf(pc, sizeof(pc), "%04X", found[i].pc);
+        snprintf(address, sizeof(address), "%04X", found[i].address);
+        file << (i ? "," : "") << "\n\t\t{\"kind\": \"" << KindName(found[i].kind)
+            << "\", \"pc\": \"" << pc
+            << "\", \"bank\": " << (int) found[i].pc_bank
+            << ", \"address\": \"" << address
+            << "\", \"count\": " << found[i].count
+            << ", \"first_cycle\": " << found[i].first_cycle << "}";
+    }
+    file << "\n\t]\n";
+    file << "}\n";
+    return true;
+}
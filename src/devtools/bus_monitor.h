@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+
+enum BusReadKind {
+    BUS_UNINITIALIZED_RAM,
+    BUS_OPEN_BUS,
+    BUS_READ_KINDS
+};
+
+struct BusReadSite {
+    BusReadKind kind;
+    uint16_t pc;
+    uint8_t pc_bank;   //flash bank the reading code ran from
+    uint32_t address;  //full RAM address for RAM reads, CPU address otherwise
+    uint64_t count;
+    uint64_t first_cycle;
+};
+
+// Counts suspicious reads: RAM read before anything was written to it, and
+// reads of write-only hardware that only see open bus. Each distinct
+// (kind, PC, bank, address) is counted once in the table however often it
+// happens. Nothing is checked unless enabled.
+class BusMonitor {
+private:
+    struct Counter {
+        uint64_t count;
+        uint64_t first_cycle;
+    };
+    std::unordered_map<uint64_t, Counter> sites;
+public:
+    bool enabled = false;
+    uint64_t totals[BUS_READ_KINDS] = {0};
+
+    void Record(BusReadKind kind, uint16_t pc, uint8_t pc_bank, uint32_t address, uint64_t cycle);
+    void Clear();
+    size_t SiteCount() const { return sites.size(); }
+    //Most frequent first
+    std::vector<BusReadSite> Sites() const;
+    bool WriteJSON(const char* filename) const;
+
+    static const char* KindName(BusReadKind kind);
+};
@@ -78,7 +78,7 @@ static size_t opBytes[18] = {
 };
 
 
-void Disassembler::FormatArgBytes(std::stringstream& ss, MemoryMap* mem_map, uint16_t address, uint8_t opcode, uint16_t argBytes) {
+void Disassembler::FormatArgBytes(std::stringstream& ss, MemoryMap* mem_map, uint16_t address, uint8_t opcode, uint16_t argBytes, int bank) {
     #define FMT_ARG std::setw(argCount * 2) << std::setfill('0') << std::right << std::hex << argBytes
     std::stringstream argstream;
 
@@ -98,9 +98,9 @@ void Disassembler::FormatArgBytes(std::stringstream& ss, MemoryMap* mem_map, uin
             break;
     }
 
-    Symbol sym;
-    if(isAbsolute && mem_map->FindAddress(argBytes, &sym)) {
-        string name = sym.name;
+    const Symbol* sym = (isAbsolute && mem_map) ? mem_map->Lookup(argBytes, bank) : NULL;
+    if(sym != NULL) {
+        const string& name = sym->name;
         switch(mode) {
             case AB:
                 //Absolute
@@ -161,11 +161,10 @@ void Disassembler::FormatArgBytes(std::stringstream& ss, MemoryMap* mem_map, uin
                 //Program Counter Relative
                 //Check to see if the we're branching
                 if (mem_map && opcodeTakesLabels[opcode] == DL) {
-                    Symbol sym;
                     //Check to see if the branch target is a named label
-                    if(mem_map->FindAddress(address + (char) argBytes, &sym)) {
-                        string name = sym.name;
-                        argstream << name;
+                    const Symbol* sym = mem_map->Lookup(address + (char) argBytes, bank);
+                    if(sym != NULL) {
+                        argstream << sym->name;
                         break;
                     }
                 }
@@ -217,12 +216,11 @@ void Disassembler::FormatArgBytes(std::stringstream& ss, MemoryMap* mem_map, uin
 		// First check if it is a named label if so print the label
 		// Otherwise print it as a normal offset
                 if (mem_map && opcodeTakesLabels[opcode] == DL) {
-                    Symbol sym;
                     // Check to see if the branch target is a named label
 		    // Note that we only want the least significant byte of the argument
-                    if(mem_map->FindAddress(address + (char) relArg, &sym)) {
-                        string name = sym.name;
-                        argstream << name;
+                    const Symbol* sym = mem_map->Lookup(address + (char) relArg, bank);
+                    if(sym != NULL) {
+                        argstream << sym->name;
                         break;
                     }
                 }
@@ -240,7 +238,7 @@ void Disassembler::FormatArgBytes(std::stringstream& ss, MemoryMap* mem_map, uin
     ss << std::setw(ARG_PAD_LEN) << std::left << argstream.str();
 }
 
-vector<AsmLine> Disassembler::Decode(const std::function<uint8_t(uint16_t, bool)> mem_read, MemoryMap* mem_map, uint16_t address, size_t instruction_count) {
+vector<AsmLine> Disassembler::Decode(const std::function<uint8_t(uint16_t, bool)> mem_read, MemoryMap* mem_map, uint16_t address, size_t instruction_count, int bank) {
     vector<AsmLine>& output = lastDecode;
     output.clear();
 
@@ -249,10 +247,10 @@ vector<AsmLine> Disassembler::Decode(const std::function<uint8_t(uint16_t, bool)
         uint8_t instructionBytes[MAX_INSTRUCTION_SIZE];
 
         if(mem_map) {
-            Symbol sym;
-            if(mem_map->FindAddress(address, &sym)) {
+            const Symbol* sym = mem_map->Lookup(address, bank);
+            if(sym != NULL) {
                 AsmLine labelLine;
-                labelLine.disassembledLine = sym.name + ':';
+                labelLine.disassembledLine = sym->name + ':';
                 labelLine.address = address;
                 labelLine.isLabel = true;
                 output.push_back(labelLine);
@@ -288,7 +286,7 @@ vector<AsmLine> Disassembler::Decode(const std::function<uint8_t(uint16_t, bool)
                 args += secondArg << 8;
                 instructionBytes[2] = secondArg;
             }
-            FormatArgBytes(ss, mem_map, address, opcode, args);
+            FormatArgBytes(ss, mem_map, address, opcode, args, bank);
             line.args = args;
         }
 
@@ -311,3 +309,7 @@ vector<AsmLine> Disassembler::Decode(const std::function<uint8_t(uint16_t, bool)
 vector<AsmLine> Disassembler::GetLastDecode() {
     return lastDecode;
 }
+
+const string& Disassembler::OpcodeName(uint8_t opcode) {
+    return opcodeNames[opcode];
+}
@@ -36,13 +36,14 @@ private:
         // Absolute Label
         AL
     };
-        static void FormatArgBytes(std::stringstream& ss, MemoryMap* mem_map, uint16_t address, uint8_t opcode, uint16_t argBytes);
+        static void FormatArgBytes(std::stringstream& ss, MemoryMap* mem_map, uint16_t address, uint8_t opcode, uint16_t argBytes, int bank);
     static vector<string> opcodeNames;
     static AddressMode opcodeModes[256];
     static ArgIsLabel opcodeTakesLabels[256];
     static vector<AsmLine> lastDecode;
 public:
 
-    static vector<AsmLine> Decode(const std::function<uint8_t(uint16_t, bool)> mem_read, MemoryMap* mem_map, uint16_t address, size_t instruction_count);
+    static vector<AsmLine> Decode(const std::function<uint8_t(uint16_t, bool)> mem_read, MemoryMap* mem_map, uint16_t address, size_t instruction_count, int bank = SYMBOL_ANY_BANK);
     static vector<AsmLine> GetLastDecode();
+    static const string& OpcodeName(uint8_t opcode);
 };
@@ -0,0 +1,146 @@
+#include "exec_coverage.h"
+#include "../page_arena.h"
+#include <algorithm>
+#include <map>
+#include <cstdio>
+
+ExecCoverage::~ExecCoverage() {
+    FreePageArena((uint8_t*) arena, entries * sizeof(ExecCounter));
+}
+
+void ExecCoverage::Allocate() {
+    FreePageArena((uint8_t*) arena, entries * sizeof(ExecCounter));
+    entries = EXEC_ROM_BASE + rom_size;
+    arena = (ExecCounter*) AllocatePageArena(entries * sizeof(ExecCounter));
+}
+
+void ExecCoverage::Configure(size_t rom_size, bool banked) {
+    this->rom_size = rom_size;
+    this->banked = banked;
+    if(rom_size != 0) {
+        Allocate();
+    }
+    std::fill(std::begin(opcodes), std::end(opcodes), ExecCounter{0, 0});
+}
+
+void ExecCoverage::Clear() {
+    ClearPageArena((uint8_t*) arena, entries * sizeof(ExecCounter));
+    std::fill(std::begin(opcodes), std::end(opcodes), ExecCounter{0, 0});
+}
+
+void ExecCoverage::Attach(mos6502* cpu, uint8_t ram_bank, uint8_t bank_mask) {
+    if(!enabled || !arena) {
+        cpu->execOpcodes = NULL;
+        return;
+    }
+    cpu->execPages[0] = arena + ram_bank * EXEC_PAGE_SIZE;
+    for(int page = 1; page < 4; ++page) {
+        cpu->execPages[page] = arena + EXEC_RAM_ENTRIES + (page - 1) * EXEC_PAGE_SIZE;
+    }
+    for(int page = 4; page < 8; ++page) {
+        uint16_t address = page * EXEC_PAGE_SIZE;
+        cpu->execPages[page] = Rom(((address & 0xC000) == 0x8000) ? (bank_mask & 127) : 127, address);
+    }
+    cpu->execOpcodes = opcodes;
+}
+
+ExecCounter* ExecCoverage::Rom(int bank, uint16_t address) {
+    size_t offset;
+    if(banked) {
+        offset = ((size_t) (bank & 127) << 14) | (address & 0x3FFF);
+    } else {
+        offset = address & (rom_size - 1);
+    }
+    return arena + EXEC_ROM_BASE + offset;
+}
+
+const ExecCounter* ExecCoverage::At(uint16_t address, uint8_t ram_bank, uint8_t bank_mask) const {
+    if(!arena) {
+        return NULL;
+    }
+    if(address & 0x8000) {
+        int bank = ((address & 0xC000) == 0x8000) ? (bank_mask & 127) : 127;
+        return const_cast<ExecCoverage*>(this)->Rom(bank, address);
+    } else if(address < 0x2000) {
+        return arena + ram_bank * EXEC_PAGE_SIZE + address;
+    }
+    return arena + EXEC_RAM_ENTRIES + (address - 0x2000);
+}
+
+std::vector<HotAddress> ExecCoverage::Hottest(size_t count) const {
+    std::vector<HotAddress> out;
+    for(size_t i = 0; i < entries; ++i) {
+        if(arena[i].count == 0) {
+            continue;
+        }
+        HotAddress hot;
+        hot.counter = arena[i];
+        hot.bank = -1;
+        hot.ram_bank = -1;
+        if(i < EXEC_RAM_ENTRIES) {
+            hot.address = i & 0x1FFF;
+            hot.ram_bank = i / EXEC_PAGE_SIZE;
+        } else if(i < EXEC_ROM_BASE) {
+            hot.address = 0x2000 + (i - EXEC_RAM_ENTRIES);
+        } else if(banked) {
+            size_t offset = i - EXEC_ROM_BASE;
+            hot.bank = (offset >> 14) & 127;
+            hot.address = ((hot.bank == 127) ? 0xC000 : 0x8000) | (offset & 0x3FFF);
+            if(hot.bank == 127) {
+                hot.bank = -1;
+            }
+        } else {
+            hot.address = 0x10000 - rom_size + (i - EXEC_ROM_BASE);
+        }
+        out.push_back(hot);
+    }
+    size_t keep = std::min(count, out.size());
+    std::partial_sort(out.begin(), out.begin() + keep, out.end(), [](const HotAddress& a, const HotAddress& b) {
+        return a.counter.cycles > b.counter.cycles;
+    });
+    out.resize(keep);
+    return out;
+}
+
+uint64_t ExecCoverage::TotalCycles() const {
+    uint64_t total = 0;
+    for(auto& opcode : opcodes) {
+        total += opcode.cycles;
+    }
+    return total;
+}
+
+bool ExecCoverage::WriteLcov(const char* filename, SourceMap* source_map) {
+    if(!source_map) {
+        printf("No source map loaded, can't write coverage to %s\n", filename);
+        return false;
+    }
+    FILE* file = fopen(filename, "w");
+    if(!file) {
+        printf("Unable to write coverage to %s\n", filename);
+        return false;
+    }
+    //file name -> line -> hits
+    std::map<std::string, std::map<unsigned int, uint64_t>> hits;
+    source_map->ForEachAddressRun([&](uint8_t bank, uint16_t start, uint16_t end, const SourceMapFile& source, const SourceMapLine& line) {
+        uint64_t& line_hits = hits[source.name][line.line];
+        if(!arena || !(start & 0x8000)) {
+            return;
+        }
+        for(uint32_t address = start; address <= end; ++address) {
+            line_hits = std::max(line_hits, Rom(bank, address)->count);
+        }
+    });
+    fprintf(file, "TN:\n");
+    for(auto& source : hits) {
+        fprintf(file, "SF:%s/%s\n", source_map->project_root.c_str(), source.first.c_str());
+        size_t hit = 0;
+        for(auto& line : source.second) {
+            fprintf(file, "DA:%u,%llu\n", line.first, (unsigned long long) line.second);
+            hit += (line.second != 0);
+        }
+        fprintf(file, "LF:%zu\nLH:%zu\nend_of_record\n", source.second.size(), hit);
+    }
+    fclose(file);
+    return true;
+}
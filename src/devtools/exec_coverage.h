@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "../mos6502/mos6502.h"
+#include "source_map.h"
+
+//The CPU's counter pages are this big
+#define EXEC_PAGE_SIZE 0x2000
+//System RAM, then $2000-$7FFF, then the ROM
+#define EXEC_RAM_ENTRIES 0x8000
+#define EXEC_MISC_ENTRIES 0x6000
+#define EXEC_ROM_BASE (EXEC_RAM_ENTRIES + EXEC_MISC_ENTRIES)
+
+struct HotAddress {
+    uint16_t address;
+    int bank;    //flash bank, or -1 outside the banked window
+    int ram_bank; //RAM bank below $2000, or -1 above it
+    ExecCounter counter;
+};
+
+// Execution counts for every instruction address the CPU can run from: all
+// 32K of system RAM and every byte of the ROM, each flash bank separately.
+// The counters are one arena sized for the ROM type, and the CPU increments
+// them directly through eight page pointers that MapPages keeps pointed at
+// the RAM and flash banks currently switched in. The arena's pages are only
+// backed by memory once something runs from them.
+class ExecCoverage {
+private:
+    ExecCounter* arena = NULL;
+    size_t entries = 0;
+    size_t rom_size = 0;
+    bool banked = false;
+    void Allocate();
+public:
+    bool enabled = false;
+    ExecCounter opcodes[256] = {};
+
+    ~ExecCoverage();
+    //rom_size of 8K, 32K or 2M; banked for flash carts
+    void Configure(size_t rom_size, bool banked);
+    void Clear();
+    //Points the CPU at the counters, or detaches it when disabled
+    void Attach(mos6502* cpu, uint8_t ram_bank, uint8_t bank_mask);
+    ExecCounter* Rom(int bank, uint16_t address);
+    //Counter for an address as the CPU currently sees it
+    const ExecCounter* At(uint16_t address, uint8_t ram_bank, uint8_t bank_mask) const;
+    std::vector<HotAddress> Hottest(size_t count) const;
+    uint64_t TotalCycles() const;
+    //lcov tracefile of source lines reached, hit counts are the busiest instruction on each line
+    bool WriteLcov(const char* filename, SourceMap* source_map);
+};
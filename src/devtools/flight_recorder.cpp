@@ -0,0 +1,225 @@
+#include "flight_recorder.h"
+#include "disassembler.h"
+#include "../page_arena.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+FlightRecorder::~FlightRecorder() {
+    Allocate(0);
+}
+
+void FlightRecorder::Allocate(size_t records) {
+    if(ring != NULL) {
+        FreePageArena((uint8_t*) ring, size * sizeof(FlightRecord));
+        ring = NULL;
+    }
+    size = 0;
+    count = 0;
+    dumped_at = UINT64_MAX;
+    enabled = (records != 0);
+    if(enabled) {
+        size = 1;
+        while(size < records) {
+            size <<= 1;
+        }
+        ring = (FlightRecord*) AllocatePageArena(size * sizeof(FlightRecord));
+    }
+}
+
+void FlightRecorder::Trigger(const std::string& reason) {
+    if(!enabled || !pending.empty() || (count == dumped_at)) {
+        return;
+    }
+    pending = reason;
+}
+
+bool FlightRecorder::Dump(const std::string& filename, bool banked) {
+    std::string reason = pending;
+    pending.clear();
+    dumped_at = count;
+    FILE* file = fopen(filename.c_str(), "wb");
+    if(!file) {
+        printf("Unable to write flight recording to %s\n", filename.c_str());
+        return false;
+    }
+    FlightDumpHeader header = {};
+    memcpy(header.magic, FLIGHT_RECORDER_MAGIC, sizeof(header.magic));
+    header.version = FLIGHT_RECORDER_VERSION;
+    header.records = std::min((uint64_t) size, count);
+    header.recorded = count;
+    header.cycle = timekeeper.totalCyclesCount;
+    header.banked = banked;
+    strncpy(header.reason, reason.c_str(), sizeof(header.reason) - 1);
+    fwrite(&header, sizeof(header), 1, file);
+    //oldest first, in at most two runs
+    size_t oldest = (count - header.records) & (size - 1);
+    size_t first_run = std::min((size_t) header.records, size - oldest);
+    fwrite(ring + oldest, sizeof(FlightRecord), first_run, file);
+    fwrite(ring, sizeof(FlightRecord), header.records - first_run, file);
+    fclose(file);
+    printf("Flight recording (%s) of %llu instructions written to %s\n", reason.c_str(), (unsigned long long) header.records, filename.c_str());
+    return true;
+}
+
+//"C000" or "C000-C0FF", in hex unless decimal is asked for
+static bool parse_range(const char* text, uint64_t& first, uint64_t& last, int base) {
+    char* end;
+    first = strtoull(text, &end, base);
+    if(end == text) {
+        return false;
+    }
+    last = first;
+    if(*end == '-') {
+        const char* second = end + 1;
+        last = strtoull(second, &end, base);
+        if(end == second) {
+            return false;
+        }
+    }
+    return (*end == '\0') || (*end == ',');
+}
+
+bool FlightQuery::Parse(const char* filter) {
+    const char* key = filter;
+    while(*key) {
+        const char* value = strchr(key, '=');
+        if(value == NULL) {
+            printf("Flight filter %s is missing a value\n", key);
+            return false;
+        }
+        std::string name(key, value - key);
+        ++value;
+        uint64_t first, last;
+        bool ok = parse_range(value, first, last, (name == "cycle") ? 10 : 16);
+        if(ok && (name == "pc")) {
+            pc_first = first;
+            pc_last = last;
+        } else if(ok && (name == "cycle")) {
+            cycle_first = first;
+            cycle_last = last;
+        } else if(ok && (first == last)) {
+            int* field = (name == "bank") ? &bank : (name == "opcode") ? &opcode : (name == "a") ? &a :
+                (name == "x") ? &x : (name == "y") ? &y : (name == "sp") ? &sp : NULL;
+            if(field == NULL) {
+                printf("Unknown flight filter %s\n", name.c_str());
+                return false;
+            }
+            *field = first;
+        } else {
+            printf("Bad value for flight filter %s\n", name.c_str());
+            return false;
+        }
+        const char* next = strchr(value, ',');
+        key = next ? next + 1 : value + strlen(value);
+    }
+    return true;
+}
+
+static const char* status_flags(uint8_t status) {
+    static char text[9];
+    const char* names = "NV-BDIZC";
+    for(int bit = 0; bit < 8; ++bit) {
+        text[bit] = (status & (0x80 >> bit)) ? names[bit] : '.';
+    }
+    text[8] = '\0';
+    return text;
+}
+
+int FlightRecorder::Query(const char* filename, const FlightQuery& query, MemoryMap* memory_map) {
+    FILE* file = fopen(filename, "rb");
+    if(!file) {
+        printf("Unable to open flight recording %s\n", filename);
+        return 1;
+    }
+    FlightDumpHeader header;
+    if((fread(&header, sizeof(header), 1, file) != 1) || (memcmp(header.magic, FLIGHT_RECORDER_MAGIC, sizeof(header.magic)) != 0)
+        || (header.version != FLIGHT_RECORDER_VERSION)) {
+        printf("%s is not a flight recording\n", filename);
+        fclose(file);
+        return 1;
+    }
+    header.reason[sizeof(header.reason) - 1] = '\0';
+    //a truncated or damaged dump holds fewer records than it claims
+    std::error_code error;
+    uint64_t file_size = std::filesystem::file_size(filename, error);
+    uint64_t available = error ? 0 : (file_size - std::min(file_size, (uint64_t) sizeof(header))) / sizeof(FlightRecord);
+    if(header.records > available) {
+        printf("%s is cut short, %llu of %llu records are there\n", filename,
+            (unsigned long long) available, (unsigned long long) header.records);
+        header.records = available;
+    }
+    std::vector<FlightRecord> records(header.records);
+    size_t read = fread(records.data(), sizeof(FlightRecord), records.size(), file);
+    fclose(file);
+    records.resize(read);
+
+    //rebuild full cycle counts from the newest back
+    std::vector<uint64_t> cycles(records.size());
+    uint64_t cycle = header.cycle;
+    uint32_t low = header.cycle & 0xFFFFFF;
+    for(size_t i = records.size(); i > 0; --i) {
+        const FlightRecord& record = records[i - 1];
+        uint32_t record_low = record.cycle[0] | (record.cycle[1] << 8) | (record.cycle[2] << 16);
+        cycle -= (low - record_low) & 0xFFFFFF;
+        low = record_low;
+        cycles[i - 1] = cycle;
+    }
+    if(!records.empty()) {
+        printf("Flight recording (%s): %llu of %llu instructions, cycles %llu to %llu\n", header.reason,
+            (unsigned long long) records.size(), (unsigned long long) header.recorded, (unsigned long long) cycles.front(), (unsigned long long) cycles.back());
+    }
+
+    std::vector<size_t> matches;
+    for(size_t i = 0; i < records.size(); ++i) {
+        const FlightRecord& record = records[i];
+        if((record.pc < query.pc_first) || (record.pc > query.pc_last)
+            || (cycles[i] < query.cycle_first) || (cycles[i] > query.cycle_last)
+            || ((query.bank >= 0) && (record.bank != query.bank))
+            || ((query.opcode >= 0) && (record.opcode != query.opcode))
+            || ((query.a >= 0) && (record.a != query.a))
+            || ((query.x >= 0) && (record.x != query.x))
+            || ((query.y >= 0) && (record.y != query.y))
+            || ((query.sp >= 0) && (record.sp != query.sp))) {
+            continue;
+        }
+        matches.push_back(i);
+    }
+    if(query.last && (matches.size() > query.last)) {
+        matches.erase(matches.begin(), matches.end() - query.last);
+    }
+
+    auto describe = [&](uint16_t pc, uint8_t bank) {
+        return (memory_map != NULL) ? memory_map->Describe(pc, header.banked ? bank : SYMBOL_ANY_BANK) : std::string();
+    };
+
+    if(query.hot) {
+        std::unordered_map<uint32_t, uint64_t> counts;
+        for(size_t i : matches) {
+            ++counts[(records[i].bank << 16) | records[i].pc];
+        }
+        std::vector<std::pair<uint32_t, uint64_t>> sorted(counts.begin(), counts.end());
+        std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) {
+            return a.second > b.second;
+        });
+        for(size_t i = 0; (i < sorted.size()) && (i < query.hot); ++i) {
+            uint16_t pc = sorted[i].first & 0xFFFF;
+            uint8_t bank = sorted[i].first >> 16;
+            printf("%02X:%04X %10llu %5.1f%%  %s\n", bank, pc, (unsigned long long) sorted[i].second,
+                (100.0 * sorted[i].second) / matches.size(), describe(pc, bank).c_str());
+        }
+        return 0;
+    }
+
+    for(size_t i : matches) {
+        const FlightRecord& record = records[i];
+        printf("%12llu  %02X:%04X  %02X %-4s  A=%02X X=%02X Y=%02X SP=%02X P=%s  %s\n", (unsigned long long) cycles[i],
+            record.bank, record.pc, record.opcode, Disassembler::OpcodeName(record.opcode).c_str(),
+            record.a, record.x, record.y, record.sp, status_flags(record.status), describe(record.pc, record.bank).c_str());
+    }
+    return 0;
+}
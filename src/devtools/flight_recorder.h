@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "../timekeeper.h"
+#include "memory_map.h"
+
+#define FLIGHT_RECORDER_MAGIC "GTFR"
+#define FLIGHT_RECORDER_VERSION 1
+
+//One instruction as it was about to run
+struct FlightRecord {
+    uint16_t pc;
+    uint8_t bank;       //the cartridge bank register
+    uint8_t opcode;
+    uint8_t a, x, y, sp, status;
+    uint8_t cycle[3];   //low 24 bits of the cycle count
+};
+static_assert(sizeof(FlightRecord) == 12, "FlightRecord is written to dumps as is");
+
+struct FlightDumpHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t records;   //that follow, oldest first
+    uint64_t recorded;  //instructions seen since recording started
+    uint64_t cycle;     //cycle count when dumped
+    uint8_t banked;     //the cartridge has a bank register
+    char reason[31];
+};
+
+//What a query prints, parsed from --flight-filter
+struct FlightQuery {
+    uint16_t pc_first = 0;
+    uint16_t pc_last = 0xFFFF;
+    int bank = -1;      //-1 matches any
+    int opcode = -1;
+    int a = -1, x = -1, y = -1, sp = -1;
+    uint64_t cycle_first = 0;
+    uint64_t cycle_last = UINT64_MAX;
+    uint64_t last = 0;  //only the last this many matches, 0 for all
+    size_t hot = 0;     //instead of listing, the busiest addresses
+    bool Parse(const char* filter);
+};
+
+// Keeps the last instructions run, each packed to 12 bytes, in a ring that
+// is a power of two long so recording is one store and an increment. Full
+// cycle counts are rebuilt from the 24 bit ones when a dump is read, which
+// holds as long as no instruction takes 16M cycles to come round, WAI
+// included.
+// A dump is asked for on an illegal opcode, STP, the CPU getting stuck or
+// the hotkey, and written with the ring oldest first and a savestate once
+// the emulator is between batches. Asking again with nothing run since the
+// last dump does nothing.
+class FlightRecorder {
+private:
+    Timekeeper& timekeeper;
+    FlightRecord* ring = NULL;
+    size_t size = 0;
+    uint64_t count = 0;
+    uint64_t dumped_at = UINT64_MAX;
+    std::string pending;
+public:
+    bool enabled = false;
+
+    FlightRecorder(Timekeeper& tk) : timekeeper(tk) {};
+    ~FlightRecorder();
+    //Rounded up to a power of two, 0 stops recording
+    void Allocate(size_t records);
+    inline void Record(uint16_t pc, uint8_t bank, uint8_t opcode, uint8_t a, uint8_t x, uint8_t y, uint8_t sp, uint8_t status) {
+        uint32_t cycle = (uint32_t) timekeeper.totalCyclesCount;
+        ring[count++ & (size - 1)] = {pc, bank, opcode, a, x, y, sp, status,
+            {(uint8_t) cycle, (uint8_t) (cycle >> 8), (uint8_t) (cycle >> 16)}};
+    }
+    void Trigger(const std::string& reason);
+    bool DumpPending() const { return !pending.empty(); }
+    const std::string& PendingReason() const { return pending; }
+    //Writes the ring and clears the pending dump
+    bool Dump(const std::string& filename, bool banked);
+
+    //Prints the records of a dump matching the query, for --flight-query
+    static int Query(const char* filename, const FlightQuery& query, MemoryMap* memory_map);
+};
@@ -0,0 +1,155 @@
+#include "hardware_trace.h"
+#include "trace_writer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static const char* kind_names[HW_EVENT_KINDS] = {
+    "DMA control",
+    "Banking",
+    "VIA ORA",
+    "VIA ORB",
+    "ACP register",
+    "Blit trigger",
+    "Buffer flip",
+    "Vsync",
+    "Blit IRQ"
+};
+
+static const char* kind_keys[HW_EVENT_KINDS] = {
+    "dma",
+    "banking",
+    "ora",
+    "orb",
+    "acp",
+    "blit",
+    "flip",
+    "vsync",
+    "irq"
+};
+
+void HardwareTrace::Push(const HardwareEvent& event) {
+    ++frame_counts[event.kind];
+    if(!ring.push(event)) {
+        ++dropped;
+    }
+}
+
+void HardwareTrace::EndFrame(uint16_t pc, int bank, uint16_t handler, bool nmi) {
+    Push({timekeeper.totalCyclesCount, pc, handler, HW_VSYNC, PackBank(bank), 0, (uint8_t) nmi});
+    for(int kind = 0; kind < HW_EVENT_KINDS; ++kind) {
+        last_frame_counts[kind] = frame_counts[kind];
+        max_frame_counts[kind] = std::max(max_frame_counts[kind], frame_counts[kind]);
+        frame_counts[kind] = 0;
+    }
+    Drain();
+}
+
+void HardwareTrace::Drain() {
+    HardwareEvent event;
+    while(ring.pop(event)) {
+        history.push_back(event);
+    }
+    while(history.size() > HW_TRACE_HISTORY) {
+        history.pop_front();
+    }
+}
+
+void HardwareTrace::Clear() {
+    ring.clear();
+    history.clear();
+    dropped = 0;
+    std::fill(std::begin(frame_counts), std::end(frame_counts), 0);
+    std::fill(std::begin(last_frame_counts), std::end(last_frame_counts), 0);
+    std::fill(std::begin(max_frame_counts), std::end(max_frame_counts), 0);
+}
+
+bool HardwareTrace::Frame(int back, size_t& first, size_t& last, uint64_t& start, uint64_t& end) const {
+    //vsyncs from the newest, the frame sits between the back'th and the one before it
+    int seen = 0;
+    for(size_t i = history.size(); i > 0; --i) {
+        if(history[i - 1].kind != HW_VSYNC) {
+            continue;
+        }
+        if(seen == back) {
+            last = i - 1;
+            end = history[i - 1].cycle;
+        } else if(seen == back + 1) {
+            first = i;
+            start = history[i - 1].cycle;
+            return true;
+        }
+        ++seen;
+    }
+    return false;
+}
+
+int HardwareTrace::FramesKept() const {
+    int vsyncs = 0;
+    for(const HardwareEvent& event : history) {
+        vsyncs += (event.kind == HW_VSYNC);
+    }
+    return std::max(vsyncs - 1, 0);
+}
+
+bool HardwareTrace::WriteTrace(const std::string& filename, MemoryMap* memory_map) {
+    Drain();
+    char otherData[96];
+    snprintf(otherData, sizeof(otherData), "\"events\": %llu, \"dropped_events\": %llu",
+        (unsigned long long) history.size(), (unsigned long long) dropped);
+    TraceWriter trace;
+    if(!trace.Open(filename, timekeeper.system_clock, history.empty() ? 0 : history.front().cycle, otherData)) {
+        printf("Unable to write hardware trace to %s\n", filename.c_str());
+        return false;
+    }
+    for(int kind = 0; kind < HW_EVENT_KINDS; ++kind) {
+        trace.ThreadName(kind + 1, kind_names[kind]);
+    }
+    for(const HardwareEvent& event : history) {
+        std::string code = (memory_map != NULL) ? memory_map->Describe(event.pc, event.bank) : "";
+        if(code.empty()) {
+            char hex[8];
+            snprintf(hex, sizeof(hex), "$%04X", event.pc);
+            code = hex;
+        }
+        char values[64];
+        snprintf(values, sizeof(values), ", \"address\": \"$%04X\", \"old\": %d, \"value\": %d", event.address, event.old_value, event.value);
+        trace.Instant(event.kind + 1, kind_names[event.kind], event.cycle,
+            "\"cycle\": " + std::to_string(event.cycle) + ", \"pc\": " + json_string(code) + values);
+    }
+    trace.Close();
+    printf("Hardware trace written to %s: %llu events, %llu dropped\n", filename.c_str(),
+        (unsigned long long) history.size(), (unsigned long long) dropped);
+    return true;
+}
+
+const char* HardwareTrace::KindName(HardwareEventKind kind) {
+    return kind_names[kind];
+}
+
+const char* HardwareTrace::KindKey(HardwareEventKind kind) {
+    return kind_keys[kind];
+}
+
+uint32_t HardwareTrace::KindMask(const char* list) {
+    uint32_t mask = 0;
+    const char* start = list;
+    while(*start) {
+        size_t length = strcspn(start, ",");
+        bool found = false;
+        for(int kind = 0; kind < HW_EVENT_KINDS; ++kind) {
+            if((strlen(kind_keys[kind]) == length) && (strncmp(start, kind_keys[kind], length) == 0)) {
+                mask |= 1 << kind;
+                found = true;
+            }
+        }
+        if(!found && length) {
+            printf("Unknown hardware event kind %.*s\n", (int) length, start);
+        }
+        start += length;
+        if(*start == ',') {
+            ++start;
+        }
+    }
+    return mask;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include "../timekeeper.h"
+#include "../ring_buffer.h"
+#include "memory_map.h"
+
+//Events one frame can hold before the ring is drained at vsync
+#define HW_TRACE_RING_SIZE (1 << 16)
+//Events kept for the viewer and the trace file
+#define HW_TRACE_HISTORY (1 << 18)
+
+enum HardwareEventKind : uint8_t {
+    HW_DMA_CONTROL,
+    HW_BANKING,
+    HW_VIA_ORA,
+    HW_VIA_ORB,
+    HW_ACP_REGISTER,
+    HW_BLIT,         //a write to the blitter's trigger
+    HW_BUFFER_FLIP,
+    HW_VSYNC,        //value is 1 if the NMI was delivered
+    HW_BLIT_IRQ,     //value is 1 if the CPU took it, 0 if masked
+    HW_EVENT_KINDS
+};
+
+struct HardwareEvent {
+    uint64_t cycle;
+    uint16_t pc;        //instruction that wrote, or that was interrupted
+    uint16_t address;   //register written, the NMI handler or the IRQ vector
+    HardwareEventKind kind;
+    int8_t bank;        //flash bank of pc (bit 7 dropped), SYMBOL_ANY_BANK on carts without one
+    uint8_t old_value;
+    uint8_t value;
+};
+
+// A cycle stamped log of the writes that steer the hardware (DMA control,
+// banking, the VIA ports, ACP registers, blit triggers and buffer flips)
+// and of vsync NMI and blit IRQ delivery. Events go into a lock-free ring
+// that is drained into the kept history at every vsync, so recording
+// costs a push; a frame with more events than the ring holds loses the
+// rest and counts them as dropped. Kinds can be left out of the recording,
+// except vsync which marks the frames.
+// Nothing is recorded unless enabled.
+class HardwareTrace {
+private:
+    Timekeeper& timekeeper;
+    RingBuffer<HardwareEvent, HW_TRACE_RING_SIZE> ring;
+    uint32_t frame_counts[HW_EVENT_KINDS] = {0};
+    void Push(const HardwareEvent& event);
+    static int8_t PackBank(int bank) { return (bank == SYMBOL_ANY_BANK) ? SYMBOL_ANY_BANK : (bank & 127); }
+public:
+    bool enabled = false;
+    uint32_t kinds = (1 << HW_EVENT_KINDS) - 1; //recorded, by bit
+    std::string traceFile = "hardware_trace.json";
+    std::deque<HardwareEvent> history; //oldest first
+    uint64_t dropped = 0;
+    uint32_t last_frame_counts[HW_EVENT_KINDS] = {0};
+    uint32_t max_frame_counts[HW_EVENT_KINDS] = {0};
+
+    HardwareTrace(Timekeeper& tk) : timekeeper(tk) {};
+    inline void Record(HardwareEventKind kind, uint16_t pc, int bank, uint16_t address, uint8_t old_value, uint8_t value) {
+        if(kinds & (1 << kind)) {
+            Push({timekeeper.totalCyclesCount, pc, address, kind, PackBank(bank), old_value, value});
+        }
+    }
+    //Records the vsync and moves the frame's events to the history
+    void EndFrame(uint16_t pc, int bank, uint16_t handler, bool nmi);
+    void Drain();
+    void Clear();
+    //Events of a whole frame, 0 being the last one finished: history[first]
+    //up to but not including history[last], between vsyncs at start and end
+    bool Frame(int back, size_t& first, size_t& last, uint64_t& start, uint64_t& end) const;
+    int FramesKept() const;
+    //Chrome trace with a track for each kind
+    bool WriteTrace(const std::string& filename, MemoryMap* memory_map);
+
+    static const char* KindName(HardwareEventKind kind);
+    //Short names, as taken by KindMask
+    static const char* KindKey(HardwareEventKind kind);
+    //"flip,irq,vsync" and so on to a mask of kinds
+    static uint32_t KindMask(const char* list);
+};
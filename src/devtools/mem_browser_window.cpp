@@ -16,8 +16,86 @@ static const char* var_headers[3] = {
     "Value"
 };
 
+static const char* bus_kind_labels[BUS_READ_KINDS] = {
+    "Uninit RAM",
+    "Open bus"
+};
+
 static char const * mapFilterPatterns[1] = {"*.map"};
 
+//a 256 byte page per row
+#define HEAT_IMAGE_WIDTH 256
+#define HEAT_IMAGE_HEIGHT 128
+#define HEAT_IMAGE_SCALE 1.5f
+
+MemBrowserWindow::~MemBrowserWindow() {
+    if(heat_texture) {
+        SDL_DestroyTexture(heat_texture);
+    }
+}
+
+void MemBrowserWindow::RenderHeatmap() {
+    ImGui::Checkbox("Record", &heatmap.enabled);
+    ImGui::SameLine();
+    ImGui::Checkbox("Decay", &heatmap.decay);
+    ImGui::SameLine();
+    if(ImGui::Button("Clear")) {
+        heatmap.Clear();
+    }
+    if(ImGui::RadioButton("RAM", heat_region == HEAT_RAM)) {
+        heat_region = HEAT_RAM;
+    }
+    ImGui::SameLine();
+    if(ImGui::RadioButton("Save RAM", heat_region == HEAT_SAVE_RAM)) {
+        heat_region = HEAT_SAVE_RAM;
+    }
+    ImGui::Text("Green reads, red writes. Press H in the VRAM\nviewer for VRAM and GRAM.");
+
+    if(heat_texture == NULL) {
+        heat_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+            HEAT_IMAGE_WIDTH, HEAT_IMAGE_HEIGHT);
+        if(heat_texture == NULL) {
+            return;
+        }
+        SDL_SetTextureScaleMode(heat_texture, SDL_ScaleModeNearest);
+    }
+    void* pixels;
+    int pitch;
+    if(SDL_LockTexture(heat_texture, NULL, &pixels, &pitch) == 0) {
+        for(int y = 0; y < HEAT_IMAGE_HEIGHT; ++y) {
+            Uint32* row = (Uint32*) ((uint8_t*) pixels + y * pitch);
+            for(int x = 0; x < HEAT_IMAGE_WIDTH; ++x) {
+                row[x] = 0xFF000000 | heatmap.Color(heat_region, y * HEAT_IMAGE_WIDTH + x);
+            }
+        }
+        SDL_UnlockTexture(heat_texture);
+    }
+    ImGui::Image(heat_texture, {HEAT_IMAGE_WIDTH * HEAT_IMAGE_SCALE, HEAT_IMAGE_HEIGHT * HEAT_IMAGE_SCALE});
+
+    if(ImGui::IsItemHovered()) {
+        ImVec2 mouse = ImGui::GetMousePos();
+        ImVec2 origin = ImGui::GetItemRectMin();
+        int x = (int) ((mouse.x - origin.x) / HEAT_IMAGE_SCALE);
+        int y = (int) ((mouse.y - origin.y) / HEAT_IMAGE_SCALE);
+        if((x >= 0) && (x < HEAT_IMAGE_WIDTH) && (y >= 0) && (y < HEAT_IMAGE_HEIGHT)) {
+            uint32_t offset = y * HEAT_IMAGE_WIDTH + x;
+            ImGui::BeginTooltip();
+            if(heat_region == HEAT_RAM) {
+                uint16_t address = offset & 0x1FFF;
+                ImGui::Text("Bank %d %04x", offset >> 13, address);
+                if(memorymap != NULL) {
+                    ImGui::Text("%s", memorymap->Describe(address).c_str());
+                }
+            } else {
+                ImGui::Text("Half %d %04x", offset >> 14, 0x8000 | (offset & 0x3FFF));
+            }
+            ImGui::Text("Reads: %u", heatmap.Reads(heat_region, offset));
+            ImGui::Text("Writes: %u", heatmap.Writes(heat_region, offset));
+            ImGui::EndTooltip();
+        }
+    }
+}
+
 ImVec2 MemBrowserWindow::Render() {
     ImVec2 sizeOut = {0, 0};
     ImGui::Begin("Mem Browser", NULL, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoTitleBar);
@@ -213,7 +291,55 @@ ImVec2 MemBrowserWindow::Render() {
         }
         ImGui::EndTabItem();
     }
-    
+
+    if(ImGui::BeginTabItem("Bad reads")) {
+        ImGui::Checkbox("Record", &bus_monitor.enabled);
+        ImGui::SameLine();
+        if(ImGui::Button("Clear")) {
+            bus_monitor.Clear();
+        }
+        ImGui::Text("Uninitialized RAM reads: %llu", (unsigned long long) bus_monitor.totals[BUS_UNINITIALIZED_RAM]);
+        ImGui::Text("Open bus reads: %llu", (unsigned long long) bus_monitor.totals[BUS_OPEN_BUS]);
+        if(ImGui::BeginTable("badreads", 4, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY, ImVec2(400, 600))) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Kind", ImGuiTableColumnFlags_None);
+            ImGui::TableSetupColumn("PC", ImGuiTableColumnFlags_None);
+            ImGui::TableSetupColumn("Address", ImGuiTableColumnFlags_None);
+            ImGui::TableSetupColumn("Count", ImGuiTableColumnFlags_None);
+            ImGui::TableHeadersRow();
+
+            std::vector<BusReadSite> sites = bus_monitor.Sites();
+            ImGuiListClipper clipper;
+            clipper.Begin(sites.size());
+            while(clipper.Step()) {
+                for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                    const BusReadSite& site = sites[row];
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%s", bus_kind_labels[site.kind]);
+                    ImGui::TableSetColumnIndex(1);
+                    if(memorymap != NULL) {
+                        ImGui::Text("%02x:%s", site.pc_bank, memorymap->Describe(site.pc, site.pc_bank).c_str());
+                    } else {
+                        ImGui::Text("%02x:%04x", site.pc_bank, site.pc);
+                    }
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%04x", site.address);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%llu", (unsigned long long) site.count);
+                }
+            }
+            clipper.End();
+            ImGui::EndTable();
+        }
+        ImGui::EndTabItem();
+    }
+
+    if(ImGui::BeginTabItem("Heatmap")) {
+        RenderHeatmap();
+        ImGui::EndTabItem();
+    }
+
     ImGui::EndTabBar();
     ImGui::SetWindowPos({0, 0});
     ImGui::SetWindowSize({432, 800});
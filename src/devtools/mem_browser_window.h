@@ -1,6 +1,8 @@
 
 #include "debug_window.h"
 #include "memory_map.h"
+#include "bus_monitor.h"
+#include "memory_heatmap.h"
 #include "../game_config.h"
 #include <functional>
 
@@ -11,13 +13,22 @@ private:
     const std::function<uint8_t*(uint16_t)> ram_read;
     bool decimal = false;
     GameConfig &gameconfig;
+    BusMonitor &bus_monitor;
+    MemoryHeatmap &heatmap;
+    HeatmapRegion heat_region = HEAT_RAM;
+    SDL_Texture* heat_texture = NULL;
+    void RenderHeatmap();
 protected:
     ImVec2 Render();
 public:
     MemBrowserWindow(MemoryMap*& map, std::function<uint8_t(uint16_t, bool)> reader,
-    std::function<uint8_t*(uint16_t)> ram_read, GameConfig &gameconfig):
+    std::function<uint8_t*(uint16_t)> ram_read, GameConfig &gameconfig, BusMonitor &bus_monitor,
+    MemoryHeatmap &heatmap):
         memorymap(map), 
         mem_read(reader),
         ram_read(ram_read),
-        gameconfig(gameconfig) {};
+        gameconfig(gameconfig),
+        bus_monitor(bus_monitor),
+        heatmap(heatmap) {};
+    ~MemBrowserWindow();
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "memory_heatmap.h"
+#include "../page_arena.h"
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+static const size_t region_sizes[HEAT_REGIONS] = {
+    RAMSIZE,
+    VRAM_BUFFER_SIZE,
+    GRAM_BUFFER_SIZE,
+    CARTRAMSIZE
+};
+
+static const char* region_names[HEAT_REGIONS] = {
+    "RAM",
+    "VRAM",
+    "GRAM",
+    "Save RAM"
+};
+
+#define HEATMAP_ENTRIES (RAMSIZE + VRAM_BUFFER_SIZE + GRAM_BUFFER_SIZE + CARTRAMSIZE)
+#define HEATMAP_ARENA_SIZE (HEATMAP_ENTRIES * 2 * sizeof(uint16_t))
+
+MemoryHeatmap::MemoryHeatmap() {
+    Allocate();
+}
+
+MemoryHeatmap::~MemoryHeatmap() {
+    FreePageArena((uint8_t*) arena, HEATMAP_ARENA_SIZE);
+}
+
+void MemoryHeatmap::Allocate() {
+    arena = (uint16_t*) AllocatePageArena(HEATMAP_ARENA_SIZE);
+    uint16_t* next = arena;
+    for(int region = 0; region < HEAT_REGIONS; ++region) {
+        reads[region] = next;
+        writes[region] = next + region_sizes[region];
+        next += region_sizes[region] * 2;
+        active[region] = false;
+    }
+}
+
+void MemoryHeatmap::Clear() {
+    ClearPageArena((uint8_t*) arena, HEATMAP_ARENA_SIZE);
+    std::fill(std::begin(active), std::end(active), false);
+}
+
+void MemoryHeatmap::Decay() {
+    for(int region = 0; region < HEAT_REGIONS; ++region) {
+        if(!active[region]) {
+            continue;
+        }
+        //reads and writes sit next to each other
+        uint16_t* counts = reads[region];
+        size_t size = region_sizes[region] * 2;
+        uint16_t remaining = 0;
+        for(size_t i = 0; i < size; ++i) {
+            //rounding the loss up takes small counts down to zero
+            counts[i] -= (counts[i] + 7) >> 3;
+            remaining |= counts[i];
+        }
+        active[region] = (remaining != 0);
+    }
+}
+
+static inline uint32_t intensity(uint16_t count) {
+    if(count == 0) {
+        return 0;
+    }
+    uint32_t level = 40 + std::bit_width(count) * 14;
+    return (level > 255) ? 255 : level;
+}
+
+uint32_t MemoryHeatmap::Color(HeatmapRegion region, uint32_t offset) const {
+    return (intensity(writes[region][offset]) << 16) | (intensity(reads[region][offset]) << 8);
+}
+
+size_t MemoryHeatmap::Size(HeatmapRegion region) {
+    return region_sizes[region];
+}
+
+const char* MemoryHeatmap::RegionName(HeatmapRegion region) {
+    return region_names[region];
+}
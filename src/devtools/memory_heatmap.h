@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "../system_state.h"
+
+//Weight of one access, so a byte touched once a frame survives the decay
+#define HEATMAP_UNIT 8
+
+enum HeatmapRegion {
+    HEAT_RAM,
+    HEAT_VRAM,
+    HEAT_GRAM,
+    HEAT_SAVE_RAM,
+    HEAT_REGIONS
+};
+
+// Read and write counts for every byte of system RAM, VRAM, GRAM and the
+// cartridge's save RAM. With decay on, every count loses an eighth each frame
+// so the maps show what the game is busy with now; with it off they only
+// accumulate, which is how memory that is never touched shows up. Counts
+// saturate at 8191 accesses.
+// The counters live in one lazily backed arena and nothing is counted or
+// decayed unless enabled.
+class MemoryHeatmap {
+private:
+    uint16_t* arena = NULL;
+    uint16_t* reads[HEAT_REGIONS];
+    uint16_t* writes[HEAT_REGIONS];
+    //regions with counts still to decay
+    bool active[HEAT_REGIONS] = {};
+    void Allocate();
+    static inline void Bump(uint16_t& count) {
+        count = (count > UINT16_MAX - HEATMAP_UNIT) ? UINT16_MAX : count + HEATMAP_UNIT;
+    }
+public:
+    bool enabled = false;
+    bool decay = true;
+
+    MemoryHeatmap();
+    ~MemoryHeatmap();
+    inline void Read(HeatmapRegion region, uint32_t offset) {
+        Bump(reads[region][offset]);
+        active[region] = true;
+    }
+    inline void Write(HeatmapRegion region, uint32_t offset) {
+        Bump(writes[region][offset]);
+        active[region] = true;
+    }
+    //Accesses, less whatever has decayed
+    unsigned int Reads(HeatmapRegion region, uint32_t offset) const { return reads[region][offset] / HEATMAP_UNIT; }
+    unsigned int Writes(HeatmapRegion region, uint32_t offset) const { return writes[region][offset] / HEATMAP_UNIT; }
+    //Once per frame
+    void Decay();
+    void Clear();
+    //0xRRGGBB with writes in red and reads in green, on a log scale
+    uint32_t Color(HeatmapRegion region, uint32_t offset) const;
+
+    static size_t Size(HeatmapRegion region);
+    static const char* RegionName(HeatmapRegion region);
+};
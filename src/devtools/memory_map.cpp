@@ -4,6 +4,8 @@
 #include <iomanip>
 #include "memory_map.h"
 #include <cstdint>
+#include <cstdio>
+#include <algorithm>
 
 const char* memory_map_getter(const MemoryMap& items, int index) {
     if (index >= 0 && index < (int)items.GetCount()) {
@@ -58,6 +60,111 @@ MemoryMap::MemoryMap() {}
 
 MemoryMap::MemoryMap(const std::string& mapfile) : filename(mapfile) {
     parse();
+    buildIndex();
+}
+
+void MemoryMap::buildIndex() {
+    by_address.resize(symbols.size());
+    by_name.clear();
+    by_name.reserve(symbols.size());
+    for(uint32_t i = 0; i < symbols.size(); ++i) {
+        by_address[i] = i;
+        //first definition wins, like the old linear search
+        by_name.emplace(symbols[i].name, i);
+    }
+    std::stable_sort(by_address.begin(), by_address.end(), [this](uint32_t a, uint32_t b) {
+        if(symbols[a].address != symbols[b].address) return symbols[a].address < symbols[b].address;
+        return symbols[a].bank < symbols[b].bank;
+    });
+}
+
+//Banks as found in the debug info, by symbol name
+void MemoryMap::AssignBanks(const std::unordered_map<std::string, int>& banks) {
+    for(auto& sym : symbols) {
+        auto found = banks.find(sym.name);
+        if(found != banks.end()) {
+            sym.bank = found->second;
+        }
+    }
+    buildIndex();
+}
+
+//Only the $8000-$BFFF window is banked, above it is always the last bank
+static int normalize_bank(uint16_t address, int bank) {
+    if((bank == SYMBOL_ANY_BANK) || (address < 0x8000)) {
+        return SYMBOL_ANY_BANK;
+    }
+    if(address >= 0xC000) {
+        return 127;
+    }
+    return bank & 127;
+}
+
+static bool bank_matches(const Symbol& sym, int bank) {
+    return (bank == SYMBOL_ANY_BANK) || (sym.bank == SYMBOL_ANY_BANK) || ((sym.bank & 127) == bank);
+}
+
+const Symbol* MemoryMap::Lookup(uint16_t address, int bank) const {
+    bank = normalize_bank(address, bank);
+    auto it = std::lower_bound(by_address.begin(), by_address.end(), address, [this](uint32_t i, uint16_t addr) {
+        return symbols[i].address < addr;
+    });
+    for(; (it != by_address.end()) && (symbols[*it].address == address); ++it) {
+        if(bank_matches(symbols[*it], bank)) {
+            return &symbols[*it];
+        }
+    }
+    return NULL;
+}
+
+const Symbol* MemoryMap::Nearest(uint16_t address, int bank, uint16_t* offset) const {
+    bank = normalize_bank(address, bank);
+    auto it = std::upper_bound(by_address.begin(), by_address.end(), address, [this](uint16_t addr, uint32_t i) {
+        return addr < symbols[i].address;
+    });
+    while(it != by_address.begin()) {
+        --it;
+        uint32_t sym_index = *it;
+        const Symbol& sym = symbols[sym_index];
+        //don't reach back out of the banked window, or from ROM into RAM
+        if((address >= 0x8000) && (sym.address < (address & 0xC000))) {
+            break;
+        }
+        if(bank_matches(sym, bank)) {
+            //several symbols can share an address, take the first like Lookup
+            while((it != by_address.begin()) && (symbols[*(it - 1)].address == sym.address)) {
+                --it;
+                if(bank_matches(symbols[*it], bank)) {
+                    sym_index = *it;
+                }
+            }
+            if(offset != NULL) {
+                *offset = address - symbols[sym_index].address;
+            }
+            return &symbols[sym_index];
+        }
+    }
+    return NULL;
+}
+
+const Symbol* MemoryMap::LookupName(const std::string& name) const {
+    auto found = by_name.find(name);
+    return (found == by_name.end()) ? NULL : &symbols[found->second];
+}
+
+std::string MemoryMap::Describe(uint16_t address, int bank) const {
+    char text[16];
+    uint16_t offset;
+    const Symbol* sym = Nearest(address, bank, &offset);
+    if(sym == NULL) {
+        snprintf(text, sizeof(text), "$%04X", address);
+        return text;
+    }
+    if(offset == 0) {
+        return sym->name;
+    }
+    snprintf(text, sizeof(text), "+0x%X", offset);
+    return sym->name + text;
 }
 
 void MemoryMap::forEach(const std::function<void(const Symbol&)>& func) const {
@@ -78,24 +185,22 @@ const Symbol& MemoryMap::GetAt(int i) const {
     return symbols.at(i);
 }
 
-bool MemoryMap::FindAddress(uint16_t address, Symbol* result) const {
-    for(auto sym : symbols) {
-        if(sym.address == address) {
-            if(result != NULL) {
-                *result = sym;
-            }
-            return true;
-        }
+bool MemoryMap::FindAddress(uint16_t address, Symbol* result, int bank) const {
+    const Symbol* sym = Lookup(address, bank);
+    if(sym == NULL) {
+        return false;
+    }
+    if(result != NULL) {
+        *result = *sym;
     }
-    return false;
+    return true;
 }
 
-bool MemoryMap::FindName(uint16_t &address, std::string name) const {
-    for(auto sym : symbols) {
-        if(sym.name == name) {
-            address = sym.address;
-            return true;
-        }
+bool MemoryMap::FindName(uint16_t &address, const std::string& name) const {
+    const Symbol* sym = LookupName(name);
+    if(sym == NULL) {
+        return false;
     }
-    return false;   
-}
\ No newline at end of file
+    address = sym->address;
+    return true;
+}
@@ -2,19 +2,34 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <unordered_map>
 #include <stdint.h>
 
-typedef struct {
+//Symbol bank when it isn't known, or a lookup that accepts any bank
+#define SYMBOL_ANY_BANK -1
+
+struct Symbol {
     unsigned int address;
     std::string name;
     std::string flags;
-} Symbol;
+    //flash bank holding the symbol, only meaningful in the banked window
+    int bank = SYMBOL_ANY_BANK;
+};
 
+// Symbols from an ld65 map file.
+// The list keeps the map's order for browsing. Lookups go through an index
+// sorted by address (exact and nearest preceding symbol) and a hash of names.
+// Flash carts link every bank at $8000, so symbols can be told apart by bank
+// once AssignBanks has been given them from the debug info.
 class MemoryMap {
     private:
         std::vector<Symbol> symbols;
         std::string filename;
+        //indices into symbols ordered by address, then bank
+        std::vector<uint32_t> by_address;
+        std::unordered_map<std::string, uint32_t> by_name;
         void parse();
+        void buildIndex();
         void printSymbols() const;
     public:
         MemoryMap();
@@ -23,8 +38,14 @@ class MemoryMap {
         int GetCount() const;
         int size() const;
         const Symbol& GetAt(int i) const;
-        bool FindAddress(uint16_t address, Symbol* result) const;
-        bool FindName(uint16_t &address, std::string name) const;
+        void AssignBanks(const std::unordered_map<std::string, int>& banks);
+        const Symbol* Lookup(uint16_t address, int bank = SYMBOL_ANY_BANK) const;
+        const Symbol* Nearest(uint16_t address, int bank = SYMBOL_ANY_BANK, uint16_t* offset = NULL) const;
+        const Symbol* LookupName(const std::string& name) const;
+        //"name", "name+0x12" or "$1234" when nothing precedes the address
+        std::string Describe(uint16_t address, int bank = SYMBOL_ANY_BANK) const;
+        bool FindAddress(uint16_t address, Symbol* result, int bank = SYMBOL_ANY_BANK) const;
+        bool FindName(uint16_t &address, const std::string& name) const;
 };
 
-const char* memory_map_getter(const MemoryMap& items, int index);
\ No newline at end of file
+const char* memory_map_getter(const MemoryMap& items, int index);
@@ -0,0 +1,130 @@
+#include "pc_sampler.h"
+#include "trace_writer.h"
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+
+//Only the $8000-$BFFF window is banked, elsewhere the bank isn't part of the key
+static uint32_t site_key(uint16_t pc, int bank) {
+    if((bank == SYMBOL_ANY_BANK) || ((pc & 0xC000) != 0x8000)) {
+        return 0xFF0000 | pc;
+    }
+    return ((bank & 127) << 16) | pc;
+}
+
+static int key_bank(uint32_t key) {
+    int bank = (key >> 16) & 0xFF;
+    return (bank == 0xFF) ? SYMBOL_ANY_BANK : bank;
+}
+
+void PCSampler::Record(uint16_t pc, int bank, uint8_t stack_depth, uint32_t samples) {
+    total += samples;
+    Counter& counter = sites[site_key(pc, bank)];
+    counter.samples += samples;
+    counter.depth_total += (uint64_t) stack_depth * samples;
+    counter.max_depth = std::max(counter.max_depth, stack_depth);
+}
+
+void PCSampler::Clear() {
+    sites.clear();
+    total = 0;
+}
+
+namespace {
+struct Group {
+    SampledCode code;
+    uint64_t depth_total;
+};
+}
+
+//Merges sites into groups named by `describe`, which returns false for sites
+//it can't place. Those are listed by address.
+template <typename Counter, typename Describe>
+static std::vector<SampledCode> group_sites(const std::unordered_map<uint32_t, Counter>& sites, Describe describe) {
+    std::unordered_map<std::string, Group> groups;
+    std::string name;
+    for(auto& site : sites) {
+        uint16_t pc = (uint16_t) site.first;
+        int bank = key_bank(site.first);
+        if(!describe(pc, bank, name)) {
+            char hex[8];
+            snprintf(hex, sizeof(hex), "$%04X", pc);
+            name = hex;
+        }
+        auto found = groups.try_emplace(name, Group{{name, pc, bank, 0, 0, 0}, 0});
+        Group& group = found.first->second;
+        group.code.samples += site.second.samples;
+        group.depth_total += site.second.depth_total;
+        group.code.max_stack_depth = std::max(group.code.max_stack_depth, site.second.max_depth);
+    }
+    std::vector<SampledCode> out;
+    out.reserve(groups.size());
+    for(auto& group : groups) {
+        group.second.code.mean_stack_depth = group.second.code.samples ?
+            ((double) group.second.depth_total / group.second.code.samples) : 0;
+        out.push_back(group.second.code);
+    }
+    std::sort(out.begin(), out.end(), [](const SampledCode& a, const SampledCode& b) {
+        return a.samples > b.samples;
+    });
+    return out;
+}
+
+std::vector<SampledCode> PCSampler::Functions(const MemoryMap* memory_map) const {
+    return group_sites(sites, [memory_map](uint16_t pc, int bank, std::string& name) {
+        const Symbol* symbol = memory_map ? memory_map->Nearest(pc, bank) : NULL;
+        if(!symbol) {
+            return false;
+        }
+        name = symbol->name;
+        return true;
+    });
+}
+
+std::vector<SampledCode> PCSampler::Lines(SourceMap* source_map) const {
+    return group_sites(sites, [source_map](uint16_t pc, int bank, std::string& name) {
+        //the source map only covers the cartridge
+        if(!source_map || (pc < 0x8000)) {
+            return false;
+        }
+        //outside the banked window any bank finds the same line
+        SourceMapSearchResult result = source_map->Search(pc, (bank == SYMBOL_ANY_BANK) ? 127 : bank);
+        if(!result.found) {
+            return false;
+        }
+        name = result.file->name + ":" + std::to_string(result.line->line);
+        return true;
+    });
+}
+
+static void write_group(std::ofstream& file, const char* label, const std::vector<SampledCode>& codes, uint64_t total) {
+    file << "\t\"" << label << "\": [";
+    for(size_t i = 0; i < codes.size(); ++i) {
+        char address[8];
+        snprintf(address, sizeof(address), "%04X", codes[i].address);
+        file << (i ? "," : "") << "\n\t\t{\"name\": " << json_string(codes[i].name)
+            << ", \"address\": \"" << address
+            << "\", \"bank\": " << codes[i].bank
+            << ", \"samples\": " << codes[i].samples
+            << ", \"percent\": " << (total ? ((100.0 * codes[i].samples) / total) : 0.0)
+            << ", \"mean_stack_depth\": " << codes[i].mean_stack_depth
+            << ", \"max_stack_depth\": " << (int) codes[i].max_stack_depth << "}";
+    }
+    file << "\n\t]";
+}
+
+bool PCSampler::WriteJSON(const char* filename, const MemoryMap* memory_map, SourceMap* source_map) const {
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        printf("Unable to write sampling profile to %s\n", filename);
+        return false;
+    }
+    file << "{\n";
+    file << "\t\"interval_cycles\": " << interval << ",\n";
+    file << "\t\"samples\": " << total << ",\n";
+    write_group(file, "functions", Functions(memory_map), total);
+    file << ",\n";
+    write_group(file, "lines", Lines(source_map), total);
+    file << "\n}\n";
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "memory_map.h"
+#include "source_map.h"
+
+//Prime, so the samples don't lock onto code that runs once per frame
+#define PC_SAMPLER_DEFAULT_INTERVAL 997
+
+//Time in one function, or on one source line
+struct SampledCode {
+    std::string name;     //symbol name, or file:line
+    uint16_t address;     //first address seen
+    int bank;             //SYMBOL_ANY_BANK outside the banked window
+    uint64_t samples;
+    double mean_stack_depth;
+    uint8_t max_stack_depth;
+};
+
+// Statistical profiler for the main CPU.
+// The CPU reports the instruction it is running every `interval` cycles,
+// including WAI and jump-to-self idling and interrupt handlers, and the
+// sampler counts them per (PC, bank) along with how deep the stack was.
+// Grouping by symbol or source line only happens when a table is asked for,
+// so recording is one hash table update per sample and can stay on.
+class PCSampler {
+private:
+    struct Counter {
+        uint64_t samples;
+        uint64_t depth_total;
+        uint8_t max_depth;
+    };
+    std::unordered_map<uint32_t, Counter> sites;
+public:
+    bool enabled = false;
+    uint32_t interval = PC_SAMPLER_DEFAULT_INTERVAL;
+    uint64_t total = 0;
+
+    void Record(uint16_t pc, int bank, uint8_t stack_depth, uint32_t samples);
+    void Clear();
+    //Most samples first
+    std::vector<SampledCode> Functions(const MemoryMap* memory_map) const;
+    std::vector<SampledCode> Lines(SourceMap* source_map) const;
+    bool WriteJSON(const char* filename, const MemoryMap* memory_map, SourceMap* source_map) const;
+};
@@ -1,9 +1,12 @@
 #include "profiler.h"
+#include "trace_writer.h"
 #include <cmath>
-#include <fstream>
-#include <stack>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
 
-void Profiler::LogTime(uint8_t index) {
+uint64_t Profiler::LogTime(uint8_t index) {
 	uint64_t delta = timekeeper.totalCyclesCount - profilingTimeStamps[index];
 	if(delta > timekeeper.system_clock) {
 		//printf("Timer %d took longer than one second: %llu cycles.\n", index, delta);
@@ -11,6 +14,7 @@ void Profiler::LogTime(uint8_t index) {
 	profilingTimes[index] += delta;
 	profilingCounts[index]++;
     profilingHistory[index][history_num] = (((float)profilingTimes[index]) / ((float)timekeeper.cycles_per_vsync));
+    return delta;
 }
 
 void Profiler::ResetTimers() {
@@ -26,106 +30,412 @@ void Profiler::ResetTimers() {
     }
 }
 
+Profiler::~Profiler() {
+#ifndef WASM_BUILD
+    {
+        std::lock_guard<std::mutex> guard(deepProfileLock);
+        deepProfileStopping = true;
+    }
+    deepProfileWake.notify_one();
+    if(deepProfileWriter.joinable()) {
+        deepProfileWriter.join();
+    }
+#endif
+    if(deepProfileSpool) {
+        fclose(deepProfileSpool);
+    }
+    clearTree();
+}
+
+//Emulator thread side of the ring. If the writer falls a whole ring behind
+//events are dropped and counted rather than stalling emulation.
+void Profiler::recordEvent(ProfileEventType type, uint16_t origin, uint16_t destination, uint8_t bank) {
+    ProfileEvent event = {timekeeper.totalCyclesCount, origin, destination, bank, type};
+    if(!deepProfileRing.push(event)) {
+        ++deepProfileDropped;
+        return;
+    }
+    ++deepProfileEvents;
+    if((deepProfileEvents % DEEP_PROFILE_BATCH) == 0) {
+#ifdef WASM_BUILD
+        drainRing();
+#else
+        deepProfileWake.notify_one();
+#endif
+    }
+}
+
 void Profiler::LogJSR(uint16_t address, uint8_t bank, uint16_t destination) {
     if(deepProfileIsRecording) {
-        timeline.emplace_back(ProfileEventType::CALL, address, destination, bank, timekeeper.totalCyclesCount);
+        recordEvent(ProfileEventType::CALL, address, destination, bank);
     }
 }
 
 void Profiler::LogRTS(uint16_t address, uint8_t bank) {
     if(deepProfileIsRecording) {
-        timeline.emplace_back(ProfileEventType::RETURN, address, 0, bank, timekeeper.totalCyclesCount);
+        recordEvent(ProfileEventType::RETURN, address, 0, bank);
     }
 }
 
-void Profiler::DeepProfileStart() {
-    deepProfileIsRecording = true;
-    deepProfileStartCycleCount = timekeeper.totalCyclesCount;
+void Profiler::LogIRQ(uint16_t address, uint8_t bank, uint16_t handler) {
+    if(deepProfileIsRecording) {
+        recordEvent(ProfileEventType::IRQ, address, handler, bank);
+    }
+}
+
+void Profiler::LogNMI(uint16_t address, uint8_t bank, uint16_t handler) {
+    if(deepProfileIsRecording) {
+        recordEvent(ProfileEventType::NMI, address, handler, bank);
+    }
+}
+
+void Profiler::LogRTI(uint16_t address, uint8_t bank) {
+    if(deepProfileIsRecording) {
+        recordEvent(ProfileEventType::RTI, address, 0, bank);
+    }
+}
+
+//Consumer side: move whatever is in the ring to the spool file
+void Profiler::drainRing() {
+    ProfileEvent event;
+    deepProfileBatch.clear();
+    while(deepProfileRing.pop(event)) {
+        deepProfileBatch.push_back(event);
+        if(deepProfileBatch.size() == DEEP_PROFILE_BATCH) {
+            fwrite(deepProfileBatch.data(), sizeof(ProfileEvent), deepProfileBatch.size(), deepProfileSpool);
+            deepProfileBatch.clear();
+        }
+    }
+    if(!deepProfileBatch.empty()) {
+        fwrite(deepProfileBatch.data(), sizeof(ProfileEvent), deepProfileBatch.size(), deepProfileSpool);
+    }
+}
+
+#ifndef WASM_BUILD
+void Profiler::writerLoop() {
+    std::unique_lock<std::mutex> guard(deepProfileLock);
+    while(!deepProfileStopping) {
+        //the emulator doesn't take the lock to notify, so also wake up on a timer
+        deepProfileWake.wait_for(guard, std::chrono::milliseconds(5), [this] {
+            return deepProfileStopping || (deepProfileRing.size() >= DEEP_PROFILE_BATCH);
+        });
+        guard.unlock();
+        drainRing();
+        guard.lock();
+    }
+}
+#endif
+
+void Profiler::clearTree() {
     lastDeepProfileRoot = nullptr;
     deepProfileZoomFocus = nullptr;
-    timeline.clear();
-    for(auto& ptr : cleanupList) {
-        free(ptr);
+    deepProfileNodes.clear();
+    callGraph.clear();
+    callGraphNames.clear();
+    callGraphIndex.clear();
+    callGraphFocus = 0;
+    callGraphDepth = 0;
+}
+
+uint32_t Profiler::callGraphChild(uint32_t parent, uint32_t key, uint32_t name) {
+    auto found = callGraphIndex.find(((uint64_t) parent << 32) | key);
+    if(found != callGraphIndex.end()) {
+        return found->second;
+    }
+    uint32_t index = callGraph.size();
+    CallGraphNode node;
+    node.parent = parent;
+    node.name = name;
+    node.depth = callGraph[parent].depth + 1;
+    node.next_sibling = callGraph[parent].first_child;
+    callGraph.push_back(node);
+    callGraph[parent].first_child = index;
+    callGraphIndex.emplace(((uint64_t) parent << 32) | key, index);
+    callGraphDepth = std::max(callGraphDepth, node.depth);
+    return index;
+}
+
+//Relinks every node's children from most to least inclusive cycles
+void Profiler::sortCallGraph() {
+    std::vector<uint32_t> children;
+    for(auto& node : callGraph) {
+        children.clear();
+        for(uint32_t child = node.first_child; child != CALL_GRAPH_NONE; child = callGraph[child].next_sibling) {
+            children.push_back(child);
+        }
+        std::sort(children.begin(), children.end(), [this](uint32_t a, uint32_t b) {
+            return callGraph[a].inclusive > callGraph[b].inclusive;
+        });
+        node.first_child = CALL_GRAPH_NONE;
+        for(auto it = children.rbegin(); it != children.rend(); ++it) {
+            callGraph[*it].next_sibling = node.first_child;
+            node.first_child = *it;
+        }
+    }
+}
+
+static void write_collapsed(FILE* file, const std::vector<Profiler::CallGraphNode>& graph,
+    const std::vector<std::string>& names, uint32_t index, std::string& stack) {
+    const Profiler::CallGraphNode& node = graph[index];
+    size_t length = stack.size();
+    if(index != 0) {
+        stack += ";";
+    }
+    stack += names[node.name];
+    if(node.exclusive != 0) {
+        fprintf(file, "%s %llu\n", stack.c_str(), (unsigned long long) node.exclusive);
+    }
+    for(uint32_t child = node.first_child; child != CALL_GRAPH_NONE; child = graph[child].next_sibling) {
+        write_collapsed(file, graph, names, child, stack);
     }
-    cleanupList.clear();
+    stack.resize(length);
+}
+
+//The trace file name with a .folded extension
+std::string Profiler::CollapsedStacksFile() const {
+    return std::filesystem::path(deepProfileTraceFile).replace_extension(".folded").string();
+}
+
+//One line per call path with the cycles spent in its last function, the
+//format flamegraph.pl, speedscope and inferno read
+bool Profiler::WriteCollapsedStacks(const std::string& filename) const {
+    if(callGraph.empty()) {
+        return false;
+    }
+    FILE* file = fopen(filename.c_str(), "w");
+    if(!file) {
+        printf("Unable to write collapsed stacks to %s\n", filename.c_str());
+        return false;
+    }
+    std::string stack;
+    write_collapsed(file, callGraph, callGraphNames, 0, stack);
+    fclose(file);
+    return true;
+}
+
+void Profiler::DeepProfileStart() {
+    if(deepProfileIsRecording) {
+        return;
+    }
+    if(deepProfileSpool) {
+        fclose(deepProfileSpool);
+    }
+    deepProfileSpool = tmpfile();
+    if(!deepProfileSpool) {
+        perror("Unable to create deep profile spool file");
+        return;
+    }
+    clearTree();
+    deepProfileRing.clear();
+    deepProfileEvents = 0;
+    deepProfileDropped = 0;
+    deepProfileTruncatedNodes = 0;
+    deepProfileStartCycleCount = timekeeper.totalCyclesCount;
+    deepProfileFramesLeft = 0;
+#ifndef WASM_BUILD
+    deepProfileStopping = false;
+    deepProfileWriter = std::thread(&Profiler::writerLoop, this);
+#endif
+    deepProfileIsRecording = true;
 }
 
 std::string Profiler::profileEventTypeToString(ProfileEventType type) {
     switch (type) {
         case ProfileEventType::CALL: return "CALL";
         case ProfileEventType::RETURN: return "RETURN";
+        case ProfileEventType::IRQ: return "IRQ";
+        case ProfileEventType::NMI: return "NMI";
+        case ProfileEventType::RTI: return "RTI";
         default: return "UNKNOWN";
     }
 }
 
-void Profiler::recursiveNodePrintToFile(std::ofstream& file, DeepProfileCallNode* node, uint16_t depth) {
-    file << std::string(depth, '\t') << "{\n";
-    file << std::string(depth+1, '\t') << "name: " << node->name << ",\n";
-    file << std::string(depth+1, '\t') << "duration: " << node->duration << ",\n";
-    file << std::string(depth+1, '\t') << "children: [";
-    for(auto &childNode : node->children) {
-        file << "\n";
-        recursiveNodePrintToFile(file, childNode, depth+2);
-        file << ",";
-    }
-    file << "]\n";
-    file << std::string(depth, '\t') << "}";
-}
+//Reads the spooled events back once, building the window's call tree and
+//writing the Chrome trace as it goes. Calls are matched to returns with a
+//stack of open frames: an RTS only closes a JSR, an RTI closes everything
+//above the interrupt it returns from. Returns from frames opened before the
+//recording started are skipped, frames still open at the end are closed there.
+void Profiler::replaySpool(const std::string& filename, MemoryMap* memory_map, SourceMap* source_map) {
+    struct OpenFrame {
+        ProfileEventType type;
+        uint64_t start;
+        DeepProfileCallNode* node;
+        uint32_t graph;
+        uint64_t child_cycles;
+    };
+    std::vector<OpenFrame> callstack;
+    std::unordered_map<uint32_t, uint32_t> names;
+    std::unordered_map<uint32_t, SourceMapSearchResult> sites;
+    uint64_t endCycle = timekeeper.totalCyclesCount;
+    uint64_t rootChildCycles = 0;
 
-void Profiler::exportTimelineToJSON(const std::vector<ProfileEvent>& timeline, const std::string& filename, MemoryMap* memory_map, SourceMap* source_map) {
-    std::stack<DeepProfileCallNode*> callstack;
-    
-    DeepProfileCallNode* rootNode = new DeepProfileCallNode();
+    deepProfileNodes.emplace_back();
+    DeepProfileCallNode* rootNode = &deepProfileNodes.back();
     rootNode->name = "root";
-    rootNode->duration = timekeeper.totalCyclesCount - deepProfileStartCycleCount;
+    rootNode->duration = endCycle - deepProfileStartCycleCount;
     rootNode->offset = 0;
-    cleanupList.push_back(rootNode);
-    for (const auto& event : timeline) {
-        if(event.type == ProfileEventType::CALL) {
-            callstack.push(new DeepProfileCallNode());
-            cleanupList.push_back(callstack.top());
-            callstack.top()->duration = event.cycle_number;
-            callstack.top()->offset = event.cycle_number - deepProfileStartCycleCount;
-            if(memory_map != nullptr) {
-                Symbol sym;
-                if(memory_map->FindAddress(event.destination, &sym)) {
-                    callstack.top()->name = sym.name;
-                }
+
+    callGraphNames.push_back("root");
+    callGraph.emplace_back();
+    callGraph[0].parent = CALL_GRAPH_NONE;
+    callGraph[0].name = 0;
+    callGraph[0].depth = 0;
+
+    TraceWriter trace;
+    char otherData[96];
+    snprintf(otherData, sizeof(otherData), "\"events\": %llu, \"dropped_events\": %llu",
+        (unsigned long long) deepProfileEvents, (unsigned long long) deepProfileDropped);
+    if(trace.Open(filename, timekeeper.system_clock, deepProfileStartCycleCount, otherData)) {
+        trace.ThreadName(1, "6502");
+    } else {
+        printf("Unable to write deep profile to %s\n", filename.c_str());
+    }
+
+    auto close_frame = [&](uint64_t cycle) {
+        OpenFrame& frame = callstack.back();
+        uint64_t duration = cycle - frame.start;
+        if(frame.node) {
+            frame.node->duration = duration;
+        }
+        CallGraphNode& merged = callGraph[frame.graph];
+        merged.calls++;
+        merged.inclusive += duration;
+        merged.exclusive += duration - frame.child_cycles;
+        merged.min_cycles = std::min(merged.min_cycles, duration);
+        merged.max_cycles = std::max(merged.max_cycles, duration);
+        if(callstack.size() > 1) {
+            callstack[callstack.size()-2].child_cycles += duration;
+        } else {
+            rootChildCycles += duration;
+        }
+        trace.End(1, cycle);
+        callstack.pop_back();
+    };
+
+    auto open_frame = [&](const ProfileEvent& event) {
+        uint32_t nameKey = (event.type << 24) | (event.bank << 16) | event.destination;
+        auto name = names.find(nameKey);
+        if(name == names.end()) {
+            std::string label = (memory_map != nullptr) ? memory_map->Describe(event.destination, event.bank) : "";
+            if(label.empty()) {
+                char hex[8];
+                snprintf(hex, sizeof(hex), "$%04X", event.destination);
+                label = hex;
             }
-            if(source_map != nullptr) {
-                SourceMapSearchResult result = source_map->Search(event.origin, event.bank);
-                if(result.found) {
-                    callstack.top()->line = *result.line;
-                }
+            if(event.type != ProfileEventType::CALL) {
+                label = profileEventTypeToString(event.type) + ": " + label;
             }
+            name = names.emplace(nameKey, callGraphNames.size()).first;
+            callGraphNames.push_back(label);
+        }
+        const std::string& label = callGraphNames[name->second];
+        SourceMapSearchResult site = {};
+        if(source_map != nullptr) {
+            uint32_t siteKey = (event.bank << 16) | event.origin;
+            auto cached = sites.find(siteKey);
+            if(cached == sites.end()) {
+                cached = sites.emplace(siteKey, source_map->Search(event.origin, event.bank)).first;
+            }
+            site = cached->second;
+        }
+
+        DeepProfileCallNode* parent = callstack.empty() ? rootNode : callstack.back().node;
+        DeepProfileCallNode* node = nullptr;
+        if(parent && (deepProfileNodes.size() < DEEP_PROFILE_NODE_LIMIT)) {
+            deepProfileNodes.emplace_back();
+            node = &deepProfileNodes.back();
+            node->name = label;
+            node->offset = event.cycle_number - deepProfileStartCycleCount;
+            if(site.found) {
+                node->line = *site.line;
+            }
+            parent->children.push_back(node);
         } else {
-            DeepProfileCallNode* parent;
-            if(callstack.size() > 0) {
-                DeepProfileCallNode* returningNode = callstack.top();
-                callstack.pop();
-                if(callstack.size() > 0) {
-                    parent = callstack.top();
-                } else {
-                    parent = rootNode;
+            ++deepProfileTruncatedNodes;
+        }
+        //only the banked window tells banks apart, like MemoryMap does
+        uint8_t bank = ((event.destination & 0xC000) == 0x8000) ? (event.bank & 127) : 0xFF;
+        uint32_t graphKey = (event.type << 24) | (bank << 16) | event.destination;
+        uint32_t graph = callGraphChild(callstack.empty() ? 0 : callstack.back().graph, graphKey, name->second);
+        callstack.push_back({event.type, event.cycle_number, node, graph, 0});
+
+        std::string args;
+        if(site.found) {
+            args = "\"site\": " + json_string(site.file->name + ":" + std::to_string(site.line->line));
+        }
+        trace.Begin(1, label, (event.type == ProfileEventType::CALL) ? "call" : "interrupt",
+            event.cycle_number, args);
+    };
+
+    rewind(deepProfileSpool);
+    deepProfileBatch.resize(DEEP_PROFILE_BATCH);
+    size_t count;
+    while((count = fread(deepProfileBatch.data(), sizeof(ProfileEvent), DEEP_PROFILE_BATCH, deepProfileSpool)) > 0) {
+        for(size_t i = 0; i < count; ++i) {
+            const ProfileEvent& event = deepProfileBatch[i];
+            switch(event.type) {
+                case ProfileEventType::CALL:
+                case ProfileEventType::IRQ:
+                case ProfileEventType::NMI:
+                    open_frame(event);
+                    break;
+                case ProfileEventType::RETURN:
+                    if(!callstack.empty() && (callstack.back().type == ProfileEventType::CALL)) {
+                        close_frame(event.cycle_number);
+                    }
+                    break;
+                case ProfileEventType::RTI: {
+                    size_t depth = callstack.size();
+                    while((depth > 0) && (callstack[depth-1].type == ProfileEventType::CALL)) {
+                        --depth;
+                    }
+                    if(depth > 0) {
+                        while(callstack.size() >= depth) {
+                            close_frame(event.cycle_number);
+                        }
+                    }
+                    break;
                 }
-                returningNode->duration = event.cycle_number - returningNode->duration;
-                parent->children.push_back(returningNode);
             }
         }
     }
-
-    lastDeepProfileRoot = rootNode;
-
-    /*std::ofstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + filename);
+    while(!callstack.empty()) {
+        close_frame(endCycle);
     }
-    recursiveNodePrintToFile(file, rootNode, 0);
+    callGraph[0].calls = 1;
+    callGraph[0].inclusive = rootNode->duration;
+    callGraph[0].exclusive = rootNode->duration - std::min(rootNode->duration, rootChildCycles);
+    callGraph[0].min_cycles = callGraph[0].max_cycles = rootNode->duration;
+    sortCallGraph();
 
-    file.close();*/
+    trace.Close();
+    lastDeepProfileRoot = rootNode;
 }
 
 void Profiler::DeepProfileStop(MemoryMap* memory_map, SourceMap* source_map) {
+    if(!deepProfileIsRecording) {
+        return;
+    }
     deepProfileIsRecording = false;
-    exportTimelineToJSON(timeline, "./deep_profile.json", memory_map, source_map);
-}
\ No newline at end of file
+#ifndef WASM_BUILD
+    {
+        std::lock_guard<std::mutex> guard(deepProfileLock);
+        deepProfileStopping = true;
+    }
+    deepProfileWake.notify_one();
+    deepProfileWriter.join();
+#endif
+    drainRing();
+    deepProfileFramesLeft = 0;
+    replaySpool(deepProfileTraceFile, memory_map, source_map);
+    fclose(deepProfileSpool);
+    deepProfileSpool = NULL;
+    WriteCollapsedStacks(CollapsedStacksFile());
+    printf("Deep profile: %llu events over %llu cycles written to %s and %s",
+        (unsigned long long) deepProfileEvents, (unsigned long long) lastDeepProfileRoot->duration,
+        deepProfileTraceFile.c_str(), CollapsedStacksFile().c_str());
+    if(deepProfileDropped) {
+        printf(", %llu dropped", (unsigned long long) deepProfileDropped);
+    }
+    printf("\n");
+}
@@ -1,55 +1,117 @@
 #pragma once
 #include <cstdint>
+#include <cstdio>
 #include <vector>
+#include <deque>
 #include <string>
-#include <fstream>
+#include <unordered_map>
+#ifndef WASM_BUILD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 #include "../timekeeper.h"
+#include "../ring_buffer.h"
 #include "memory_map.h"
 #include "source_map.h"
 
 #define PROFILER_ENTRIES 64
 #define PROFILER_HISTORY 256
 
+//Events the deep profiler can hold before the writer has to catch up
+#define DEEP_PROFILE_RING_SIZE (1 << 16)
+//Events the writer moves to disk at a time
+#define DEEP_PROFILE_BATCH 4096
+//Largest call tree built for the profiler window, the trace file has everything
+#define DEEP_PROFILE_NODE_LIMIT 100000
+//No node, for the index links of the aggregated call graph
+#define CALL_GRAPH_NONE 0xFFFFFFFF
+
+// Timers driven by the ROM through the VIA, and the deep profiler.
+// The deep profiler records calls, returns and interrupts as 16 byte events
+// into a fixed ring. A background writer spools the ring to a temporary file,
+// so a recording can run for as long as there is disk to hold it. Nothing is
+// symbolicated while recording; on stop the spool is replayed once to build
+// the call tree for the profiler window and a Chrome trace (also loadable in
+// Perfetto) with symbol names and call sites.
+// The same pass aggregates every frame of the recording into a call graph:
+// calls are merged by their path of (symbol, bank) from the root, so a
+// recording of many frames averages out frame to frame variance. The graph
+// is shown as a flame graph and written as collapsed stacks for flamegraph.pl
+// and similar tools.
 class Profiler {
-    enum ProfileEventType {
+    enum ProfileEventType : uint8_t {
         CALL,
-        RETURN
+        RETURN,
+        IRQ,
+        NMI,
+        RTI
     };
     struct ProfileEvent {
-        ProfileEventType type;
+        uint64_t cycle_number;
         uint16_t origin;
         uint16_t destination;
         uint8_t bank;
-        uint64_t cycle_number;
-
-        ProfileEvent(ProfileEventType type, uint16_t origin, uint16_t destination, uint8_t bank, uint64_t cycle_number)
-            : type(type), origin(origin), destination(destination), bank(bank), cycle_number(cycle_number)
-        {}
+        ProfileEventType type;
     };
 
 public: 
     class DeepProfileCallNode {
         public:
         std::string name;
-        SourceMapLine line;
-        uint32_t duration;
-        uint32_t offset;
+        SourceMapLine line = {};
+        uint64_t duration = 0;
+        uint64_t offset = 0;
         std::vector<DeepProfileCallNode*> children;
     };
 
+    // A call path merged over the whole recording. Nodes live in one vector
+    // and link by index, children sorted by inclusive cycles once built.
+    struct CallGraphNode {
+        uint32_t parent;
+        uint32_t first_child = CALL_GRAPH_NONE;
+        uint32_t next_sibling = CALL_GRAPH_NONE;
+        uint32_t name;       //index into callGraphNames
+        uint32_t depth;
+        uint64_t calls = 0;
+        uint64_t inclusive = 0; //cycles including callees
+        uint64_t exclusive = 0; //cycles in this function itself
+        uint64_t min_cycles = UINT64_MAX;
+        uint64_t max_cycles = 0;
+    };
+
 private:
     Timekeeper& timekeeper;
-    bool deepProfileIsRecording;
-    uint64_t deepProfileStartCycleCount;
+    bool deepProfileIsRecording = false;
+    uint64_t deepProfileStartCycleCount = 0;
 
+    RingBuffer<ProfileEvent, DEEP_PROFILE_RING_SIZE> deepProfileRing;
+    FILE* deepProfileSpool = NULL;
+    std::vector<ProfileEvent> deepProfileBatch;
+#ifndef WASM_BUILD
+    std::thread deepProfileWriter;
+    std::mutex deepProfileLock;
+    std::condition_variable deepProfileWake;
+    bool deepProfileStopping = false;
+    void writerLoop();
+#endif
+
+    void recordEvent(ProfileEventType type, uint16_t origin, uint16_t destination, uint8_t bank);
+    void drainRing();
+    void clearTree();
     std::string profileEventTypeToString(ProfileEventType type);
-    void recursiveNodePrintToFile(std::ofstream& file, DeepProfileCallNode* node, uint16_t depth);
-    void exportTimelineToJSON(const std::vector<ProfileEvent>& timeline, const std::string& filename, MemoryMap* memory_map, SourceMap* source_map);
+    //(parent << 32 | type, bank, address) to the child node
+    std::unordered_map<uint64_t, uint32_t> callGraphIndex;
+    uint32_t callGraphChild(uint32_t parent, uint32_t key, uint32_t name);
+    void sortCallGraph();
+    void replaySpool(const std::string& filename, MemoryMap* memory_map, SourceMap* source_map);
 public:
     Profiler(Timekeeper& tk) : timekeeper(tk) {};
+    ~Profiler();
     int zeroConsec = 0;
     uint8_t bufferFlipCount = 0;
-    void LogTime(uint8_t index);
+    //Stops a stopwatch, returning the cycles it ran for
+    uint64_t LogTime(uint8_t index);
     void ResetTimers();
     uint64_t profilingTimeStamps[PROFILER_ENTRIES];
     uint64_t profilingTimes[PROFILER_ENTRIES];
@@ -62,12 +124,33 @@ public:
     int fps = 60;
     int history_num = 0;
     bool measure_by_frameflip = false;
-    std::vector<ProfileEvent> timeline;
     void LogJSR(uint16_t address, uint8_t bank, uint16_t dest);
     void LogRTS(uint16_t address, uint8_t bank);
+    void LogIRQ(uint16_t address, uint8_t bank, uint16_t handler);
+    void LogNMI(uint16_t address, uint8_t bank, uint16_t handler);
+    void LogRTI(uint16_t address, uint8_t bank);
     void DeepProfileStart();
     void DeepProfileStop(MemoryMap* memory_map, SourceMap* source_map);
-    DeepProfileCallNode* lastDeepProfileRoot;
-    DeepProfileCallNode* deepProfileZoomFocus;
-    std::vector<DeepProfileCallNode*> cleanupList;
-};
\ No newline at end of file
+    bool DeepProfileRecording() const { return deepProfileIsRecording; }
+    //where DeepProfileStop writes the Chrome trace
+    std::string deepProfileTraceFile = "deep_profile.json";
+    uint64_t deepProfileEvents = 0;
+    uint64_t deepProfileDropped = 0;
+    uint64_t deepProfileTruncatedNodes = 0;
+    DeepProfileCallNode* lastDeepProfileRoot = nullptr;
+    DeepProfileCallNode* deepProfileZoomFocus = nullptr;
+    //tree storage, released all at once when the next recording starts
+    std::deque<DeepProfileCallNode> deepProfileNodes;
+
+    //aggregated over the last recording, node 0 is the root
+    std::vector<CallGraphNode> callGraph;
+    std::vector<std::string> callGraphNames;
+    uint32_t callGraphFocus = 0;
+    uint32_t callGraphDepth = 0;
+    //set to record that many frames from the next vsync
+    uint32_t deepProfileArmedFrames = 0;
+    //vsyncs until a frame limited recording stops, 0 records until stopped
+    uint32_t deepProfileFramesLeft = 0;
+    bool WriteCollapsedStacks(const std::string& filename) const;
+    std::string CollapsedStacksFile() const;
+};
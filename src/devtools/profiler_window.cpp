@@ -2,6 +2,7 @@
 #include "profiler_window.h"
 #include "implot.h"
 #include "../audio_coprocessor.h"
+#include <algorithm>
 
 static float prof_R[8] = {1,    1, 1, 0, 0, 0.5f, 0.5f, 1};
 static float prof_G[8] = {0, 0.5f, 1, 1, 0,    0, 0.5f, 1};
@@ -9,7 +10,7 @@ static float prof_B[8] = {0,    0, 0, 0, 1, 0.5f, 0.5f, 1};
 
 void ProfilerWindow::recurse_tree_nodes(Profiler::DeepProfileCallNode* node, uint64_t totalCycles, uint64_t startTime) {
     ImGui::PushID(node);
-    bool opened = ImGui::TreeNode(node, "%s : %d", node->name.c_str(), node->duration);
+    bool opened = ImGui::TreeNode(node, "%s : %llu", node->name.c_str(), (unsigned long long) node->duration);
     ImGui::SameLine(ImGui::GetWindowWidth()-288);
     if(ImGui::Button(">")) {
         _profiler.deepProfileZoomFocus = node;
@@ -36,6 +37,548 @@ void ProfilerWindow::recurse_tree_nodes(Profiler::DeepProfileCallNode* node, uin
     ImGui::PopID();
 }
 
+#define FLAME_ROW_HEIGHT 18.0f
+
+//Warm colors picked from the name, so a function keeps its color between recordings
+static ImU32 flame_color(const std::string& name) {
+    uint32_t hash = 2166136261u;
+    for(char c : name) {
+        hash = (hash ^ (uint8_t) c) * 16777619u;
+    }
+    return IM_COL32(205 + (hash % 50), 80 + ((hash >> 8) % 150), (hash >> 16) % 60, 255);
+}
+
+void ProfilerWindow::draw_flame_node(ImDrawList* draw, uint32_t index, ImVec2 origin, float x, float width, uint32_t baseDepth) {
+    const Profiler::CallGraphNode& node = _profiler.callGraph[index];
+    const std::string& name = _profiler.callGraphNames[node.name];
+    ImVec2 min(origin.x + x, origin.y + (node.depth - baseDepth) * FLAME_ROW_HEIGHT);
+    ImVec2 max(min.x + width - 1, min.y + FLAME_ROW_HEIGHT - 1);
+    draw->AddRectFilled(min, max, flame_color(name));
+    if(width > 24) {
+        draw->PushClipRect(min, max, true);
+        draw->AddText(ImVec2(min.x + 2, min.y + 2), IM_COL32_BLACK, name.c_str());
+        draw->PopClipRect();
+    }
+    if(ImGui::IsMouseHoveringRect(min, max)) {
+        ImGui::BeginTooltip();
+        ImGui::Text("%s", name.c_str());
+        ImGui::Text("Calls: %llu", (unsigned long long) node.calls);
+        ImGui::Text("Inclusive: %llu cycles (%.1f%% of view)", (unsigned long long) node.inclusive,
+            (100.0 * node.inclusive) / _profiler.callGraph[_profiler.callGraphFocus].inclusive);
+        ImGui::Text("Exclusive: %llu cycles", (unsigned long long) node.exclusive);
+        if(node.calls) {
+            ImGui::Text("Per call: min %llu  max %llu  avg %.1f", (unsigned long long) node.min_cycles, (unsigned long long) node.max_cycles,
+                (double) node.inclusive / node.calls);
+        }
+        ImGui::EndTooltip();
+        if(ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+            _profiler.callGraphFocus = index;
+        }
+    }
+    float child_x = x;
+    for(uint32_t child = node.first_child; child != CALL_GRAPH_NONE; child = _profiler.callGraph[child].next_sibling) {
+        float child_width = width * ((float) _profiler.callGraph[child].inclusive / (float) node.inclusive);
+        //children are sorted widest first, everything after this is too narrow too
+        if(child_width < 2) {
+            break;
+        }
+        draw_flame_node(draw, child, origin, child_x, child_width, baseDepth);
+        child_x += child_width;
+    }
+}
+
+void ProfilerWindow::call_graph_row(uint32_t index) {
+    const Profiler::CallGraphNode& node = _profiler.callGraph[index];
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::PushID(index);
+    if(ImGui::Selectable(_profiler.callGraphNames[node.name].c_str(), false, ImGuiSelectableFlags_SpanAllColumns)) {
+        _profiler.callGraphFocus = index;
+    }
+    ImGui::PopID();
+    ImGui::TableNextColumn();
+    ImGui::Text("%llu", (unsigned long long) node.calls);
+    ImGui::TableNextColumn();
+    ImGui::Text("%llu", (unsigned long long) node.inclusive);
+    ImGui::TableNextColumn();
+    ImGui::Text("%llu", (unsigned long long) node.exclusive);
+    ImGui::TableNextColumn();
+    ImGui::Text("%llu", (unsigned long long) (node.calls ? node.min_cycles : 0));
+    ImGui::TableNextColumn();
+    ImGui::Text("%llu", (unsigned long long) node.max_cycles);
+    ImGui::TableNextColumn();
+    ImGui::Text("%.1f", node.calls ? ((double) node.inclusive / node.calls) : 0.0);
+}
+
+void ProfilerWindow::sample_table(std::vector<SampledCode>& codes) {
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY |
+        ImGuiTableFlags_Sortable | ImGuiTableFlags_Resizable;
+    if(!ImGui::BeginTable("SampleTable", 5, flags)) {
+        return;
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn(sampleByLine ? "Line" : "Function");
+    ImGui::TableSetupColumn("Address");
+    ImGui::TableSetupColumn("Samples", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableSetupColumn("Mean depth");
+    ImGui::TableSetupColumn("Max depth");
+    ImGui::TableHeadersRow();
+
+    if(ImGuiTableSortSpecs* sort = ImGui::TableGetSortSpecs()) {
+        //fresh data comes most samples first, put it back in the chosen order
+        if((sort->SpecsDirty || sampleResort) && (sort->SpecsCount > 0)) {
+            int column = sort->Specs[0].ColumnIndex;
+            bool ascending = sort->Specs[0].SortDirection == ImGuiSortDirection_Ascending;
+            std::stable_sort(codes.begin(), codes.end(), [column, ascending](const SampledCode& a, const SampledCode& b) {
+                const SampledCode& x = ascending ? a : b;
+                const SampledCode& y = ascending ? b : a;
+                switch(column) {
+                    case 0: return x.name < y.name;
+                    case 1: return x.address < y.address;
+                    case 3: return x.mean_stack_depth < y.mean_stack_depth;
+                    case 4: return x.max_stack_depth < y.max_stack_depth;
+                    default: return x.samples < y.samples;
+                }
+            });
+            sort->SpecsDirty = false;
+            sampleResort = false;
+        }
+    }
+
+    ImGuiListClipper clipper;
+    clipper.Begin(codes.size());
+    while(clipper.Step()) {
+        for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const SampledCode& code = codes[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(code.name.c_str());
+            ImGui::TableNextColumn();
+            if(code.bank == SYMBOL_ANY_BANK) {
+                ImGui::Text("%04X", code.address);
+            } else {
+                ImGui::Text("%02X:%04X", code.bank, code.address);
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu (%.1f%%)", (unsigned long long) code.samples, _sampler.total ? ((100.0 * code.samples) / _sampler.total) : 0.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", code.mean_stack_depth);
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", code.max_stack_depth);
+        }
+    }
+    ImGui::EndTable();
+}
+
+void ProfilerWindow::budget_row(int slot, const BudgetStats& stats) {
+    ImGui::TableNextRow();
+    if(stats.overruns) {
+        ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, ImGui::GetColorU32(ImVec4(0.5f, 0.1f, 0.1f, 1)));
+    }
+    ImGui::TableSetColumnIndex(0);
+    if(slot == BUDGET_FRAME_SLOT) {
+        ImGui::Text("-");
+    } else {
+        ImGui::Text("%02d", slot);
+    }
+    ImGui::TableSetColumnIndex(1);
+    ImGui::Text("%s", _budgets.Name(slot).c_str());
+    ImGui::TableSetColumnIndex(2);
+    if(stats.budget) {
+        ImGui::Text("%llu", (unsigned long long) stats.budget);
+    } else {
+        ImGui::Text("none");
+    }
+    ImGui::TableSetColumnIndex(3);
+    ImGui::Text("%llu", (unsigned long long) (stats.measurements ? stats.total_cycles / stats.measurements : 0));
+    ImGui::TableSetColumnIndex(4);
+    ImGui::Text("%llu", (unsigned long long) stats.worst_cycles);
+    ImGui::TableSetColumnIndex(5);
+    ImGui::Text("%llu", (unsigned long long) stats.overruns);
+}
+
+//Busiest banks shown in the transition matrix
+#define BANK_MATRIX_SIZE 12
+
+void ProfilerWindow::bank_switch_tab() {
+    ImGui::Checkbox("Record", &_banks.enabled);
+    ImGui::SameLine();
+    if(ImGui::Button("Clear")) {
+        _banks.Clear();
+    }
+    ImGui::Text("Switches: %llu (%llu to the bank already selected), %llu cycles", (unsigned long long) _banks.switches,
+        (unsigned long long) _banks.redundant, (unsigned long long) _banks.cycles);
+    ImGui::Text("Per frame: %u last, %u max, %.1f mean", _banks.last_frame_switches, _banks.max_frame_switches,
+        _banks.frames ? (double) _banks.switches / _banks.frames : 0.0);
+    if(ImPlot::BeginPlot("Switches per frame", ImVec2(-1, 150))) {
+        ImPlot::SetupAxes("", "", 0, ImPlotAxisFlags_AutoFit);
+        ImPlot::SetupAxisLimits(ImAxis_X1, 0, BANK_PROFILER_HISTORY, ImPlotCond_Always);
+        ImPlot::PlotLine<float>("Switches", _banks.history, BANK_PROFILER_HISTORY, 1, 0, 0, _banks.history_num);
+        ImPlot::EndPlot();
+    }
+
+    //names are looked up twice a second rather than every frame
+    if((ImGui::GetTime() - lastBankRefresh) > 0.5) {
+        bankCallers = _banks.Callers(memorymap);
+        bankPairs = _banks.CoLocations(memorymap);
+        lastBankRefresh = ImGui::GetTime();
+    }
+
+    if(ImGui::CollapsingHeader("Callers", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if(ImGui::BeginTable("bankcallers", 5, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImVec2(0, 160))) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Caller");
+            ImGui::TableSetupColumn("Bank");
+            ImGui::TableSetupColumn("Via");
+            ImGui::TableSetupColumn("Switches");
+            ImGui::TableSetupColumn("Cycles");
+            ImGui::TableHeadersRow();
+            for(const BankSwitchCaller& caller : bankCallers) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", caller.caller.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%d", caller.caller_bank);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%s", caller.routine.c_str());
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%llu", (unsigned long long) caller.switches);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%llu", (unsigned long long) caller.cycles);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    if(ImGui::CollapsingHeader("Transitions")) {
+        std::vector<uint8_t> banks = _banks.BusiestBanks(BANK_MATRIX_SIZE);
+        ImGui::Text("From row to column, latch values in hex");
+        if(!banks.empty() && ImGui::BeginTable("banktransitions", banks.size() + 1, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_Borders)) {
+            ImGui::TableSetupColumn("");
+            for(uint8_t bank : banks) {
+                char label[4];
+                snprintf(label, sizeof(label), "%02X", bank);
+                ImGui::TableSetupColumn(label);
+            }
+            ImGui::TableHeadersRow();
+            for(uint8_t from : banks) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%02X", from);
+                for(size_t column = 0; column < banks.size(); ++column) {
+                    ImGui::TableSetColumnIndex(column + 1);
+                    uint32_t count = _banks.Transitions(from, banks[column]);
+                    if(count) {
+                        ImGui::Text("%u", count);
+                    }
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    if(ImGui::CollapsingHeader("Co-location", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Text("Calls made right after switching; sharing a bank saves the switch");
+        if(ImGui::BeginTable("bankpairs", 4, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImVec2(0, 160))) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Caller");
+            ImGui::TableSetupColumn("Callee");
+            ImGui::TableSetupColumn("Switches");
+            ImGui::TableSetupColumn("Cycles");
+            ImGui::TableHeadersRow();
+            for(const BankCoLocation& pair : bankPairs) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s (%d)", pair.caller.c_str(), pair.caller_bank);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%s (%d)", pair.callee.c_str(), pair.callee_bank);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%llu", (unsigned long long) pair.switches);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%llu", (unsigned long long) pair.cycles);
+            }
+            ImGui::EndTable();
+        }
+    }
+}
+
+#define GANTT_LANE_HEIGHT 22.0f
+#define GANTT_LABEL_WIDTH 90.0f
+
+static ImU32 blit_color(BlitMode mode) {
+    switch(mode) {
+        case BLIT_FILL:
+            return IM_COL32(230, 160, 40, 255);
+        case BLIT_TRANSPARENT:
+            return IM_COL32(90, 180, 240, 255);
+        default:
+            return IM_COL32(60, 120, 220, 255);
+    }
+}
+
+void ProfilerWindow::draw_blit_frame(const BlitFrame& frame) {
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = ImGui::GetContentRegionAvail().x - GANTT_LABEL_WIDTH;
+    ImGui::Dummy(ImVec2(width + GANTT_LABEL_WIDTH, GANTT_LANE_HEIGHT * 2));
+    if((width < 1) || (frame.end <= frame.start)) {
+        return;
+    }
+    float scale = width / (float) (frame.end - frame.start);
+    float left = origin.x + GANTT_LABEL_WIDTH;
+    draw->AddText(ImVec2(origin.x, origin.y + 3), IM_COL32_WHITE, "Blitter");
+    draw->AddText(ImVec2(origin.x, origin.y + GANTT_LANE_HEIGHT + 3), IM_COL32_WHITE, "CPU in WAI");
+    draw->AddRectFilled(ImVec2(left, origin.y), ImVec2(left + width, origin.y + GANTT_LANE_HEIGHT * 2), IM_COL32(40, 40, 40, 255));
+
+    for(const BlitRecord& blit : frame.blits) {
+        uint64_t end = std::min(blit.end, frame.end);
+        ImVec2 min(left + (blit.start - frame.start) * scale, origin.y + 1);
+        //every blit gets at least a pixel
+        ImVec2 max(std::max(min.x + 1, left + (end - frame.start) * scale), origin.y + GANTT_LANE_HEIGHT - 1);
+        draw->AddRectFilled(min, max, blit_color(blit.mode));
+        if(ImGui::IsMouseHoveringRect(min, max)) {
+            ImGui::BeginTooltip();
+            ImGui::Text("%s %dx%d%s", BlitTimeline::ModeName(blit.mode), blit.width & 0x7F, blit.height & 0x7F,
+                blit.continued ? " (from the frame before)" : "");
+            ImGui::Text("Cycles %llu to %llu (%llu)", (unsigned long long) (blit.start - frame.start),
+                (unsigned long long) (blit.end - frame.start), (unsigned long long) (blit.end - blit.start));
+            ImGui::Text("VRAM %d,%d  GRAM bank %d at %d,%d", blit.vx, blit.vy, blit.gram_bank, blit.gx, blit.gy);
+            if(blit.mode == BLIT_FILL) {
+                ImGui::Text("Color %02X", blit.color);
+            }
+            if((blit.width | blit.height) & 0x80) {
+                ImGui::Text("Flipped%s%s", (blit.width & 0x80) ? " X" : "", (blit.height & 0x80) ? " Y" : "");
+            }
+            ImGui::EndTooltip();
+        }
+    }
+    for(const CycleSpan& wait : frame.waits) {
+        ImVec2 min(left + (wait.start - frame.start) * scale, origin.y + GANTT_LANE_HEIGHT + 1);
+        ImVec2 max(std::max(min.x + 1, left + (wait.end - frame.start) * scale), origin.y + GANTT_LANE_HEIGHT * 2 - 1);
+        draw->AddRectFilled(min, max, IM_COL32(150, 150, 150, 255));
+        if(ImGui::IsMouseHoveringRect(min, max)) {
+            ImGui::SetTooltip("WAI from %llu to %llu (%llu cycles)", (unsigned long long) (wait.start - frame.start),
+                (unsigned long long) (wait.end - frame.start), (unsigned long long) (wait.end - wait.start));
+        }
+    }
+}
+
+void ProfilerWindow::blit_timeline_tab() {
+    if(ImGui::Checkbox("Record", &_blits.enabled) && _blits.enabled) {
+        _blits.Clear();
+    }
+    ImGui::SameLine();
+    if(ImGui::Button("Clear")) {
+        _blits.Clear();
+    }
+    ImGui::SameLine();
+    if(ImGui::Button("Export")) {
+        blitTraceWritten = _blits.WriteTrace(_blits.traceFile);
+    }
+    if(blitTraceWritten) {
+        ImGui::SameLine();
+        ImGui::Text("Trace written to %s", _blits.traceFile.c_str());
+    }
+    ImGui::Text("Frames: %llu, %llu blitter-bound, %llu CPU-bound", (unsigned long long) _blits.total_frames,
+        (unsigned long long) _blits.blitter_bound_frames, (unsigned long long) _blits.cpu_bound_frames);
+
+    if(ImPlot::BeginPlot("% of frame", ImVec2(-1, 150))) {
+        ImPlot::SetupAxes("", "");
+        ImPlot::SetupAxesLimits(0, BLIT_TIMELINE_HISTORY, 0, 100, ImPlotCond_Always);
+        ImPlot::PlotLine<float>("Blitter busy", _blits.busy_history, BLIT_TIMELINE_HISTORY, 1, 0, 0, _blits.history_num);
+        ImPlot::PlotLine<float>("CPU waiting on blits", _blits.stalled_history, BLIT_TIMELINE_HISTORY, 1, 0, 0, _blits.history_num);
+        ImPlot::EndPlot();
+    }
+
+    if(_blits.frames.empty()) {
+        ImGui::Text("Record to see each blit of the last %d frames", BLIT_TIMELINE_FRAMES);
+        return;
+    }
+    int newest = (int) _blits.frames.size() - 1;
+    blitFramesBack = std::min(blitFramesBack, newest);
+    ImGui::SetNextItemWidth(200);
+    ImGui::SliderInt("Frames back", &blitFramesBack, 0, newest);
+    const BlitFrame& frame = _blits.frames[newest - blitFramesBack];
+    uint64_t length = frame.end - frame.start;
+    ImGui::Text("Frame %llu: %llu blits%s, %s", (unsigned long long) frame.number, (unsigned long long) (frame.blits.size() + frame.dropped),
+        frame.dropped ? " (not all shown)" : "", BlitTimeline::VerdictName(BlitTimeline::Verdict(frame)));
+    ImGui::Text("Blitter busy %llu cycles (%.1f%%), CPU in WAI %llu cycles (%.1f%%)",
+        (unsigned long long) frame.blit_cycles, (100.0 * frame.blit_cycles) / length,
+        (unsigned long long) frame.wait_cycles, (100.0 * frame.wait_cycles) / length);
+    ImGui::Text("Waiting on blits %llu cycles, blitting behind CPU work %llu cycles",
+        (unsigned long long) frame.stalled_cycles, (unsigned long long) frame.overlap_cycles);
+    draw_blit_frame(frame);
+}
+
+//One row per kind of hardware event
+static const ImU32 hardware_colors[HW_EVENT_KINDS] = {
+    IM_COL32(240, 200, 60, 255),
+    IM_COL32(200, 120, 240, 255),
+    IM_COL32(120, 200, 120, 255),
+    IM_COL32(80, 220, 200, 255),
+    IM_COL32(240, 140, 90, 255),
+    IM_COL32(90, 150, 240, 255),
+    IM_COL32(255, 80, 80, 255),
+    IM_COL32(220, 220, 220, 255),
+    IM_COL32(255, 120, 200, 255)
+};
+
+void ProfilerWindow::draw_hardware_frame(size_t first, size_t last, uint64_t start, uint64_t end) {
+    int rows = 0;
+    int row_of[HW_EVENT_KINDS];
+    for(int kind = 0; kind < HW_EVENT_KINDS; ++kind) {
+        row_of[kind] = hardwareShown[kind] ? rows++ : -1;
+    }
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = ImGui::GetContentRegionAvail().x - GANTT_LABEL_WIDTH;
+    ImGui::Dummy(ImVec2(width + GANTT_LABEL_WIDTH, rows * GANTT_LANE_HEIGHT));
+    if((width < 1) || (end <= start) || !rows) {
+        return;
+    }
+    float scale = width / (float) (end - start);
+    float left = origin.x + GANTT_LABEL_WIDTH;
+    draw->AddRectFilled(ImVec2(left, origin.y), ImVec2(left + width, origin.y + rows * GANTT_LANE_HEIGHT), IM_COL32(40, 40, 40, 255));
+    for(int kind = 0; kind < HW_EVENT_KINDS; ++kind) {
+        if(row_of[kind] >= 0) {
+            draw->AddText(ImVec2(origin.x, origin.y + row_of[kind] * GANTT_LANE_HEIGHT + 3), IM_COL32_WHITE,
+                HardwareTrace::KindName((HardwareEventKind) kind));
+        }
+    }
+    //events closer than a pixel share a tooltip
+    const HardwareEvent* hovered[8];
+    int hovered_count = 0;
+    for(size_t i = first; i < last; ++i) {
+        const HardwareEvent& event = _hardware.history[i];
+        int row = row_of[event.kind];
+        if(row < 0) {
+            continue;
+        }
+        float x = left + (event.cycle - start) * scale;
+        ImVec2 min(x - 1, origin.y + row * GANTT_LANE_HEIGHT + 2);
+        ImVec2 max(x + 1, min.y + GANTT_LANE_HEIGHT - 4);
+        draw->AddRectFilled(min, max, hardware_colors[event.kind]);
+        if((hovered_count < 8) && ImGui::IsMouseHoveringRect(ImVec2(min.x - 1, min.y), ImVec2(max.x + 1, max.y))) {
+            hovered[hovered_count++] = &event;
+        }
+    }
+    if(hovered_count) {
+        ImGui::BeginTooltip();
+        for(int i = 0; i < hovered_count; ++i) {
+            ImGui::Text("%llu  %s  $%04X  %02X -> %02X  from %s", (unsigned long long) (hovered[i]->cycle - start),
+                HardwareTrace::KindName(hovered[i]->kind), hovered[i]->address, hovered[i]->old_value, hovered[i]->value,
+                (memorymap != NULL) ? memorymap->Describe(hovered[i]->pc, hovered[i]->bank).c_str() : "");
+        }
+        ImGui::EndTooltip();
+    }
+}
+
+void ProfilerWindow::hardware_trace_tab() {
+    ImGui::Checkbox("Record", &_hardware.enabled);
+    ImGui::SameLine();
+    if(ImGui::Button("Clear")) {
+        _hardware.Clear();
+    }
+    ImGui::SameLine();
+    if(ImGui::Button("Export")) {
+        hardwareTraceWritten = _hardware.WriteTrace(_hardware.traceFile, memorymap);
+    }
+    if(hardwareTraceWritten) {
+        ImGui::SameLine();
+        ImGui::Text("Trace written to %s", _hardware.traceFile.c_str());
+    }
+    ImGui::Text("%llu events kept, %llu dropped", (unsigned long long) _hardware.history.size(), (unsigned long long) _hardware.dropped);
+
+    if(ImGui::BeginTable("hardwarekinds", 5, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Event");
+        ImGui::TableSetupColumn("Record");
+        ImGui::TableSetupColumn("Show");
+        ImGui::TableSetupColumn("Last frame");
+        ImGui::TableSetupColumn("Most in a frame");
+        ImGui::TableHeadersRow();
+        for(int kind = 0; kind < HW_EVENT_KINDS; ++kind) {
+            ImGui::PushID(kind);
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(hardware_colors[kind]), "%s", HardwareTrace::KindName((HardwareEventKind) kind));
+            ImGui::TableSetColumnIndex(1);
+            //vsyncs mark the frames, they are always recorded
+            if(kind != HW_VSYNC) {
+                ImGui::CheckboxFlags("##record", &_hardware.kinds, 1 << kind);
+            }
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Checkbox("##show", &hardwareShown[kind]);
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%u", _hardware.last_frame_counts[kind]);
+            ImGui::TableSetColumnIndex(4);
+            ImGui::Text("%u", _hardware.max_frame_counts[kind]);
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+
+    int kept = _hardware.FramesKept();
+    if(kept == 0) {
+        ImGui::Text("Record to see the hardware events of each frame");
+        return;
+    }
+    hardwareFramesBack = std::min(hardwareFramesBack, kept - 1);
+    ImGui::SetNextItemWidth(200);
+    ImGui::SliderInt("Frames back##hardware", &hardwareFramesBack, 0, kept - 1);
+    size_t first, last;
+    uint64_t start, end;
+    if(!_hardware.Frame(hardwareFramesBack, first, last, start, end)) {
+        return;
+    }
+    ImGui::Text("%llu events over %llu cycles", (unsigned long long) (last - first), (unsigned long long) (end - start));
+    draw_hardware_frame(first, last, start, end);
+
+    hardwareRows.clear();
+    for(size_t i = first; i < last; ++i) {
+        if(hardwareShown[_hardware.history[i].kind]) {
+            hardwareRows.push_back(i);
+        }
+    }
+    if(ImGui::BeginTable("hardwareevents", 5, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImVec2(0, 0))) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Cycle");
+        ImGui::TableSetupColumn("Event");
+        ImGui::TableSetupColumn("Address");
+        ImGui::TableSetupColumn("Value");
+        ImGui::TableSetupColumn("Code");
+        ImGui::TableHeadersRow();
+        ImGuiListClipper clipper;
+        clipper.Begin(hardwareRows.size());
+        while(clipper.Step()) {
+            for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                const HardwareEvent& event = _hardware.history[hardwareRows[row]];
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%llu", (unsigned long long) (event.cycle - start));
+                ImGui::TableSetColumnIndex(1);
+                ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(hardware_colors[event.kind]), "%s", HardwareTrace::KindName(event.kind));
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("$%04X", event.address);
+                ImGui::TableSetColumnIndex(3);
+                if(event.kind == HW_VSYNC) {
+                    ImGui::Text("%s", event.value ? "NMI" : "no NMI");
+                } else if(event.kind == HW_BLIT_IRQ) {
+                    ImGui::Text("%s", event.value ? "taken" : "masked");
+                } else {
+                    ImGui::Text("%02X -> %02X", event.old_value, event.value);
+                }
+                ImGui::TableSetColumnIndex(4);
+                if(memorymap != NULL) {
+                    ImGui::Text("%s", memorymap->Describe(event.pc, event.bank).c_str());
+                } else {
+                    ImGui::Text("$%04X", event.pc);
+                }
+            }
+        }
+        ImGui::EndTable();
+    }
+}
+
 ImVec2 ProfilerWindow::Render() {
 
     ImVec2 sizeOut = {0, 0};
@@ -45,6 +588,14 @@ ImVec2 ProfilerWindow::Render() {
     if(ImGui::BeginTabItem("Stopwatches")) {
         ImGui::Text("FPS: %d", _profiler.fps);
         ImGui::Text("ACP: %d", AudioCoprocessor::singleton_acp_state->last_irq_cycles);
+        ImGui::Text("Audio buffer: %u / %u samples (x%.4f)",
+            AudioCoprocessor::singleton_acp_state->buffer_fill,
+            AudioCoprocessor::singleton_acp_state->target_fill,
+            AudioCoprocessor::singleton_acp_state->playback_ratio);
+        ImGui::Text("Underruns: %llu (%llu samples) Overruns: %llu",
+            (unsigned long long) AudioCoprocessor::singleton_acp_state->underruns,
+            (unsigned long long) AudioCoprocessor::singleton_acp_state->underrun_samples,
+            (unsigned long long) AudioCoprocessor::singleton_acp_state->overruns);
         ImGui::Text("Graph max:");
         ImGui::SameLine();
         ImGui::InputFloat("##", &max_scale, 0, 0, "%.2f");
@@ -72,7 +623,7 @@ ImVec2 ProfilerWindow::Render() {
 
 
         ImGui::BeginChild("Scrolling");
-        ImGui::Text("Blit Pixels/Frame: %lu px", _profiler.last_blitter_activity);
+        ImGui::Text("Blit Pixels/Frame: %llu px", (unsigned long long) _profiler.last_blitter_activity);
         for(int i = 0; i < PROFILER_ENTRIES; ++i) {
             if(_profiler.profilingLastSample[i] != 0) {
                 if(!profilerSeen[i]) {
@@ -85,7 +636,7 @@ ImVec2 ProfilerWindow::Render() {
                 ImGui::Checkbox("##", &profilerVis[i]);
                 ImGui::SameLine();
                 ImGui::TextColored(ImVec4(prof_R[i % 8], prof_G[i % 8], prof_B[i % 8], 1.0f), 
-                "Timer %02d: %ld / %ld", i, _profiler.profilingLastSample[i], _profiler.profilingLastSampleCount[i]);
+                "Timer %02d %s: %u / %u", i, _budgets.Name(i).c_str(), _profiler.profilingLastSample[i], _profiler.profilingLastSampleCount[i]);
                 ImGui::PopID();
             }
         }
@@ -93,18 +644,158 @@ ImVec2 ProfilerWindow::Render() {
         ImGui::EndTabItem();
     }
 
+    if(ImGui::BeginTabItem("ACP Budget")) {
+        ACPMonitor& monitor = AudioCoprocessor::singleton_acp_state->monitor;
+        ImGui::Text("Budget: %llu cycles per sample", (unsigned long long) monitor.budget);
+        ImGui::Text("Last: %llu  Min: %llu  Max: %llu  Mean: %.1f",
+            (unsigned long long) monitor.last_cycles,
+            (unsigned long long) (monitor.isr_count ? monitor.min_cycles : 0),
+            (unsigned long long) monitor.max_cycles,
+            monitor.isr_count ? ((double) monitor.total_isr_cycles / monitor.isr_count) : 0.0);
+        if(monitor.budget != 0) {
+            ImGui::Text("Peak usage: %.1f%%  Headroom: %lld cycles",
+                (100.0 * monitor.max_cycles) / monitor.budget,
+                (long long) monitor.budget - (long long) monitor.max_cycles);
+        }
+        ImGui::Text("IRQs: %llu handled, %llu late, %llu masked", (unsigned long long) monitor.isr_count,
+            (unsigned long long) monitor.late_ticks, (unsigned long long) monitor.masked_ticks);
+        if(monitor.overrun_flag) {
+            ImGui::TextColored(ImVec4(1, 0.2f, 0.2f, 1), "OVERRUN: %llu handlers ran past the next tick", (unsigned long long) monitor.overruns);
+        } else {
+            ImGui::Text("Overruns: %llu", (unsigned long long) monitor.overruns);
+        }
+        if(ImGui::Button("Clear")) {
+            monitor.Clear();
+        }
+
+        if(ImPlot::BeginPlot("ISR cycles / budget", ImVec2(-1, 200))) {
+            ImPlot::SetupAxes("", "");
+            ImPlot::SetupAxesLimits(0, ACP_MONITOR_HISTORY, 0, 1.5, ImPlotCond_Always);
+            ImPlot::PlotLine<float>("Usage", monitor.history, ACP_MONITOR_HISTORY, 1, 0, 0, monitor.history_num);
+            float limit[2] = {1.0f, 1.0f};
+            float limit_x[2] = {0.0f, (float) ACP_MONITOR_HISTORY};
+            ImPlot::PushStyleColor(ImPlotCol_Line, ImVec4(1, 0.2f, 0.2f, 1));
+            ImPlot::PlotLine<float>("Budget", limit_x, limit, 2);
+            ImPlot::PopStyleColor();
+            ImPlot::EndPlot();
+        }
+
+        if(ImPlot::BeginPlot("Histogram (% of budget)", ImVec2(-1, 200))) {
+            float buckets[ACP_MONITOR_BUCKETS];
+            for(int i = 0; i < ACP_MONITOR_BUCKETS; ++i) {
+                buckets[i] = (float) monitor.histogram[i];
+            }
+            ImPlot::SetupAxes("", "", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+            ImPlot::PlotBars<float>("IRQs", buckets, ACP_MONITOR_BUCKETS, 0.8, 0, ImPlotBarsFlags_None, 0, sizeof(float));
+            ImPlot::EndPlot();
+        }
+
+        ImGui::BeginChild("ACPAddresses");
+        uint64_t handlerCycles = monitor.TotalCycles();
+        ImGui::Text("Handler cycles by address (%llu total)", (unsigned long long) handlerCycles);
+        for(auto& entry : monitor.HotAddresses(64)) {
+            ImGui::Text("%04X  %10llu  %5.1f%%", entry.first, (unsigned long long) entry.second,
+                handlerCycles ? ((100.0 * entry.second) / handlerCycles) : 0.0);
+        }
+        ImGui::EndChild();
+        ImGui::EndTabItem();
+    }
+
+    if(ImGui::BeginTabItem("Cycle Budgets")) {
+        ImGui::Text("Frame %llu", (unsigned long long) _budgets.frame);
+        if(!_budgets.active) {
+            ImGui::Text("No budgets declared. The ROM declares them on ORB, see the README.");
+        }
+        if(_budgets.overrun_flag) {
+            ImGui::TextColored(ImVec4(1, 0.2f, 0.2f, 1), "OVERRUN: %llu checks over budget", (unsigned long long) _budgets.overrun_count);
+        } else {
+            ImGui::Text("Overruns: %llu", (unsigned long long) _budgets.overrun_count);
+        }
+        if(ImGui::Button("Clear")) {
+            _budgets.Clear();
+        }
+        if(ImGui::BeginTable("budgets", 6, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Timer");
+            ImGui::TableSetupColumn("Name");
+            ImGui::TableSetupColumn("Budget");
+            ImGui::TableSetupColumn("Mean");
+            ImGui::TableSetupColumn("Worst");
+            ImGui::TableSetupColumn("Overruns");
+            ImGui::TableHeadersRow();
+            budget_row(BUDGET_FRAME_SLOT, _budgets.frames);
+            for(int slot = 0; slot < BUDGET_SLOTS; ++slot) {
+                if(_budgets.slots[slot].budget || _budgets.slots[slot].measurements) {
+                    budget_row(slot, _budgets.slots[slot]);
+                }
+            }
+            ImGui::EndTable();
+        }
+
+        ImGui::BeginChild("BudgetLog");
+        ImGuiListClipper clipper;
+        clipper.Begin(_budgets.overruns.size());
+        while(clipper.Step()) {
+            for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                //newest first
+                const BudgetOverrun& overrun = _budgets.overruns[_budgets.overruns.size() - 1 - row];
+                ImGui::Text("Frame %llu  %s  %llu / %llu%s", (unsigned long long) overrun.frame, _budgets.Name(overrun.slot).c_str(),
+                    (unsigned long long) overrun.cycles, (unsigned long long) overrun.budget, overrun.savestate.empty() ? "" : "  (saved)");
+                if(ImGui::IsItemHovered() && (!overrun.stack.empty() || !overrun.savestate.empty())) {
+                    ImGui::BeginTooltip();
+                    for(const BudgetCall& call : overrun.stack) {
+                        ImGui::Text("%s%s", call.interrupt ? "interrupt " : "", _budgets.Describe(call).c_str());
+                    }
+                    if(!overrun.savestate.empty()) {
+                        ImGui::Text("%s", overrun.savestate.c_str());
+                    }
+                    ImGui::EndTooltip();
+                }
+            }
+        }
+        clipper.End();
+        ImGui::EndChild();
+        ImGui::EndTabItem();
+    }
+
+    if(ImGui::BeginTabItem("Blitter")) {
+        blit_timeline_tab();
+        ImGui::EndTabItem();
+    }
+
+    if(ImGui::BeginTabItem("Hardware Events")) {
+        hardware_trace_tab();
+        ImGui::EndTabItem();
+    }
+
+    if(ImGui::BeginTabItem("Bank Switches")) {
+        bank_switch_tab();
+        ImGui::EndTabItem();
+    }
+
     if(ImGui::BeginTabItem("Deep Profile")) {
+        if(_profiler.DeepProfileRecording()) {
+            ImGui::Text("Recording: %llu events, %llu dropped (F4 to stop)",
+                (unsigned long long) _profiler.deepProfileEvents, (unsigned long long) _profiler.deepProfileDropped);
+        } else if(_profiler.lastDeepProfileRoot != nullptr) {
+            ImGui::Text("Trace written to %s", _profiler.deepProfileTraceFile.c_str());
+            if(_profiler.deepProfileDropped) {
+                ImGui::TextColored(ImVec4(1, 0.2f, 0.2f, 1), "%llu events dropped, calls around them may be mismatched", (unsigned long long) _profiler.deepProfileDropped);
+            }
+            if(_profiler.deepProfileTruncatedNodes) {
+                ImGui::Text("Tree shows the first %d calls, %llu more are only in the trace", DEEP_PROFILE_NODE_LIMIT, (unsigned long long) _profiler.deepProfileTruncatedNodes);
+            }
+        }
         if(_profiler.lastDeepProfileRoot == nullptr) {
             ImGui::Text("Run a deep profile to see results here");
         } else {
 
             if(_profiler.deepProfileZoomFocus == nullptr) {
-                ImGui::Text("Total: %d cycles", _profiler.lastDeepProfileRoot->duration);
+                ImGui::Text("Total: %llu cycles", (unsigned long long) _profiler.lastDeepProfileRoot->duration);
                 for(auto& node : _profiler.lastDeepProfileRoot->children) {
                     recurse_tree_nodes(node, _profiler.lastDeepProfileRoot->duration, 0);
                 }
             } else {
-                ImGui::Text("%s: %d cycles", _profiler.deepProfileZoomFocus->name.c_str(), _profiler.deepProfileZoomFocus->duration);
+                ImGui::Text("%s: %llu cycles", _profiler.deepProfileZoomFocus->name.c_str(), (unsigned long long) _profiler.deepProfileZoomFocus->duration);
                 ImGui::SameLine();
                 if(ImGui::Button("<##unzoom")) {
                     _profiler.deepProfileZoomFocus = nullptr;
@@ -117,6 +808,104 @@ ImVec2 ProfilerWindow::Render() {
         }
         ImGui::EndTabItem();
     }
+
+    if(ImGui::BeginTabItem("Sampling")) {
+        ImGui::Checkbox("Sample", &_sampler.enabled);
+        ImGui::SameLine();
+        int interval = _sampler.interval;
+        ImGui::SetNextItemWidth(100);
+        if(ImGui::InputInt("Interval (cycles)", &interval) && (interval > 0)) {
+            _sampler.interval = interval;
+        }
+        ImGui::SameLine();
+        if(ImGui::Button("Clear")) {
+            _sampler.Clear();
+            lastSampleRefresh = -1;
+        }
+        ImGui::SameLine();
+        if(ImGui::Checkbox("By source line", &sampleByLine)) {
+            lastSampleRefresh = -1;
+        }
+        ImGui::Text("%llu samples", (unsigned long long) _sampler.total);
+
+        //grouping walks every sampled address, once a second is plenty
+        double now = ImGui::GetTime();
+        if((lastSampleRefresh < 0) || (now - lastSampleRefresh > 1.0)) {
+            if(sampleByLine) {
+                sampledLines = _sampler.Lines(SourceMap::singleton);
+            } else {
+                sampledFunctions = _sampler.Functions(memorymap);
+            }
+            lastSampleRefresh = now;
+            sampleResort = true;
+        }
+        sample_table(sampleByLine ? sampledLines : sampledFunctions);
+        ImGui::EndTabItem();
+    }
+
+    if(ImGui::BeginTabItem("Call Graph")) {
+        bool busy = _profiler.DeepProfileRecording() || _profiler.deepProfileArmedFrames;
+        ImGui::SetNextItemWidth(100);
+        ImGui::InputInt("Frames", &recordFrames);
+        if(recordFrames < 1) recordFrames = 1;
+        ImGui::SameLine();
+        ImGui::BeginDisabled(busy);
+        if(ImGui::Button("Record")) {
+            _profiler.deepProfileArmedFrames = recordFrames;
+        }
+        ImGui::EndDisabled();
+        if(_profiler.deepProfileFramesLeft) {
+            ImGui::SameLine();
+            ImGui::Text("%u frames to go", _profiler.deepProfileFramesLeft);
+        }
+
+        if(_profiler.callGraph.empty()) {
+            ImGui::Text("Record some frames (or a deep profile with F4) to see the merged call graph");
+        } else {
+            ImGui::Text("Collapsed stacks written to %s", _profiler.CollapsedStacksFile().c_str());
+            const Profiler::CallGraphNode& focus = _profiler.callGraph[_profiler.callGraphFocus];
+            if(_profiler.callGraphFocus != 0) {
+                if(ImGui::Button("<##flameunzoom")) {
+                    _profiler.callGraphFocus = focus.parent;
+                }
+                ImGui::SameLine();
+                if(ImGui::Button("Root")) {
+                    _profiler.callGraphFocus = 0;
+                }
+                ImGui::SameLine();
+            }
+            ImGui::Text("%s: %llu cycles", _profiler.callGraphNames[focus.name].c_str(), (unsigned long long) focus.inclusive);
+
+            float rows = (float) (_profiler.callGraphDepth - focus.depth + 1);
+            ImGui::BeginChild("FlameGraph", ImVec2(0, 320), false, ImGuiWindowFlags_HorizontalScrollbar);
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            float width = ImGui::GetContentRegionAvail().x;
+            ImGui::Dummy(ImVec2(width, rows * FLAME_ROW_HEIGHT));
+            if(focus.inclusive != 0) {
+                draw_flame_node(ImGui::GetWindowDrawList(), _profiler.callGraphFocus, origin, 0, width, focus.depth);
+            }
+            ImGui::EndChild();
+
+            if(ImGui::BeginTable("CallGraphTable", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY)) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Function");
+                ImGui::TableSetupColumn("Calls");
+                ImGui::TableSetupColumn("Inclusive");
+                ImGui::TableSetupColumn("Exclusive");
+                ImGui::TableSetupColumn("Min");
+                ImGui::TableSetupColumn("Max");
+                ImGui::TableSetupColumn("Avg");
+                ImGui::TableHeadersRow();
+                uint32_t focusIndex = _profiler.callGraphFocus;
+                call_graph_row(focusIndex);
+                for(uint32_t child = _profiler.callGraph[focusIndex].first_child; child != CALL_GRAPH_NONE; child = _profiler.callGraph[child].next_sibling) {
+                    call_graph_row(child);
+                }
+                ImGui::EndTable();
+            }
+        }
+        ImGui::EndTabItem();
+    }
     ImGui::EndTabBar();
     ImGui::SetWindowPos({0, 0});
     ImGui::SetWindowSize({800,800});
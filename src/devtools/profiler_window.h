@@ -1,15 +1,53 @@
 
 #include "debug_window.h"
 #include "profiler.h"
+#include "pc_sampler.h"
+#include "budget_monitor.h"
+#include "bank_profiler.h"
+#include "blit_timeline.h"
+#include "hardware_trace.h"
 
 class ProfilerWindow : public DebugWindow {
 private:
     Profiler& _profiler;
+    PCSampler& _sampler;
+    BudgetMonitor& _budgets;
+    BankProfiler& _banks;
+    std::vector<BankSwitchCaller> bankCallers;
+    std::vector<BankCoLocation> bankPairs;
+    double lastBankRefresh = -1;
+    BlitTimeline& _blits;
+    int blitFramesBack = 0;
+    bool blitTraceWritten = false;
+    HardwareTrace& _hardware;
+    int hardwareFramesBack = 0;
+    bool hardwareShown[HW_EVENT_KINDS];
+    bool hardwareTraceWritten = false;
+    std::vector<size_t> hardwareRows;
+    MemoryMap*& memorymap;
+    std::vector<SampledCode> sampledFunctions;
+    std::vector<SampledCode> sampledLines;
+    double lastSampleRefresh = -1;
+    bool sampleByLine = false;
+    bool sampleResort = false;
     ImVec2 Render();
     float max_scale = 2.0f;
     bool profilerVis[PROFILER_ENTRIES] = {0};
     bool profilerSeen[PROFILER_ENTRIES] = {0};
+    int recordFrames = 60;
     void recurse_tree_nodes(Profiler::DeepProfileCallNode* node, uint64_t totalCycles, uint64_t startTime);
+    void draw_flame_node(ImDrawList* draw, uint32_t index, ImVec2 origin, float x, float width, uint32_t baseDepth);
+    void call_graph_row(uint32_t index);
+    void sample_table(std::vector<SampledCode>& codes);
+    void budget_row(int slot, const BudgetStats& stats);
+    void bank_switch_tab();
+    void blit_timeline_tab();
+    void draw_blit_frame(const BlitFrame& frame);
+    void hardware_trace_tab();
+    void draw_hardware_frame(size_t first, size_t last, uint64_t start, uint64_t end);
 public:
-    ProfilerWindow(Profiler& profiler): _profiler(profiler) {};
+    ProfilerWindow(Profiler& profiler, PCSampler& sampler, BudgetMonitor& budgets, BankProfiler& banks, BlitTimeline& blits, HardwareTrace& hardware, MemoryMap*& map):
+        _profiler(profiler), _sampler(sampler), _budgets(budgets), _banks(banks), _blits(blits), _hardware(hardware), memorymap(map) {
+        std::fill(std::begin(hardwareShown), std::end(hardwareShown), true);
+    };
 };
\ No newline at end of file
@@ -140,6 +140,118 @@ SourceMap::SourceMap(std::string& dbg_file_path) {
     for(auto& file : files) {
         file_names.emplace_back(file.name);
     }
+
+    for(auto& sym_map : dbg_table["sym"]) {
+        if(!sym_map.contains("seg") || !sym_map.contains("name")) {
+            continue;
+        }
+        unsigned int seg_id = std::stoi(sym_map["seg"]);
+        auto seg = std::find_if(segments.begin(), segments.end(), [seg_id](const SourceMapSegment& s) { return s.id == seg_id; });
+        if((seg == segments.end()) || !seg->has_bank) {
+            continue;
+        }
+        std::string name = sym_map["name"];
+        if((name.size() >= 2) && (name.front() == '"')) {
+            name = name.substr(1, name.size() - 2);
+        }
+        symbol_banks.emplace(name, seg->bank);
+    }
+
+    BuildIndex();
+}
+
+//Resolves every address a banked segment covers the way a linear search
+//would: first segment by id, up to three spans by id, and the last C line
+//(type 1) of those spans or else the first line of any of them.
+void SourceMap::BuildIndex() {
+    std::vector<int> span_first_line(spans.size(), -1);
+    std::vector<int> span_c_line(spans.size(), -1);
+    for(auto& line : lines) {
+        if(!line.has_span || (line.span >= spans.size())) {
+            continue;
+        }
+        if(span_first_line[line.span] == -1) {
+            span_first_line[line.span] = line.id;
+        }
+        if(line.has_type && (line.type == 1)) {
+            span_c_line[line.span] = line.id;
+        }
+    }
+    std::vector<std::vector<unsigned int>> spans_by_segment(segments.size());
+    for(auto& span : spans) {
+        if((span.segment < segments.size()) && (span.id < spans.size())) {
+            spans_by_segment[span.segment].push_back(span.id);
+        }
+    }
+
+    const int ADDRESSES = 0x10000;
+    std::vector<int> cell_segment(ADDRESSES);
+    std::vector<uint8_t> cell_spans(ADDRESSES);
+    std::vector<int> cell_first(ADDRESSES);
+    std::vector<int> cell_c(ADDRESSES);
+    for(int bank = 0; bank < 128; ++bank) {
+        runs_by_bank[bank].clear();
+        bool any = false;
+        for(auto& seg : segments) {
+            any |= seg.has_bank && ((int) (seg.bank & 127) == bank);
+        }
+        if(!any) {
+            continue;
+        }
+        std::fill(cell_segment.begin(), cell_segment.end(), -1);
+        std::fill(cell_spans.begin(), cell_spans.end(), 0);
+        std::fill(cell_first.begin(), cell_first.end(), -1);
+        std::fill(cell_c.begin(), cell_c.end(), -1);
+        for(auto& seg : segments) {
+            if(!seg.has_bank || ((int) (seg.bank & 127) != bank) || (seg.id >= segments.size())) {
+                continue;
+            }
+            unsigned int seg_end = std::min<unsigned int>(seg.start + seg.size, ADDRESSES);
+            for(unsigned int addr = seg.start; addr < seg_end; ++addr) {
+                if(cell_segment[addr] == -1) {
+                    cell_segment[addr] = seg.id;
+                }
+            }
+            for(unsigned int span_id : spans_by_segment[seg.id]) {
+                const SourceMapSpan& span = spans[span_id];
+                unsigned int span_end = std::min(seg.start + span.start + span.size, seg_end);
+                for(unsigned int addr = seg.start + span.start; addr < span_end; ++addr) {
+                    if((cell_segment[addr] != (int) seg.id) || (cell_spans[addr] == 3)) {
+                        continue;
+                    }
+                    ++cell_spans[addr];
+                    if(cell_first[addr] == -1) {
+                        cell_first[addr] = span_first_line[span_id];
+                    }
+                    if(span_c_line[span_id] != -1) {
+                        cell_c[addr] = span_c_line[span_id];
+                    }
+                }
+            }
+        }
+        std::vector<AddressRun>& runs = runs_by_bank[bank];
+        for(int addr = 0; addr < ADDRESSES; ++addr) {
+            if(cell_segment[addr] == -1) {
+                continue;
+            }
+            int line = (cell_c[addr] != -1) ? cell_c[addr] : cell_first[addr];
+            int debug = (cell_spans[addr] == 0) ? 2 : cell_segment[addr];
+            if(!runs.empty() && (runs.back().end == addr - 1) && (runs.back().line == line) && (runs.back().debug == debug)) {
+                runs.back().end = addr;
+            } else {
+                runs.push_back({(uint16_t) addr, (uint16_t) addr, line, debug});
+            }
+        }
+    }
+
+    for(auto& file : files) {
+        file_ids.emplace(file.name, file.id);
+    }
+    for(auto& line : lines) {
+        if(line.has_span) {
+            line_ids.emplace(((uint64_t) line.file << 32) | line.line, line.id);
+        }
+    }
 }
 
 SourceMapSearchResult SourceMap::Search(uint16_t addr, uint8_t bank) {
@@ -157,66 +269,20 @@ SourceMapSearchResult SourceMap::Search(uint16_t addr, uint8_t bank) {
         bank = 127;
     }
 
-    int seg_idx = -1;
-    uint16_t rel_addr = 0;
-
-    for(auto& seg: segments) {
-        if(seg.has_bank && ((seg.bank & 127) == bank)) {
-            if((addr >= seg.start) && ((addr - seg.start) < seg.size)) {
-                seg_idx = seg.id;
-                rel_addr = addr - seg.start;
-                break;
-            }
-        }
-    }
-    if(seg_idx == -1) {
+    const std::vector<AddressRun>& runs = runs_by_bank[bank];
+    auto run = std::upper_bound(runs.begin(), runs.end(), addr, [](uint16_t a, const AddressRun& r) {
+        return a < r.start;
+    });
+    if((run == runs.begin()) || ((run - 1)->end < addr)) {
         result.debug = 1;
         return result;
     }
-
-    int spans_found = 0;
-#define MAX_MATCHING_SPANS 3
-    int matching_spans[3];
-    for(auto& span: spans) {
-        if(span.segment == seg_idx) {
-            if((rel_addr >= span.start) && ((rel_addr - span.start) < span.size)) {
-                    matching_spans[spans_found++] = span.id;
-                    if(spans_found == MAX_MATCHING_SPANS)
-                        break;
-            }
-        }
-    }
-
-    if(spans_found == 0) {
-        result.debug = 2;
-        return result;
-    }
-
-
-    int line_idx = -1;
-    int first_found_line = -1;
-    result.debug = seg_idx;
-    for(int i = 0; i < spans_found; ++i) {
-            for(auto& line: lines) {
-            if(line.has_span && (line.span == matching_spans[i])) {
-                if(first_found_line == -1)
-                    first_found_line = line.id;
-
-                /* Find the C version, presumably meaning type 1 */
-                if(line.has_type && (line.type == 1)) {
-                    line_idx = line.id;
-                }
-            }
-        }
-    }
-
-    if(first_found_line == -1) {
+    --run;
+    result.debug = run->debug;
+    if(run->line == -1) {
         return result;
     }
-
-    if(line_idx == -1) {
-        line_idx = first_found_line;
-    }
+    int line_idx = run->line;
 
     result.line = &lines[line_idx];
     if((result.line == nullptr) || (result.line->id != line_idx)) {
@@ -231,6 +297,19 @@ SourceMapSearchResult SourceMap::Search(uint16_t addr, uint8_t bank) {
     return result;
 }
 
+void SourceMap::ForEachAddressRun(const std::function<void(uint8_t bank, uint16_t start, uint16_t end,
+    const SourceMapFile& file, const SourceMapLine& line)>& func) const {
+    for(int bank = 0; bank < 128; ++bank) {
+        for(auto& run : runs_by_bank[bank]) {
+            if(run.line == -1) {
+                continue;
+            }
+            const SourceMapLine& line = lines[run.line];
+            func(bank, run.start, run.end, files[line.file], line);
+        }
+    }
+}
+
 void SourceMap::GetFileContent(SourceMapFile &sourceMapFile) {
     // Check if contents are already cached
     if (sourceMapFile.contents_cached) {
@@ -256,25 +335,12 @@ void SourceMap::GetFileContent(SourceMapFile &sourceMapFile) {
 
 SourceMapReverseSearchResult SourceMap::ReverseSearch(std::string name, int line) {
     SourceMapReverseSearchResult result = { false, 0, 0 };
-    int file_idx = -1;
-    int line_idx = -1;
-    for(auto& smfile : files) {
-        if(smfile.name == name) {
-            file_idx = smfile.id;
-            break;
-        }
-    }
-
-    if(file_idx == -1) return result;
-
-    for(auto& smline : lines) {
-        if((smline.file == file_idx) && (smline.line == line) && (smline.has_span)) {
-            line_idx = smline.id;
-            break;
-        }
-    }
+    auto file = file_ids.find(name);
+    if(file == file_ids.end()) return result;
 
-    if(line_idx == -1) return result;
+    auto found = line_ids.find(((uint64_t) file->second << 32) | (unsigned int) line);
+    if(found == line_ids.end()) return result;
+    unsigned int line_idx = found->second;
 
     result.address = spans[lines[line_idx].span].start;
     result.address += segments[spans[lines[line_idx].span].segment].start;
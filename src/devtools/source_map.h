@@ -2,6 +2,8 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <unordered_map>
+#include <functional>
 
 typedef struct SourceMapLine {
     unsigned int id;
@@ -51,13 +53,30 @@ typedef struct SourceMapReverseSearchResult {
     uint8_t bank;
 } SourceMapReverseSearchResult;
 
+// Address to source line lookups over a cc65 debug file.
+// At load time every banked address is resolved once and the results are
+// stored per bank as sorted runs of addresses sharing a line, so Search is a
+// binary search. ReverseSearch goes through hashes of file names and
+// (file, line) pairs.
 class SourceMap {
 private:
+    struct AddressRun {
+        uint16_t start;
+        uint16_t end; //inclusive
+        int line;     //line id, -1 if none
+        int debug;    //why no line was found, reported like Search always has
+    };
     std::vector<SourceMapLine> lines;
     std::vector<SourceMapFile> files;
     std::vector<SourceMapSpan> spans;
     std::vector<SourceMapSegment> segments;
     std::vector<std::string> file_names;
+    std::unordered_map<std::string, int> symbol_banks;
+    std::vector<AddressRun> runs_by_bank[128];
+    std::unordered_map<std::string, unsigned int> file_ids;
+    //(file id << 32 | line number) to the first line id with a span
+    std::unordered_map<uint64_t, unsigned int> line_ids;
+    void BuildIndex();
 public:
     std::string project_root;
     static SourceMap* singleton;
@@ -65,5 +84,10 @@ public:
     SourceMap(std::string& dbg_file_path);
     SourceMapSearchResult Search(uint16_t addr, uint8_t bank);
     SourceMapReverseSearchResult ReverseSearch(std::string name, int line);
+    //every run of addresses (end inclusive) that maps to a source line, bank by bank
+    void ForEachAddressRun(const std::function<void(uint8_t bank, uint16_t start, uint16_t end,
+        const SourceMapFile& file, const SourceMapLine& line)>& func) const;
     std::vector<std::string>& GetFileNames();
+    //flash bank of every label in a banked segment, for MemoryMap::AssignBanks
+    const std::unordered_map<std::string, int>& GetSymbolBanks() const { return symbol_banks; }
 };
\ No newline at end of file
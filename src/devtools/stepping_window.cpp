@@ -5,6 +5,9 @@
 #include "imgui-combo-filter.h"
 #include "source_map.h"
 #include <string>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
 
 const char* source_file_getter(const std::vector<std::string> &items, int index) {
     if (index >= 0 && index < (int)items.size()) {
@@ -13,6 +16,136 @@ const char* source_file_getter(const std::vector<std::string> &items, int index)
     return "N/A";
 }
 
+//0 for cold up to 1 for the hottest, on a log scale so one tight loop doesn't wash out everything else
+static float heat(uint64_t value, uint64_t max) {
+    if((value == 0) || (max == 0)) {
+        return 0;
+    }
+    return (float) (log1p((double) value) / log1p((double) max));
+}
+
+//Tints the line about to be drawn
+static void heat_background(float t) {
+    if(t <= 0) {
+        return;
+    }
+    ImVec2 p = ImGui::GetCursorScreenPos();
+    ImGui::GetWindowDrawList()->AddRectFilled(p,
+        ImVec2(p.x + ImGui::GetContentRegionAvail().x, p.y + ImGui::GetTextLineHeight()),
+        IM_COL32(255, 64, 0, (int) (32 + 160 * t)));
+}
+
+void SteppingWindow::RefreshLineCounters() {
+    if(lineCountersCycle == timekeeper.totalCyclesCount) {
+        return;
+    }
+    lineCountersCycle = timekeeper.totalCyclesCount;
+    lineCounters.clear();
+    SourceMap::singleton->ForEachAddressRun([this](uint8_t bank, uint16_t start, uint16_t end, const SourceMapFile& file, const SourceMapLine& line) {
+        if(!(start & 0x8000)) {
+            return;
+        }
+        ExecCounter& busiest = lineCounters[((uint64_t) line.file << 32) | line.line];
+        for(uint32_t address = start; address <= end; ++address) {
+            ExecCounter* counter = coverage.Rom(bank, address);
+            if(counter && (counter->count > busiest.count)) {
+                busiest = *counter;
+            }
+        }
+    });
+}
+
+void SteppingWindow::CoverageTab() {
+    ImGui::Checkbox("Count executions", &coverage.enabled);
+    ImGui::SameLine();
+    if(ImGui::Button("Clear")) {
+        coverage.Clear();
+        lastHottestRefresh = -1;
+        lineCountersCycle = UINT64_MAX;
+    }
+    static const char* lcovStatus = "";
+    if(SourceMap::singleton) {
+        ImGui::SameLine();
+        if(ImGui::Button("Export lcov")) {
+            lcovStatus = coverage.WriteLcov("coverage.lcov", SourceMap::singleton) ? "Wrote coverage.lcov" : "Export failed";
+        }
+        ImGui::SameLine();
+        ImGui::Text("%s", lcovStatus);
+    }
+
+    uint64_t total = coverage.TotalCycles();
+    ImGui::Text("%llu cycles counted", (unsigned long long) total);
+    if(total == 0) {
+        return;
+    }
+
+    float mix[256];
+    int order[256];
+    for(int i = 0; i < 256; ++i) {
+        mix[i] = (float) coverage.opcodes[i].cycles / total;
+        order[i] = i;
+    }
+    ImGui::PlotHistogram("##opcodemix", mix, 256, 0, "Cycles by opcode", 0, FLT_MAX, ImVec2(-1, 80));
+    std::sort(order, order + 256, [this](int a, int b) {
+        return coverage.opcodes[a].cycles > coverage.opcodes[b].cycles;
+    });
+
+    if(ImGui::BeginTable("OpcodeMix", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImVec2(0, 160))) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Opcode");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("Cycles");
+        ImGui::TableSetupColumn("Share");
+        ImGui::TableHeadersRow();
+        for(int i = 0; (i < 256) && coverage.opcodes[order[i]].count; ++i) {
+            const ExecCounter& op = coverage.opcodes[order[i]];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%02X %s", order[i], Disassembler::OpcodeName(order[i]).c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) op.count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) op.cycles);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f%%", 100.0f * mix[order[i]]);
+        }
+        ImGui::EndTable();
+    }
+
+    //finding the hottest walks every counter, a second out of date is fine
+    double now = ImGui::GetTime();
+    if((lastHottestRefresh < 0) || (now - lastHottestRefresh > 1.0)) {
+        hottest = coverage.Hottest(64);
+        lastHottestRefresh = now;
+    }
+    if(ImGui::BeginTable("HotAddresses", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Address");
+        ImGui::TableSetupColumn("Symbol");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("Cycles");
+        ImGui::TableHeadersRow();
+        for(auto& hot : hottest) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if(hot.ram_bank != -1) {
+                ImGui::Text("RAM%d:%04X", hot.ram_bank, hot.address);
+            } else if(hot.bank == -1) {
+                ImGui::Text("%04X", hot.address);
+            } else {
+                ImGui::Text("%02X:%04X", hot.bank, hot.address);
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", memorymap ? memorymap->Describe(hot.address, hot.bank).c_str() : "");
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) hot.counter.count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu (%.1f%%)", (unsigned long long) hot.counter.cycles, (100.0 * hot.counter.cycles) / total);
+        }
+        ImGui::EndTable();
+    }
+}
+
 ImVec2 SteppingWindow::Render() {
      ImVec2 sizeOut = {0, 0};
 
@@ -169,18 +302,36 @@ ImVec2 SteppingWindow::Render() {
 
     ImGui::Text("A:      %02x X:     %02x  Y:   %02x", cpu->A, cpu->X, cpu->Y);
     ImGui::Text("Status: %02x Stack: %02x PC: %04x", cpu->status, cpu->sp, cpu->pc);
-    ImGui::Text("Cycles Since Boot: %lu", timekeeper.totalCyclesCount);
+    ImGui::Text("Cycles Since Boot: %llu", (unsigned long long) timekeeper.totalCyclesCount);
     ImGui::NewLine();
 
     ImGui::BeginTabBar("codetabs", 0);
     if(ImGui::BeginTabItem("Disassembly")) {
 
         if(timekeeper.clock_mode == CLOCKMODE_STOPPED) {
-            for(auto& line : Disassembler::GetLastDecode()) {
+            std::vector<AsmLine> decoded = Disassembler::GetLastDecode();
+            uint64_t maxCycles = 0;
+            if(coverage.enabled) {
+                for(auto& line : decoded) {
+                    const ExecCounter* counter = coverage.At(line.address, RamBank(), cartridgestate.bank_mask);
+                    if(!line.isLabel && counter) {
+                        maxCycles = std::max(maxCycles, counter->cycles);
+                    }
+                }
+            }
+            for(auto& line : decoded) {
                 if(line.isLabel) {
                     ImGui::Text("%s", line.disassembledLine.c_str());
                 } else {
+                    const ExecCounter* counter = coverage.enabled ? coverage.At(line.address, RamBank(), cartridgestate.bank_mask) : NULL;
+                    if(counter) {
+                        heat_background(heat(counter->cycles, maxCycles));
+                    }
                     ImGui::Text("%04x %s", line.address, line.disassembledLine.c_str());
+                    if(counter && counter->count) {
+                        ImGui::SameLine(260);
+                        ImGui::TextDisabled("%llux %llu cyc", (unsigned long long) counter->count, (unsigned long long) counter->cycles);
+                    }
                 }
             }
         }
@@ -197,12 +348,31 @@ ImVec2 SteppingWindow::Render() {
                     if(res.file->contents_cached) {
                         ImGui::BeginChild("Source file");
                         int i = 1;
+                        uint64_t maxCount = 0;
+                        if(coverage.enabled) {
+                            RefreshLineCounters();
+                            for(auto& counted : lineCounters) {
+                                if((counted.first >> 32) == res.file->id) {
+                                    maxCount = std::max(maxCount, counted.second.count);
+                                }
+                            }
+                        }
                         
                         for(auto& line : res.file->contents) {
                             auto color = (i == res.line->line) ? ImVec4(1, 1, 1, 1) : ImVec4(0.75, 0.75, 0.75, 1);
                             if(i == res.line->line) {
                                 ImGui::Separator();
                             }
+                            if(coverage.enabled) {
+                                auto counted = lineCounters.find(((uint64_t) res.file->id << 32) | i);
+                                if(counted != lineCounters.end()) {
+                                    heat_background(heat(counted->second.count, maxCount));
+                                    ImGui::TextDisabled("%9llu", (unsigned long long) counted->second.count);
+                                } else {
+                                    ImGui::TextDisabled("%9s", "");
+                                }
+                                ImGui::SameLine();
+                            }
                             ImGui::TextColored(color, "%s", line.c_str());
                             if(i == res.line->line) {
                                 ImGui::Separator();
@@ -223,6 +393,10 @@ ImVec2 SteppingWindow::Render() {
         }
         ImGui::EndTabItem();
     }
+    if(ImGui::BeginTabItem("Coverage")) {
+        CoverageTab();
+        ImGui::EndTabItem();
+    }
 
     ImGui::EndTabBar();
     ImGui::SetWindowPos({0, 0});
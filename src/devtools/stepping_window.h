@@ -5,6 +5,8 @@
 #include "../mos6502/mos6502.h"
 #include "../game_config.h"
 #include "../system_state.h"
+#include "exec_coverage.h"
+#include <unordered_map>
 
 class SteppingWindow : public DebugWindow {
 private:
@@ -13,6 +15,16 @@ private:
     mos6502* cpu;
     GameConfig& gameconfig;
     CartridgeState& cartridgestate;
+    SystemState& systemstate;
+    ExecCoverage& coverage;
+    //(file id << 32 | line) to the busiest instruction's counter, rebuilt when the CPU has moved on
+    std::unordered_map<uint64_t, ExecCounter> lineCounters;
+    uint64_t lineCountersCycle = UINT64_MAX;
+    std::vector<HotAddress> hottest;
+    double lastHottestRefresh = -1;
+    uint8_t RamBank() const { return (systemstate.banking & BANK_RAM_MASK) >> 6; }
+    void RefreshLineCounters();
+    void CoverageTab();
 protected:
     ImVec2 Render();
 public:
@@ -20,10 +32,14 @@ public:
         MemoryMap*& memorymap,
         mos6502* cpu,
         GameConfig& gameconfig,
-        CartridgeState& cartridgestate) : 
+        CartridgeState& cartridgestate,
+        SystemState& systemstate,
+        ExecCoverage& coverage) : 
         timekeeper(timekeeper),
         memorymap(memorymap),
         cpu(cpu),
         gameconfig(gameconfig),
-        cartridgestate(cartridgestate){};
+        cartridgestate(cartridgestate),
+        systemstate(systemstate),
+        coverage(coverage){};
 };
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "trace_writer.h"
+
+std::string json_string(const std::string& text) {
+    std::string quoted = "\"";
+    for(char c : text) {
+        if((c == '"') || (c == '\\')) {
+            quoted += '\\';
+            quoted += c;
+        } else if((unsigned char) c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    quoted += '"';
+    return quoted;
+}
+
+TraceWriter::~TraceWriter() {
+    Close();
+}
+
+bool TraceWriter::Open(const std::string& filename, uint64_t clock_hz, uint64_t start, const std::string& other_data) {
+    Close();
+    file = fopen(filename.c_str(), "w");
+    if(!file) {
+        return false;
+    }
+    cycles_per_microsecond = clock_hz / 1000000.0;
+    this->start = start;
+    first = true;
+    fprintf(file, "{\"displayTimeUnit\": \"ns\",\n");
+    fprintf(file, "\"otherData\": {\"clock_hz\": %llu%s%s},\n", (unsigned long long) clock_hz,
+        other_data.empty() ? "" : ", ", other_data.c_str());
+    fprintf(file, "\"traceEvents\": [\n");
+    return true;
+}
+
+double TraceWriter::Microseconds(uint64_t cycle) const {
+    return (cycle - start) / cycles_per_microsecond;
+}
+
+//fields go between the phase and the ids, each starting with ", "
+void TraceWriter::Event(const std::string& name, const char* phase, int tid, const std::string& fields, const std::string& args) {
+    if(!file) {
+        return;
+    }
+    fprintf(file, "%s{", first ? "" : ",\n");
+    if(!name.empty()) {
+        fprintf(file, "\"name\": %s, ", json_string(name).c_str());
+    }
+    fprintf(file, "\"ph\": \"%s\"%s, \"pid\": 1, \"tid\": %d", phase, fields.c_str(), tid);
+    if(!args.empty()) {
+        fprintf(file, ", \"args\": {%s}", args.c_str());
+    }
+    fputc('}', file);
+    first = false;
+}
+
+void TraceWriter::ThreadName(int tid, const std::string& name) {
+    Event("thread_name", "M", tid, "", "\"name\": " + json_string(name));
+}
+
+void TraceWriter::Begin(int tid, const std::string& name, const char* category, uint64_t cycle, const std::string& args) {
+    char fields[96];
+    snprintf(fields, sizeof(fields), ", \"cat\": \"%s\", \"ts\": %.3f", category, Microseconds(cycle));
+    Event(name, "B", tid, fields, args);
+}
+
+void TraceWriter::End(int tid, uint64_t cycle) {
+    char fields[96];
+    snprintf(fields, sizeof(fields), ", \"ts\": %.3f", Microseconds(cycle));
+    Event("", "E", tid, fields, "");
+}
+
+void TraceWriter::Complete(int tid, const std::string& name, uint64_t start_cycle, uint64_t end_cycle, const std::string& args) {
+    char fields[96];
+    snprintf(fields, sizeof(fields), ", \"ts\": %.3f, \"dur\": %.3f", Microseconds(start_cycle),
+        Microseconds(end_cycle) - Microseconds(start_cycle));
+    Event(name, "X", tid, fields, args);
+}
+
+void TraceWriter::Instant(int tid, const std::string& name, uint64_t cycle, const std::string& args) {
+    char fields[96];
+    snprintf(fields, sizeof(fields), ", \"s\": \"t\", \"ts\": %.3f", Microseconds(cycle));
+    Event(name, "i", tid, fields, args);
+}
+
+//Ends the event list, returns false if anything failed to write
+bool TraceWriter::Close() {
+    if(!file) {
+        return false;
+    }
+    fprintf(file, "\n]}\n");
+    bool ok = !ferror(file);
+    ok = (fclose(file) == 0) && ok;
+    file = NULL;
+    return ok;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+//text as a quoted JSON string, with quotes, backslashes and control characters escaped
+std::string json_string(const std::string& text);
+
+// Writes the Chrome trace event format read by chrome://tracing and Perfetto.
+// Events are timed in emulated cycles and written as microseconds since the
+// start cycle. Everything is in process 1, the thread id picks the track.
+// Writing to a trace that couldn't be opened does nothing.
+class TraceWriter {
+private:
+    FILE* file = NULL;
+    double cycles_per_microsecond = 1.0;
+    uint64_t start = 0;
+    bool first = true;
+    double Microseconds(uint64_t cycle) const;
+    void Event(const std::string& name, const char* phase, int tid, const std::string& fields, const std::string& args);
+public:
+    ~TraceWriter();
+    //other_data is "key": value pairs added to the otherData object after clock_hz
+    bool Open(const std::string& filename, uint64_t clock_hz, uint64_t start, const std::string& other_data);
+    bool IsOpen() const { return file != NULL; }
+    void ThreadName(int tid, const std::string& name);
+    //args is "key": value pairs for the event's args object, left out when empty
+    void Begin(int tid, const std::string& name, const char* category, uint64_t cycle, const std::string& args = "");
+    void End(int tid, uint64_t cycle);
+    void Complete(int tid, const std::string& name, uint64_t start_cycle, uint64_t end_cycle, const std::string& args = "");
+    void Instant(int tid, const std::string& name, uint64_t cycle, const std::string& args = "");
+    bool Close();
+};
@@ -7,7 +7,7 @@
 VRAMWindow::VRAMWindow(
     SDL_Surface* vram, SDL_Surface* gram, 
     SystemState* system, mos6502* cpu, 
-    CartridgeState* cartridge) : BaseWindow(BUFFERS_PREVIEW_WIDTH, BUFFERS_PREVIEW_HEIGHT) {
+    CartridgeState* cartridge, MemoryHeatmap* heatmap) : BaseWindow(BUFFERS_PREVIEW_WIDTH, BUFFERS_PREVIEW_HEIGHT) {
 
     SDL_SetWindowTitle(window, "VRAM Viewer");
     surface = SDL_GetWindowSurface(window);
@@ -18,6 +18,27 @@ VRAMWindow::VRAMWindow(
     system_state = system;
     cpu_core = cpu;
     cartridge_state = cartridge;
+    this->heatmap = heatmap;
+}
+
+//Heat drawn over the same layout as the buffers, writes red and reads green
+void VRAMWindow::DrawHeat() {
+    Uint32* pixels = (Uint32*) surface->pixels;
+    int pitch = surface->pitch / sizeof(Uint32);
+    for(int y = 0; y < 256; ++y) {
+        for(int x = 0; x < 128; ++x) {
+            uint32_t color = heatmap->Color(HEAT_VRAM, (y << 7) | x);
+            pixels[y * pitch + x] = SDL_MapRGB(surface->format, color >> 16, (color >> 8) & 0xFF, color & 0xFF);
+        }
+    }
+    for(int i = 0; i < 8; i++) {
+        for(int y = 0; y < 512; ++y) {
+            for(int x = 0; x < 128; ++x) {
+                uint32_t color = heatmap->Color(HEAT_GRAM, (i << 16) | (y << 7) | x);
+                pixels[y * pitch + (i+1) * 128 + x] = SDL_MapRGB(surface->format, color >> 16, (color >> 8) & 0xFF, color & 0xFF);
+            }
+        }
+    }
 }
 
 void VRAMWindow::Draw() {
@@ -44,6 +65,10 @@ void VRAMWindow::Draw() {
 	SDL_BlitSurface(gRAM_Surface, &src, surface, &dest);
     }
 
+    if(show_heat) {
+        DrawHeat();
+    }
+
     // Render text
     // Clear the text area before re-rendering as not all text is always rendered
     dest.x = 0;
@@ -52,20 +77,21 @@ void VRAMWindow::Draw() {
     dest.h = 256;
     SDL_FillRect(surface, &dest, 0);
 
-    char buf[128];
+    char buf[192];
 
     int charsWritten = sprintf(
 	buf,
-	"DMA:\n%x\nBANK:\n%x\nPC:\n%x\nSTATUS:\n%x\nWAIT:%d\nHIBITS:%d\n\n",
+	"DMA:\n%x\nBANK:\n%x\nPC:\n%x\nSTATUS:\n%x\nWAIT:%d\nHIBITS:%d\nHEAT:%s\n\n",
 	system_state->dma_control,
 	system_state->banking,
 	cpu_core->pc,
 	cpu_core->status,
 	cpu_core->waiting,
-	cartridge_state->bank_mask
+	cartridge_state->bank_mask,
+	show_heat ? (heatmap->enabled ? "ON" : "PAUSED") : "OFF"
     );
 
-    WriteDataUnderMouse(buf + charsWritten, 128 - charsWritten);
+    WriteDataUnderMouse(buf + charsWritten, sizeof(buf) - charsWritten);
     dest.x = 0;
     dest.y = 256;
     dest.w = 128;
@@ -83,6 +109,14 @@ void VRAMWindow::HandleEvent(SDL_Event& e) {
                 open = false;
             }
         }
+    } else if((e.type == SDL_KEYDOWN) && (e.key.windowID == SDL_GetWindowID(window))) {
+        if(e.key.keysym.sym == SDLK_h) {
+            show_heat = !show_heat;
+            //nothing to show until something is counted
+            if(show_heat) {
+                heatmap->enabled = true;
+            }
+        }
     }
 }
 
@@ -115,7 +149,7 @@ void VRAMWindow::WriteDataUnderMouse(char *buf, int bufSize) {
 
 	int framebuffer = y >> 7;
 
-	snprintf(
+	int written = snprintf(
 	  buf,
 	  bufSize - 1,
 	  "VRAM\nFRAMEBUFFER: %d\nADDR: 0x%X\nVAL: 0x%02X",
@@ -123,6 +157,7 @@ void VRAMWindow::WriteDataUnderMouse(char *buf, int bufSize) {
 	  addr,
 	  system_state->vram[hovered_pixel]
 	);
+	WriteHeatUnderMouse(buf + written, bufSize - written, HEAT_VRAM, hovered_pixel);
     } else {
 	// The user is hovering over GRAM
         // Correct for the fact that GRAM starts at position 128 in the viewer
@@ -142,7 +177,7 @@ void VRAMWindow::WriteDataUnderMouse(char *buf, int bufSize) {
 	  "SE"
 	};
 
-	snprintf(
+	int written = snprintf(
 	  buf,
 	  bufSize - 1,
 	  "GRAM\nBANK: %d\nQUADRANT: %s\nADDR: 0x%X\nVAL: 0x%02X",
@@ -151,5 +186,19 @@ void VRAMWindow::WriteDataUnderMouse(char *buf, int bufSize) {
 	  addr,
 	  system_state->gram[hovered_pixel]
         );
+	WriteHeatUnderMouse(buf + written, bufSize - written, HEAT_GRAM, hovered_pixel);
+    }
+}
+
+void VRAMWindow::WriteHeatUnderMouse(char *buf, int bufSize, HeatmapRegion region, uint32_t offset) {
+    if(!show_heat || (bufSize <= 1)) {
+	return;
     }
+    snprintf(
+      buf,
+      bufSize - 1,
+      "\nREADS: %u\nWRITES: %u",
+      heatmap->Reads(region, offset),
+      heatmap->Writes(region, offset)
+    );
 }
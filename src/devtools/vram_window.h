@@ -3,6 +3,7 @@
 #include "base_window.h"
 #include "../system_state.h"
 #include "../mos6502/mos6502.h"
+#include "memory_heatmap.h"
 
 class VRAMWindow : public BaseWindow {
 private:
@@ -12,10 +13,16 @@ private:
     SystemState* system_state;
     mos6502* cpu_core;
     CartridgeState* cartridge_state;
+    MemoryHeatmap* heatmap;
+    //H swaps the buffers for their access heatmaps
+    bool show_heat = false;
+
+    void DrawHeat();
 
     void WriteDataUnderMouse(char *buf, int bufSize);
+    void WriteHeatUnderMouse(char *buf, int bufSize, HeatmapRegion region, uint32_t offset);
 public:
-    VRAMWindow(SDL_Surface* vram, SDL_Surface* gram, SystemState* system, mos6502* cpu, CartridgeState* cartridge);
+    VRAMWindow(SDL_Surface* vram, SDL_Surface* gram, SystemState* system, mos6502* cpu, CartridgeState* cartridge, MemoryHeatmap* heatmap);
     void Draw();
     void HandleEvent(SDL_Event& e);
 };
@@ -1,5 +1,6 @@
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
 #include "emulator_config.h"
 
 bool EmulatorConfig::noSound = false;
@@ -7,6 +8,40 @@ bool EmulatorConfig::noJoystick = false;
 bool EmulatorConfig::noSave = false;
 Uint32 EmulatorConfig::defaultRendererFlags = SDL_RENDERER_ACCELERATED;
 char *EmulatorConfig::xorFile = NULL;
+int EmulatorConfig::sampleRate = 44100;
+char *EmulatorConfig::wavFile = NULL;
+char *EmulatorConfig::inputScript = NULL;
+uint32_t EmulatorConfig::frameLimit = 0;
+char *EmulatorConfig::acpReportFile = NULL;
+char *EmulatorConfig::busReportFile = NULL;
+char *EmulatorConfig::deepProfileFile = NULL;
+char *EmulatorConfig::sampleReportFile = NULL;
+char *EmulatorConfig::coverageFile = NULL;
+char *EmulatorConfig::budgetReportFile = NULL;
+char *EmulatorConfig::bankReportFile = NULL;
+char *EmulatorConfig::blitTimelineFile = NULL;
+char *EmulatorConfig::hardwareTraceFile = NULL;
+char *EmulatorConfig::hardwareTraceKinds = NULL;
+#ifdef WASM_BUILD
+uint32_t EmulatorConfig::flightRecorderMillions = 0;
+#else
+uint32_t EmulatorConfig::flightRecorderMillions = 1;
+#endif
+char *EmulatorConfig::flightQueryFile = NULL;
+char *EmulatorConfig::flightFilter = NULL;
+uint64_t EmulatorConfig::flightLast = 0;
+uint32_t EmulatorConfig::flightHot = 0;
+#ifdef WASM_BUILD
+uint32_t EmulatorConfig::rewindMegabytes = 0;
+#else
+uint32_t EmulatorConfig::rewindMegabytes = 32;
+#endif
+uint32_t EmulatorConfig::rewindInterval = 2;
+uint64_t EmulatorConfig::seed = 0;
+bool EmulatorConfig::fixedSeed = false;
+char *EmulatorConfig::recordFile = NULL;
+char *EmulatorConfig::playFile = NULL;
+uint32_t EmulatorConfig::movieSeek = 0;
 
 void EmulatorConfig::parseArg(const char* arg) {
     if(strcmp(arg, "--nosound") == 0) {
@@ -31,6 +66,168 @@ void EmulatorConfig::parseArg(const char* arg) {
       return;
     }
 
+    const char *sampleRatePrefix = "--samplerate=";
+    if(strncmp(arg, sampleRatePrefix, strlen(sampleRatePrefix)) == 0) {
+      sampleRate = atoi(arg + strlen(sampleRatePrefix));
+      if(sampleRate <= 0) {
+        sampleRate = 44100;
+      }
+      return;
+    }
+
+    const char *wavFilePrefix = "--wav=";
+    if(strncmp(arg, wavFilePrefix, strlen(wavFilePrefix)) == 0) {
+      wavFile = strdup(arg + strlen(wavFilePrefix));
+      return;
+    }
+
+    const char *inputScriptPrefix = "--input=";
+    if(strncmp(arg, inputScriptPrefix, strlen(inputScriptPrefix)) == 0) {
+      inputScript = strdup(arg + strlen(inputScriptPrefix));
+      return;
+    }
+
+    const char *framesPrefix = "--frames=";
+    if(strncmp(arg, framesPrefix, strlen(framesPrefix)) == 0) {
+      frameLimit = strtoul(arg + strlen(framesPrefix), NULL, 10);
+      return;
+    }
+
+    const char *secondsPrefix = "--seconds=";
+    if(strncmp(arg, secondsPrefix, strlen(secondsPrefix)) == 0) {
+      frameLimit = (uint32_t) (atof(arg + strlen(secondsPrefix)) * 60);
+      return;
+    }
+
+    const char *acpReportPrefix = "--acp-report=";
+    if(strncmp(arg, acpReportPrefix, strlen(acpReportPrefix)) == 0) {
+      acpReportFile = strdup(arg + strlen(acpReportPrefix));
+      return;
+    }
+
+    const char *busReportPrefix = "--bus-report=";
+    if(strncmp(arg, busReportPrefix, strlen(busReportPrefix)) == 0) {
+      busReportFile = strdup(arg + strlen(busReportPrefix));
+      return;
+    }
+
+    const char *deepProfilePrefix = "--deep-profile=";
+    if(strncmp(arg, deepProfilePrefix, strlen(deepProfilePrefix)) == 0) {
+      deepProfileFile = strdup(arg + strlen(deepProfilePrefix));
+      return;
+    }
+
+    const char *sampleReportPrefix = "--sample-profile=";
+    if(strncmp(arg, sampleReportPrefix, strlen(sampleReportPrefix)) == 0) {
+      sampleReportFile = strdup(arg + strlen(sampleReportPrefix));
+      return;
+    }
+
+    const char *coveragePrefix = "--coverage=";
+    if(strncmp(arg, coveragePrefix, strlen(coveragePrefix)) == 0) {
+      coverageFile = strdup(arg + strlen(coveragePrefix));
+      return;
+    }
+
+    const char *budgetReportPrefix = "--budget-report=";
+    if(strncmp(arg, budgetReportPrefix, strlen(budgetReportPrefix)) == 0) {
+      budgetReportFile = strdup(arg + strlen(budgetReportPrefix));
+      return;
+    }
+
+    const char *bankReportPrefix = "--bank-report=";
+    if(strncmp(arg, bankReportPrefix, strlen(bankReportPrefix)) == 0) {
+      bankReportFile = strdup(arg + strlen(bankReportPrefix));
+      return;
+    }
+
+    const char *blitTimelinePrefix = "--blit-timeline=";
+    if(strncmp(arg, blitTimelinePrefix, strlen(blitTimelinePrefix)) == 0) {
+      blitTimelineFile = strdup(arg + strlen(blitTimelinePrefix));
+      return;
+    }
+
+    const char *hardwareTracePrefix = "--hw-trace=";
+    if(strncmp(arg, hardwareTracePrefix, strlen(hardwareTracePrefix)) == 0) {
+      hardwareTraceFile = strdup(arg + strlen(hardwareTracePrefix));
+      return;
+    }
+
+    const char *hardwareTraceKindsPrefix = "--hw-trace-kinds=";
+    if(strncmp(arg, hardwareTraceKindsPrefix, strlen(hardwareTraceKindsPrefix)) == 0) {
+      hardwareTraceKinds = strdup(arg + strlen(hardwareTraceKindsPrefix));
+      return;
+    }
+
+    const char *flightRecorderPrefix = "--flight-recorder=";
+    if(strncmp(arg, flightRecorderPrefix, strlen(flightRecorderPrefix)) == 0) {
+      flightRecorderMillions = strtoul(arg + strlen(flightRecorderPrefix), NULL, 10);
+      return;
+    }
+
+    const char *flightQueryPrefix = "--flight-query=";
+    if(strncmp(arg, flightQueryPrefix, strlen(flightQueryPrefix)) == 0) {
+      flightQueryFile = strdup(arg + strlen(flightQueryPrefix));
+      return;
+    }
+
+    const char *flightFilterPrefix = "--flight-filter=";
+    if(strncmp(arg, flightFilterPrefix, strlen(flightFilterPrefix)) == 0) {
+      flightFilter = strdup(arg + strlen(flightFilterPrefix));
+      return;
+    }
+
+    const char *flightLastPrefix = "--flight-last=";
+    if(strncmp(arg, flightLastPrefix, strlen(flightLastPrefix)) == 0) {
+      flightLast = strtoull(arg + strlen(flightLastPrefix), NULL, 10);
+      return;
+    }
+
+    const char *flightHotPrefix = "--flight-hot=";
+    if(strncmp(arg, flightHotPrefix, strlen(flightHotPrefix)) == 0) {
+      flightHot = strtoul(arg + strlen(flightHotPrefix), NULL, 10);
+      return;
+    }
+
+    const char *rewindMegabytesPrefix = "--rewind-mb=";
+    if(strncmp(arg, rewindMegabytesPrefix, strlen(rewindMegabytesPrefix)) == 0) {
+      rewindMegabytes = strtoul(arg + strlen(rewindMegabytesPrefix), NULL, 10);
+      return;
+    }
+
+    const char *rewindIntervalPrefix = "--rewind-interval=";
+    if(strncmp(arg, rewindIntervalPrefix, strlen(rewindIntervalPrefix)) == 0) {
+      rewindInterval = strtoul(arg + strlen(rewindIntervalPrefix), NULL, 10);
+      if(rewindInterval == 0) {
+        rewindInterval = 1;
+      }
+      return;
+    }
+
+    const char *seedPrefix = "--seed=";
+    if(strncmp(arg, seedPrefix, strlen(seedPrefix)) == 0) {
+      seed = strtoull(arg + strlen(seedPrefix), NULL, 10);
+      fixedSeed = true;
+      return;
+    }
+
+    const char *recordPrefix = "--record=";
+    if(strncmp(arg, recordPrefix, strlen(recordPrefix)) == 0) {
+      recordFile = strdup(arg + strlen(recordPrefix));
+      return;
+    }
+
+    const char *playPrefix = "--play=";
+    if(strncmp(arg, playPrefix, strlen(playPrefix)) == 0) {
+      playFile = strdup(arg + strlen(playPrefix));
+      return;
+    }
+
+    const char *seekPrefix = "--seek=";
+    if(strncmp(arg, seekPrefix, strlen(seekPrefix)) == 0) {
+      movieSeek = strtoul(arg + strlen(seekPrefix), NULL, 10);
+      return;
+    }
 
     printf("Unrecognized option %s\n", arg);
 }
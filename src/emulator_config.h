@@ -9,4 +9,30 @@ public:
     static Uint32 defaultRendererFlags;
     static bool noSave;
     static char *xorFile;
+    static int sampleRate;
+    static char *wavFile;
+    static char *inputScript;
+    static uint32_t frameLimit;
+    static char *acpReportFile;
+    static char *busReportFile;
+    static char *deepProfileFile;
+    static char *sampleReportFile;
+    static char *coverageFile;
+    static char *budgetReportFile;
+    static char *bankReportFile;
+    static char *blitTimelineFile;
+    static char *hardwareTraceFile;
+    static char *hardwareTraceKinds;
+    static uint32_t flightRecorderMillions;
+    static char *flightQueryFile;
+    static char *flightFilter;
+    static uint64_t flightLast;
+    static uint32_t flightHot;
+    static uint32_t rewindMegabytes;
+    static uint32_t rewindInterval;
+    static uint64_t seed;
+    static bool fixedSeed;
+    static char *recordFile;
+    static char *playFile;
+    static uint32_t movieSeek;
 };
@@ -0,0 +1,335 @@
+#include "flash_store.h"
+#include "emulator_config.h"
+#include <fstream>
+#include <algorithm>
+#include <iterator>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#ifdef WASM_BUILD
+#include "emscripten.h"
+#endif
+
+#define FLASH_JOURNAL_HEADER_SIZE 16
+#define FLASH_RECORD_SIZE (8 + FLASH_BLOCK_SIZE)
+
+static uint32_t record_hash(uint32_t block, const uint8_t* data) {
+    uint32_t hash = 2166136261u ^ block;
+    for(int i = 0; i < FLASH_BLOCK_SIZE; ++i) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+FlashStore::~FlashStore() {
+#ifndef WASM_BUILD
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    if(writer.joinable()) {
+        writer.join();
+    }
+#endif
+}
+
+static bool block_is_zero(const uint8_t* data) {
+    uint64_t bits = 0;
+    for(int i = 0; i < FLASH_BLOCK_SIZE; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        bits |= word;
+    }
+    return bits == 0;
+}
+
+//Takes the freshly loaded ROM image and its unmodified original and applies
+//the saved changes on top. Only blocks the save changes are written, so the
+//rest of the image stays shared with the ROM file. Returns false if there was
+//no save to apply.
+bool FlashStore::Load(uint8_t* rom, const uint8_t* original, size_t size, const std::string& path) {
+    Flush();
+    this->rom = rom;
+    this->original = original;
+    this->size = size;
+    this->path = path;
+    //flash is a whole number of blocks, anything past the last full one isn't tracked
+    block_count = size / FLASH_BLOCK_SIZE;
+    saved.assign(block_count * FLASH_BLOCK_SIZE, 0);
+    dirty.assign((block_count + 63) / 64, 0);
+    any_dirty = false;
+    journal_records = 0;
+    //the first commit creates the journal
+    rewrite_needed = true;
+    save_blocked = false;
+
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if(!file.is_open()) {
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if((data.size() >= 4) && (memcmp(data.data(), FLASH_JOURNAL_MAGIC, 4) == 0)) {
+        if(!ReadJournal(data)) {
+            SetAside();
+            return false;
+        }
+    } else {
+        //whole-ROM XOR from older versions, converted on the next commit
+        memcpy(saved.data(), data.data(), std::min(data.size(), saved.size()));
+    }
+    for(size_t b = 0; b < block_count; ++b) {
+        const uint8_t* delta = &saved[b * FLASH_BLOCK_SIZE];
+        if(block_is_zero(delta)) {
+            continue;
+        }
+        uint8_t* target = rom + b * FLASH_BLOCK_SIZE;
+        const uint8_t* base = original + b * FLASH_BLOCK_SIZE;
+        for(int i = 0; i < FLASH_BLOCK_SIZE; ++i) {
+            target[i] = base[i] ^ delta[i];
+        }
+    }
+    return true;
+}
+
+bool FlashStore::ReadJournal(const std::vector<uint8_t>& data) {
+    uint32_t header[4];
+    if(data.size() < FLASH_JOURNAL_HEADER_SIZE) {
+        return false;
+    }
+    memcpy(header, data.data(), FLASH_JOURNAL_HEADER_SIZE);
+    if((header[1] != FLASH_JOURNAL_VERSION) || (header[2] != size) || (header[3] != FLASH_BLOCK_SIZE)) {
+        printf("Flash save %s doesn't match this ROM, ignoring it\n", path.c_str());
+        return false;
+    }
+    size_t pos = FLASH_JOURNAL_HEADER_SIZE;
+    while((pos + FLASH_RECORD_SIZE) <= data.size()) {
+        uint32_t block, hash;
+        memcpy(&block, &data[pos], 4);
+        memcpy(&hash, &data[pos + 4], 4);
+        const uint8_t* payload = &data[pos + 8];
+        if((block >= block_count) || (hash != record_hash(block, payload))) {
+            break;
+        }
+        memcpy(&saved[block * FLASH_BLOCK_SIZE], payload, FLASH_BLOCK_SIZE);
+        ++journal_records;
+        pos += FLASH_RECORD_SIZE;
+    }
+    if(pos != data.size()) {
+        //torn write at the end, drop it when the journal is next written
+        printf("Flash save %s has an incomplete record, using the data before it\n", path.c_str());
+    } else {
+        rewrite_needed = false;
+    }
+    return true;
+}
+
+//The journal is another game's or damaged. Keep it as .bak so the next save
+//doesn't destroy it, or if that can't be done don't save at all.
+void FlashStore::SetAside() {
+    std::string backup_path = path + ".bak";
+    std::error_code error;
+    if(!std::filesystem::exists(backup_path, error)) {
+        std::filesystem::rename(path, backup_path, error);
+        if(!error) {
+            printf("Moved flash save %s to %s\n", path.c_str(), backup_path.c_str());
+            return;
+        }
+    }
+    printf("Not saving flash to %s until the save there is moved out of the way\n", path.c_str());
+    save_blocked = true;
+}
+
+void FlashStore::MarkDirty(uint32_t offset, uint32_t length) {
+    if(length == 0) {
+        return;
+    }
+    size_t first = offset / FLASH_BLOCK_SIZE;
+    size_t last = (offset + length - 1) / FLASH_BLOCK_SIZE;
+    for(size_t b = first; (b <= last) && (b < block_count); ++b) {
+        dirty[b >> 6] |= (1ull << (b & 63));
+    }
+    any_dirty = true;
+}
+
+void FlashStore::Program(uint32_t offset, uint8_t value) {
+    rom[offset] &= value;
+    MarkDirty(offset, 1);
+}
+
+void FlashStore::Erase(uint32_t offset, uint32_t length) {
+    memset(rom + offset, 0xFF, length);
+    MarkDirty(offset, length);
+}
+
+//The ROM image was replaced wholesale (savestate load). The writer skips blocks that match the save.
+void FlashStore::MarkAllDirty() {
+    if(rom != NULL) {
+        MarkDirty(0, (uint32_t) size);
+    }
+}
+
+//Hand the changed blocks to the writer. Only copies them, never touches the disk.
+void FlashStore::Commit() {
+    if(!any_dirty || (rom == NULL)) {
+        return;
+    }
+    Job job;
+    for(size_t b = 0; b < block_count; ++b) {
+        if(dirty[b >> 6] & (1ull << (b & 63))) {
+            job.blocks.push_back((uint32_t) b);
+            size_t start = b * FLASH_BLOCK_SIZE;
+            size_t end = std::min(start + FLASH_BLOCK_SIZE, size);
+            job.data.insert(job.data.end(), rom + start, rom + end);
+            job.data.resize(job.blocks.size() * FLASH_BLOCK_SIZE, 0xFF);
+        }
+    }
+    std::fill(dirty.begin(), dirty.end(), 0);
+    any_dirty = false;
+    if(EmulatorConfig::noSave || save_blocked) {
+        return;
+    }
+#ifdef WASM_BUILD
+    WriteJob(job);
+#else
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push_back(std::move(job));
+        if(!writer.joinable()) {
+            writer = std::thread(&FlashStore::WriterLoop, this);
+        }
+    }
+    wake.notify_one();
+#endif
+}
+
+//Wait for queued writes to reach the disk
+void FlashStore::Flush() {
+#ifndef WASM_BUILD
+    std::unique_lock<std::mutex> guard(lock);
+    idle.wait(guard, [this] { return jobs.empty() && !busy; });
+#endif
+}
+
+#ifndef WASM_BUILD
+void FlashStore::WriterLoop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while(true) {
+        wake.wait(guard, [this] { return stopping || !jobs.empty(); });
+        if(jobs.empty()) {
+            break;
+        }
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        guard.unlock();
+        WriteJob(job);
+        guard.lock();
+        busy = false;
+        if(jobs.empty()) {
+            idle.notify_all();
+        }
+    }
+}
+#endif
+
+void FlashStore::WriteJob(const Job& job) {
+    std::vector<uint32_t> changed;
+    for(size_t k = 0; k < job.blocks.size(); ++k) {
+        uint32_t block = job.blocks[k];
+        const uint8_t* current = &job.data[k * FLASH_BLOCK_SIZE];
+        const uint8_t* base = &original[block * FLASH_BLOCK_SIZE];
+        uint8_t* stored = &saved[block * FLASH_BLOCK_SIZE];
+        bool differs = false;
+        for(int i = 0; i < FLASH_BLOCK_SIZE; ++i) {
+            uint8_t x = current[i] ^ base[i];
+            differs |= (x != stored[i]);
+            stored[i] = x;
+        }
+        if(differs) {
+            changed.push_back(block);
+        }
+    }
+    if(changed.empty() && !rewrite_needed) {
+        return;
+    }
+
+    size_t live_blocks = 0;
+    for(size_t b = 0; b < block_count; ++b) {
+        if(!block_is_zero(&saved[b * FLASH_BLOCK_SIZE])) {
+            ++live_blocks;
+        }
+    }
+    bool ok;
+    if(rewrite_needed || ((journal_records + changed.size()) > (2 * live_blocks + 64))) {
+        ok = Rewrite();
+    } else {
+        ok = AppendBlocks(changed);
+    }
+    if(ok) {
+        printf("Saved %zu flash blocks to %s\n", changed.size(), path.c_str());
+    }
+#ifdef WASM_BUILD
+    EM_ASM(
+        FS.syncfs(false, function (err) {
+            assert(!err);
+            });
+    );
+#endif
+}
+
+bool FlashStore::AppendBlocks(const std::vector<uint32_t>& blocks) {
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::app);
+    if(!file.is_open()) {
+        printf("Unable to write flash save %s\n", path.c_str());
+        return false;
+    }
+    for(uint32_t block : blocks) {
+        const uint8_t* payload = &saved[block * FLASH_BLOCK_SIZE];
+        uint32_t hash = record_hash(block, payload);
+        file.write((char*) &block, 4);
+        file.write((char*) &hash, 4);
+        file.write((char*) payload, FLASH_BLOCK_SIZE);
+    }
+    journal_records += blocks.size();
+    return file.good();
+}
+
+//Write a journal holding only the current data for each changed block, then swap it in
+bool FlashStore::Rewrite() {
+    std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!file.is_open()) {
+        printf("Unable to write flash save %s\n", temp_path.c_str());
+        return false;
+    }
+    uint32_t header[4] = {0, FLASH_JOURNAL_VERSION, (uint32_t) size, FLASH_BLOCK_SIZE};
+    memcpy(header, FLASH_JOURNAL_MAGIC, 4);
+    file.write((char*) header, FLASH_JOURNAL_HEADER_SIZE);
+    size_t records = 0;
+    for(uint32_t block = 0; block < block_count; ++block) {
+        const uint8_t* payload = &saved[block * FLASH_BLOCK_SIZE];
+        if(block_is_zero(payload)) {
+            continue;
+        }
+        uint32_t hash = record_hash(block, payload);
+        file.write((char*) &block, 4);
+        file.write((char*) &hash, 4);
+        file.write((char*) payload, FLASH_BLOCK_SIZE);
+        ++records;
+    }
+    file.close();
+    if(!file) {
+        printf("Unable to write flash save %s\n", temp_path.c_str());
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if(error) {
+        printf("Unable to replace flash save %s: %s\n", path.c_str(), error.message().c_str());
+        return false;
+    }
+    journal_records = records;
+    rewrite_needed = false;
+    return true;
+}
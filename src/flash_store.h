@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <string>
+#ifndef WASM_BUILD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#define FLASH_JOURNAL_MAGIC "GTFJ"
+#define FLASH_JOURNAL_VERSION 1
+//Granularity of change tracking. Smaller than the erase sectors so a single
+//programmed byte doesn't mean rewriting 64K.
+#define FLASH_BLOCK_SIZE 4096
+
+// Persistence for flash cartridges.
+// The changes a game makes to its flash are kept next to the ROM as a journal
+// of 4K blocks, each stored as the XOR against the original ROM file. Writes to
+// the flash mark blocks dirty and Commit (the game locking the flash) hands
+// just those blocks to a background writer, which appends them to the journal.
+// Later records for a block replace earlier ones. When superseded records pile
+// up the journal is rewritten with only the latest data and renamed into place.
+// The older format, a full size XOR of the whole ROM, is still read.
+// A journal that doesn't match the ROM is moved to .bak instead of being overwritten.
+class FlashStore {
+private:
+    struct Job {
+        std::vector<uint32_t> blocks;
+        std::vector<uint8_t> data;
+    };
+
+    uint8_t* rom = NULL;
+    size_t size = 0;
+    size_t block_count = 0;
+    //the unmodified ROM, owned by the caller
+    const uint8_t* original = NULL;
+    std::vector<uint64_t> dirty;
+    bool any_dirty = false;
+    std::string path;
+
+    //writer side: what the journal on disk adds up to
+    std::vector<uint8_t> saved;
+    size_t journal_records = 0;
+    bool rewrite_needed = false;
+    bool save_blocked = false; //an unusable save is in the way and couldn't be moved
+
+    std::deque<Job> jobs;
+#ifndef WASM_BUILD
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool busy = false;
+    bool stopping = false;
+    void WriterLoop();
+#endif
+
+    void MarkDirty(uint32_t offset, uint32_t length);
+    bool ReadJournal(const std::vector<uint8_t>& file);
+    void SetAside();
+    void WriteJob(const Job& job);
+    bool AppendBlocks(const std::vector<uint32_t>& blocks);
+    bool Rewrite();
+public:
+    ~FlashStore();
+    bool Load(uint8_t* rom, const uint8_t* original, size_t size, const std::string& path);
+    void Program(uint32_t offset, uint8_t value);
+    void Erase(uint32_t offset, uint32_t length);
+    void MarkAllDirty();
+    void Commit();
+    void Flush();
+};
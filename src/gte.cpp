@@ -10,6 +10,7 @@
 #include <vector>
 #include <thread>
 #include <algorithm>
+#include <chrono>
 #ifdef WASM_BUILD
 #include "emscripten.h"
 #include <emscripten/html5.h>
@@ -26,6 +27,14 @@
 #include "system_state.h"
 #include "emulator_config.h"
 #include "game_config.h"
+#include "input_script.h"
+#include "savestate.h"
+#include "rewind_buffer.h"
+#include "movie.h"
+#include "flash_store.h"
+#include "rom_image.h"
+#include "nvram_store.h"
+#include "rng.h"
 
 #include "mos6502/mos6502.h"
 
@@ -35,6 +44,15 @@
 
 #include "ui/ui_utils.h"
 #include "devtools/profiler.h"
+#include "devtools/bus_monitor.h"
+#include "devtools/pc_sampler.h"
+#include "devtools/exec_coverage.h"
+#include "devtools/memory_heatmap.h"
+#include "devtools/budget_monitor.h"
+#include "devtools/bank_profiler.h"
+#include "devtools/blit_timeline.h"
+#include "devtools/hardware_trace.h"
+#include "devtools/flight_recorder.h"
 #include "devtools/disassembler.h"
 
 #ifndef WASM_BUILD
@@ -68,6 +86,7 @@ AudioCoprocessor *soundcard;
 JoystickAdapter *joysticks;
 SystemState system_state;
 CartridgeState cartridge_state;
+Rng rng;
 
 const int SCREEN_WIDTH = 683;	
 const int SCREEN_HEIGHT = 512;
@@ -78,9 +97,12 @@ GameConfig* gameconfig;
 std::string currentRomFilePath;
 std::string nvramFileFullPath;
 std::string flashFileFullPath;
+std::string savestateFileFullPath;
+
+void SaveState(std::vector<uint8_t>& out);
+bool LoadState(const uint8_t* data, size_t size);
+Movie movie(SaveState, LoadState);
 
-bool vsyncProfileArmed = false;
-bool vsyncProfileRunning = false;
 
 bool showMenu = false;
 bool menuOpening = false;
@@ -89,78 +111,9 @@ int resetQueued = 0;
 #define MUTE_SOURCE_MENU 2
 int muteMask = 0;
 
-void SaveNVRAM() {
-	fstream file;
-	if(loadedRomType != RomType::FLASH2M_RAM32K) return;
-	printf("SAVING %s\n", nvramFileFullPath.c_str());
-	file.open(nvramFileFullPath.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
-	file.write((char*) cartridge_state.save_ram, CARTRAMSIZE);
-	file.close();
-}
-
-void LoadNVRAM() {
-	fstream file;
-	if(loadedRomType != RomType::FLASH2M_RAM32K) return;
-	printf("LOADING %s\n", nvramFileFullPath.c_str());
-	file.open(nvramFileFullPath.c_str(), ios_base::in | ios_base::binary);
-	file.read((char*) cartridge_state.save_ram, CARTRAMSIZE);
-	file.close();
-}
-
-std::thread savingThread;
-
-void SaveModifiedFlash() {
-	if(EmulatorConfig::noSave) return;
-	fstream file_out, file_in;
-	uint8_t* rom_cursor = cartridge_state.rom;
-	uint8_t buf[256];
-	file_in.open(currentRomFilePath, ios_base::in | ios_base::binary);
-	file_out.open(flashFileFullPath.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
-	while(file_in) {
-		file_in.read((char*) buf, 256);
-		size_t bytesRead = file_in.gcount();
-		if(bytesRead) {
-			for(int i = 0; i < bytesRead; ++i) {
-				buf[i] ^= *(rom_cursor++);
-			}
-			file_out.write((char*) buf, bytesRead);
-		}
-	}
-	file_in.close();
-	file_out.close();
-#ifdef WASM_BUILD
-	EM_ASM(
-		FS.syncfs(false, function (err) {
-			assert(!err);
-			});
-	);
-#endif
-}
-
-fstream orig_rom, xor_file;
-void LoadModifiedFlash() {
-	uint8_t* rom_cursor = cartridge_state.rom;
-	uint8_t buf[256];
-	uint8_t bufx[256];
-	size_t bytes_read = 0;
-	std::cout << "opening " << currentRomFilePath << " and " << flashFileFullPath << "\n";
-	orig_rom.open(currentRomFilePath, ios_base::in | ios_base::binary);
-	xor_file.open(flashFileFullPath, ios_base::in | ios_base::binary);
-	std::cout << "XORing files together... \n";
-	while(orig_rom && xor_file) {
-		orig_rom.read((char*) buf, 256);
-		xor_file.read((char*) bufx, 256); 
-		for(int i = 0; i < orig_rom.gcount(); ++i) {
-			*(rom_cursor++) = buf[i] ^ bufx[i];
-		}
-		bytes_read += 256;
-	}
-	std::cout << bytes_read << " bytes read from xor file\n";
-#ifndef WASM_BUILD
-	orig_rom.close();
-	xor_file.close();
-#endif
-}
+RomImage rom_image;
+NVRAMStore nvram_store;
+FlashStore flash_store;
 
 const uint8_t VIA_ORB    = 0x0;
 const uint8_t VIA_ORA    = 0x1;
@@ -217,14 +170,58 @@ bool profiler_open = false;
 bool buffers_open = false;
 int profiler_x_axis = 0;
 
-uint8_t open_bus() {
-	return rand() % 256;
+BusMonitor bus_monitor;
+PCSampler pc_sampler;
+ExecCoverage exec_coverage;
+MemoryHeatmap memory_heatmap;
+BudgetMonitor budget_monitor(loadedMemoryMap);
+BankProfiler bank_profiler;
+BlitTimeline blit_timeline(timekeeper);
+HardwareTrace hardware_trace(timekeeper);
+FlightRecorder flight_recorder(timekeeper);
+//address of the instruction being executed, for diagnostics
+uint16_t instruction_pc = 0;
+
+//Keeps the CPU's execution counters on the RAM and flash banks switched in
+void attach_exec_coverage() {
+	exec_coverage.Attach(cpu_core, (system_state.banking & BANK_RAM_MASK) >> 6, cartridge_state.bank_mask);
+}
+
+//Only flash carts have a bank register
+bool romIsBanked() {
+	return (loadedRomType == RomType::FLASH2M) || (loadedRomType == RomType::FLASH2M_RAM32K);
+}
+
+//Bank for symbol lookups of code in the cartridge window
+int symbol_bank() {
+	return romIsBanked() ? cartridge_state.bank_mask : SYMBOL_ANY_BANK;
+}
+
+//Writes and interrupts for the hardware trace, stamped with the current instruction
+void trace_hardware(HardwareEventKind kind, uint16_t address, uint8_t old_value, uint8_t value) {
+	if(hardware_trace.enabled) {
+		hardware_trace.Record(kind, instruction_pc, symbol_bank(), address, old_value, value);
+	}
+}
+
+void record_bus_read(BusReadKind kind, uint32_t address) {
+	uint8_t bank = romIsBanked() ? (uint8_t) cartridge_state.bank_mask : 0;
+	bus_monitor.Record(kind, instruction_pc, bank, address, timekeeper.totalCyclesCount);
+}
+
+//Debugger reads peek at the next value so they don't disturb emulation
+uint8_t open_bus(bool stateful) {
+	return stateful ? rng.NextByte() : rng.PeekByte();
 }
 
-uint8_t VDMA_Read(uint16_t address) {
+uint8_t VDMA_Read(uint16_t address, bool stateful) {
 	blitter->CatchUp();
 	if(system_state.dma_control & DMA_COPY_ENABLE_BIT) {
-		return open_bus();
+		//blitter parameters are write-only
+		if(stateful && bus_monitor.enabled) {
+			record_bus_read(BUS_OPEN_BUS, address);
+		}
+		return open_bus(stateful);
 	} else {
 		uint8_t* bufPtr;
 		uint32_t offset = 0;
@@ -237,6 +234,9 @@ uint8_t VDMA_Read(uint16_t address) {
 			bufPtr = system_state.gram;
 			offset = (((system_state.banking & BANK_GRAM_MASK) << 2) | (blitter->gram_mid_bits)) << 14;
 		}
+		if(stateful && memory_heatmap.enabled) {
+			memory_heatmap.Read((bufPtr == system_state.vram) ? HEAT_VRAM : HEAT_GRAM, (address & 0x3FFF) | offset);
+		}
 		return bufPtr[(address & 0x3FFF) | offset];
 	}
 }
@@ -244,6 +244,9 @@ uint8_t VDMA_Read(uint16_t address) {
 void VDMA_Write(uint16_t address, uint8_t value) {
 	blitter->CatchUp();
 	if(system_state.dma_control & DMA_COPY_ENABLE_BIT) {
+		if((address % DMA_PARAMS_COUNT) == Blitter::PARAM_TRIGGER) {
+			trace_hardware(HW_BLIT, address, 0, value);
+		}
 		blitter->SetParam(address, value);
 	} else {
 		uint8_t* bufPtr;
@@ -264,6 +267,9 @@ void VDMA_Write(uint16_t address, uint8_t value) {
 			offset = (((system_state.banking & BANK_GRAM_MASK) << 2) | (blitter->gram_mid_bits)) << 14;
 		}
 		bufPtr[(address & 0x3FFF) | offset] = value;
+		if(memory_heatmap.enabled) {
+			memory_heatmap.Write((bufPtr == system_state.vram) ? HEAT_VRAM : HEAT_GRAM, (address & 0x3FFF) | offset);
+		}
 
 		uint8_t x, y;
 		x = address & 127;
@@ -277,6 +283,9 @@ void UpdateFlashShiftRegister(uint8_t nextVal) {
 	//For now assuming that if we're using Flash2M hardware we're behaving ourselves
 	uint8_t oldVal = system_state.VIA_regs[VIA_ORA];
 	uint8_t risingBits = nextVal & ~oldVal;
+	if(bank_profiler.enabled) {
+		bank_profiler.ShiftWrite(instruction_pc, symbol_bank(), timekeeper.totalCyclesCount);
+	}
 	if(risingBits & VIA_SPI_BIT_CLK) {
 		cartridge_state.bank_shifter = cartridge_state.bank_shifter << 1;
 		cartridge_state.bank_shifter &= 0xFE;
@@ -284,22 +293,31 @@ void UpdateFlashShiftRegister(uint8_t nextVal) {
 	} else if(risingBits & VIA_SPI_BIT_CS) {
 		//flash cart CS is connected to latch clock
 		if((cartridge_state.bank_mask ^ cartridge_state.bank_shifter) & 0x80) {
-			SaveNVRAM();
+			nvram_store.RequestSave();
 		}
+		uint8_t oldBank = cartridge_state.bank_mask;
 		cartridge_state.bank_mask = cartridge_state.bank_shifter;
 		if(loadedRomType != RomType::FLASH2M_RAM32K) {
 			cartridge_state.bank_mask |= 0x80;
 		}
+		if(bank_profiler.enabled) {
+			bank_profiler.Latch(oldBank, cartridge_state.bank_mask, timekeeper.totalCyclesCount);
+		}
+		attach_exec_coverage();
 		//printf("Flash highbits set to %x\n", cartridge_state.bank_mask);
 	}
 }
 
-uint8_t MemoryRead_Flash2M(uint16_t address) {
+uint8_t MemoryRead_Flash2M(uint16_t address, bool stateful) {
 	if(address & 0x4000) {
 		return cartridge_state.rom[0b111111100000000000000 | (address & 0x3FFF)];
 	} else {
-		if(!(cartridge_state.bank_mask & 0x80))
+		if(!(cartridge_state.bank_mask & 0x80)) {
+			if(stateful && memory_heatmap.enabled) {
+				memory_heatmap.Read(HEAT_SAVE_RAM, (address & 0x3FFF) | ((cartridge_state.bank_mask & 0x40) << 8));
+			}
 			return cartridge_state.save_ram[(address & 0x3FFF) | ((cartridge_state.bank_mask & 0x40) << 8)];
+		}
 		else return cartridge_state.rom[((cartridge_state.bank_mask & 0x7F) << 14) | (address & 0x3FFF)];
 	}
 }
@@ -328,30 +346,34 @@ uint8_t MemoryReadResolve(const uint16_t address, bool stateful) {
 			return cartridge_state.rom[address & 0x7FFF];
 			case RomType::FLASH2M:
 			case RomType::FLASH2M_RAM32K:
-			return MemoryRead_Flash2M(address);
+			return MemoryRead_Flash2M(address, stateful);
 			case RomType::UNKNOWN:
 			return MemoryRead_Unknown(address);
 		}
 	} else if(address & 0x4000) {
-		return VDMA_Read(address);
+		return VDMA_Read(address, stateful);
 	} else if((address >= 0x3000) && (address <= 0x3FFF)) {
 		return soundcard->ram_read(address);
 	} else if((address >= 0x2800) && (address <= 0x2FFF)) {
 		return system_state.VIA_regs[address & 0xF];
 	} else if(address < 0x2000) {
-		if(stateful) {
-			if(!system_state.ram_initialized[FULL_RAM_ADDRESS(address & 0x1FFF)]) {
-				//printf("WARNING! Uninitialized RAM read at %x (Bank %x)\n", address, system_state.banking >> 5);
-			}
+		if(stateful && bus_monitor.enabled && !system_state.RamInitialized(FULL_RAM_ADDRESS(address & 0x1FFF))) {
+			record_bus_read(BUS_UNINITIALIZED_RAM, FULL_RAM_ADDRESS(address & 0x1FFF));
+		}
+		if(stateful && memory_heatmap.enabled) {
+			memory_heatmap.Read(HEAT_RAM, FULL_RAM_ADDRESS(address & 0x1FFF));
 		}
 		return *GetRAM(address);
 	} else if((address == 0x2008) || (address == 0x2009)) {
+		if(stateful) {
+			movie.PortRead((uint8_t) address, timekeeper.totalCyclesCount);
+		}
 		return joysticks->read((uint8_t) address, stateful);
 	}
-	if(stateful) {
-		printf("Attempted to read write-only device, may be unintended? %x\n", address);
+	if(stateful && bus_monitor.enabled) {
+		record_bus_read(BUS_OPEN_BUS, address);
 	}
-	return open_bus();
+	return open_bus(stateful);
 }
 
 uint8_t MemoryRead(uint16_t address) {
@@ -359,21 +381,41 @@ uint8_t MemoryRead(uint16_t address) {
 }
 
 uint8_t MemorySync(uint16_t address) {
+	instruction_pc = address;
 	if(timekeeper.clock_mode == CLOCKMODE_NORMAL) {
 		if(Breakpoints::checkBreakpoint(address, cartridge_state.bank_mask)) {
 			timekeeper.clock_mode = CLOCKMODE_STOPPED;
-			Disassembler::Decode(MemoryReadResolve, loadedMemoryMap, address, 32);
+			Disassembler::Decode(MemoryReadResolve, loadedMemoryMap, address, 32, cartridge_state.bank_mask);
 			cpu_core->Freeze();
 		}
 		uint8_t opcode = MemoryReadResolve(address, false);
 		if(opcode == 0x20) { //JSR
 			uint16_t jsr_dest = MemoryReadResolve(address+1, false) | (MemoryReadResolve(address+2, false) << 8);
 			profiler.LogJSR(address, cartridge_state.bank_mask, jsr_dest);
+			if(budget_monitor.active) {
+				budget_monitor.Call(address, symbol_bank(), jsr_dest, false);
+			}
+			if(bank_profiler.enabled) {
+				bank_profiler.Call(address, symbol_bank(), jsr_dest, symbol_bank());
+			}
 		} else if(opcode == 0x60) { //RTS
 			profiler.LogRTS(address, cartridge_state.bank_mask);
+			if(budget_monitor.active) {
+				budget_monitor.Return(false);
+			}
+			if(bank_profiler.enabled) {
+				bank_profiler.Return();
+			}
+		}
+		if(blit_timeline.enabled) {
+			blit_timeline.Fetch(opcode == 0xCB);
 		}
 	}
-	return MemoryRead(address);
+	uint8_t fetched = MemoryRead(address);
+	if(flight_recorder.enabled) {
+		flight_recorder.Record(address, cartridge_state.bank_mask, fetched, cpu_core->A, cpu_core->X, cpu_core->Y, cpu_core->sp, cpu_core->status);
+	}
+	return fetched;
 }
 
 void MemoryWrite(uint16_t address, uint8_t value) {
@@ -382,75 +424,50 @@ void MemoryWrite(uint16_t address, uint8_t value) {
 			if(!(address & 0x4000)) {
 				if(!(cartridge_state.bank_mask & 0x80)) {
 					cartridge_state.save_ram[(address & 0x3FFF) | ((cartridge_state.bank_mask & 0x40) << 8)] = value;
+					nvram_store.MarkDirty();
+					if(memory_heatmap.enabled) {
+						memory_heatmap.Write(HEAT_SAVE_RAM, (address & 0x3FFF) | ((cartridge_state.bank_mask & 0x40) << 8));
+					}
 				}
 			}
 		}
 		if(loadedRomType == RomType::FLASH2M) {
 			if(cartridge_state.write_mode) {
-				uint8_t* location;
+				uint32_t location;
 				if(address & 0x4000) {
-					location = &(cartridge_state.rom[0b111111100000000000000 | (address & 0x3FFF)]);
+					location = 0b111111100000000000000 | (address & 0x3FFF);
 				} else {
-					location = &(cartridge_state.rom[((cartridge_state.bank_mask & 0x7F) << 14) | (address & 0x3FFF)]);
+					location = ((cartridge_state.bank_mask & 0x7F) << 14) | (address & 0x3FFF);
 				}
-				*location &= value;
+				flash_store.Program(location, value);
 				cartridge_state.write_mode = false;
 			} else {
 				//Skipping over details like bypass and unlock commands for now
 				//So off-spec flash operation will be inaccurate
 				if(value == 0x10) {
 					//Chip Erase
-					for(int i = 0; i < (1 << 21); ++i) {
-						cartridge_state.rom[i] = 0xFF;
-					}
+					flash_store.Erase(0, 1 << 21);
 				} else if (value == 0x30) {
 					//Sector erase
 					uint8_t sectorBits = ((address & (1 << 13)) >> 13) | ((cartridge_state.bank_mask & 0x7F) << 1);
 					uint8_t sectorNum = sectorBits >> 3;
 					if(sectorNum < 31) {
 						//most of the sector table
-						uint32_t x = sectorNum << 16;
-						for(uint32_t i = 0; i < (1 << 16); ++i) {
-							cartridge_state.rom[x] = 0xFF;
-							++x;
-						}
+						flash_store.Erase(sectorNum << 16, 1 << 16);
 					} else if((sectorBits & 4) == 0) {
-						uint32_t x = 0x1F0000;
-						for(uint32_t i = 0; i < (1 << 15); ++i) {
-							cartridge_state.rom[x] = 0xFF;
-							++x;
-						}
+						flash_store.Erase(0x1F0000, 1 << 15);
 					} else if(sectorBits == 0b11111100) {
-						uint32_t x = 0x1F8000;
-						for(uint32_t i = 0; i < (1 << 13); ++i) {
-							cartridge_state.rom[x] = 0xFF;
-							++x;
-						}
+						flash_store.Erase(0x1F8000, 1 << 13);
 					} else if(sectorBits == 0b11111101) {
-						uint32_t x = 0x1FA000;
-						for(uint32_t i = 0; i < (1 << 13); ++i) {
-							cartridge_state.rom[x] = 0xFF;
-							++x;
-						}
+						flash_store.Erase(0x1FA000, 1 << 13);
 					} else if((sectorBits >> 1) == 0b1111111) {
-						uint32_t x = 0x1FC000;
-						for(uint32_t i = 0; i < (1 << 14); ++i) {
-							cartridge_state.rom[x] = 0xFF;
-							++x;
-						}
+						flash_store.Erase(0x1FC000, 1 << 14);
 					}
 				} else if(value == 0xA0) {
 					cartridge_state.write_mode = true;
 				} else if(value == 0x90) {
 					//first byte of lock command should be a good time to write to file
-#ifdef WASM_BUILD
-					SaveModifiedFlash();
-#else
-					if(savingThread.joinable()) {
-						savingThread.join();
-					}
-					savingThread = std::thread(SaveModifiedFlash);
-#endif
+					flash_store.Commit();
 				}
 			}
 		}
@@ -467,22 +484,30 @@ void MemoryWrite(uint16_t address, uint8_t value) {
 				}
 			}
 			if((address & 0xF) == VIA_ORB) {
-				if((system_state.VIA_regs[VIA_ORB] & 0x80) && !(value & 0x80)) {
+				bool budgetDeclared = budget_monitor.PortWrite(system_state.VIA_regs[VIA_ORB], value);
+				if(!budgetDeclared && (system_state.VIA_regs[VIA_ORB] & 0x80) && !(value & 0x80)) {
 					//falling edge of high bit of ORB
 					if(value & 0x40) {
 						//report duration
-						profiler.LogTime(value & 0x3F);
+						uint64_t duration = profiler.LogTime(value & 0x3F);
+						budget_monitor.Stop(value & 0x3F, duration, instruction_pc, symbol_bank());
 					} else {
 						//store timestamp
 						profiler.profilingTimeStamps[value & 0x3F] = timekeeper.totalCyclesCount;
+						budget_monitor.Start(value & 0x3F, instruction_pc, symbol_bank());
 					}
 				}
 			}
+			if(((address & 0xF) == VIA_ORA) || ((address & 0xF) == VIA_ORB)) {
+				trace_hardware(((address & 0xF) == VIA_ORA) ? HW_VIA_ORA : HW_VIA_ORB, address, system_state.VIA_regs[address & 0xF], value);
+			}
 			system_state.VIA_regs[address & 0xF] = value;
 		} else {
 			if((address & 0x000F) == 0x0007) {
 				blitter->CatchUp();
+				trace_hardware(HW_DMA_CONTROL, address, system_state.dma_control, value);
 				if((value & DMA_VID_OUT_PAGE_BIT) != (system_state.dma_control & DMA_VID_OUT_PAGE_BIT)) {
+					trace_hardware(HW_BUFFER_FLIP, address, system_state.dma_control, value);
 					profiler.bufferFlipCount++;
 					if(profiler.measure_by_frameflip) {
 						profiler.ResetTimers();
@@ -499,58 +524,87 @@ void MemoryWrite(uint16_t address, uint8_t value) {
 				}
 			} else if((address & 0x000F) == 0x0005) {
 				blitter->CatchUp();
+				trace_hardware(HW_BANKING, address, system_state.banking, value);
 				system_state.banking = value;
+				attach_exec_coverage();
 				//printf("banking reg set to %x\n", value);
 			} else {
+				trace_hardware(HW_ACP_REGISTER, address, 0, value);
 				soundcard->register_write(address, value);
 			}
 		}
 	}
 	else if(address < 0x2000) {
-		/*if(!system_state.ram_initialized[FULL_RAM_ADDRESS(address & 0x1FFF)]) {
+		/*if(!system_state.RamInitialized(FULL_RAM_ADDRESS(address & 0x1FFF))) {
 			printf("First RAM write at %x (Bank %x) (Value %x)\n", address, system_state.banking >> 6, value);
 		}*/
-		system_state.ram_initialized[FULL_RAM_ADDRESS(address & 0x1FFF)] = true;
+		system_state.MarkRamInitialized(FULL_RAM_ADDRESS(address & 0x1FFF));
 		system_state.ram[FULL_RAM_ADDRESS(address & 0x1FFF)] = value;
+		if(memory_heatmap.enabled) {
+			memory_heatmap.Write(HEAT_RAM, FULL_RAM_ADDRESS(address & 0x1FFF));
+		}
 	}
 }
 
 SDL_Event e;
 bool running = true;
 bool gofast = false;
+bool rewinding = false;
+RewindBuffer* rewindBuffer = NULL;
 bool paused = false;
 bool lshift = false;
 bool rshift = false;
 
 void randomize_vram() {
 	for(int i = 0; i < VRAM_BUFFER_SIZE; i ++) {
-		system_state.vram[i] = rand() % 256;
+		system_state.vram[i] = rng.NextByte();
 		put_pixel32(vRAM_Surface, i & 127, i >> 7, Palette::ConvertColor(vRAM_Surface, system_state.vram[i]));
 	}
 	for(int i = 0; i < GRAM_BUFFER_SIZE; i ++) {
-		system_state.gram[i] = rand() % 256;
+		system_state.gram[i] = rng.NextByte();
 		put_pixel32(gRAM_Surface, i & 127, i >> 7, Palette::ConvertColor(gRAM_Surface, system_state.gram[i]));
 	}
 }
 
 void randomize_memory() {
 	for(int i = 0; i < RAMSIZE; i++) {
-		system_state.ram[i] = rand() % 256;
-		system_state.ram_initialized[i] = false;
+		system_state.ram[i] = rng.NextByte();
 	}
+	system_state.ClearRamInitialized();
 
 	for(int i = 0; i < VRAM_BUFFER_SIZE; i++) {
-		system_state.vram[i] = rand() % 256;	
+		system_state.vram[i] = rng.NextByte();	
 	}
 
 	for(int i = 0; i < GRAM_BUFFER_SIZE; i++) {
-		system_state.gram[i] = rand() % 256;	
+		system_state.gram[i] = rng.NextByte();	
 	}
 	
-	system_state.dma_control = rand() % 256;
+	system_state.dma_control = rng.NextByte();
 	system_state.dma_control_irq = (system_state.dma_control & DMA_COPY_IRQ_BIT) != 0;
-	system_state.banking = rand() % 256;
-	blitter->gram_mid_bits = rand() % 4;
+	system_state.banking = rng.NextByte();
+	blitter->gram_mid_bits = rng.NextByte() % 4;
+}
+
+//Soft reset only restarts the CPU, hard reset also scrambles memory like a cold boot
+void resetSystem(bool hard) {
+	if(hard) {
+		randomize_memory();
+		randomize_vram();
+	}
+	cpu_core->Reset();
+	cartridge_state.write_mode = false;
+	joysticks->Reset();
+	budget_monitor.CPUReset();
+}
+
+//Ends recording or playback, writing out the recording if there was one
+void stopMovie() {
+	if(movie.Recording() && (EmulatorConfig::recordFile != NULL)) {
+		movie.Save(EmulatorConfig::recordFile);
+	}
+	movie.Stop();
+	joysticks->OverrideButtons(false);
 }
 
 extern "C" {
@@ -569,6 +623,7 @@ void ResumeEmulation() {
 
 void CPUStopped() {
 	paused = true;
+	flight_recorder.Trigger("stp");
 	printf("CPU stopped");
 #ifdef TINYFILEDIALOGS_H
 	tinyfd_notifyPopup("Alert",
@@ -577,6 +632,38 @@ void CPUStopped() {
 #endif
 }
 
+//Interrupt hooks for the deep profiler. instruction_pc is still the last
+//opcode fetched, the instruction the interrupt arrived after.
+void CPUTookIRQ() {
+	profiler.LogIRQ(instruction_pc, cartridge_state.bank_mask, cpu_core->pc);
+	if(budget_monitor.active) {
+		budget_monitor.Call(instruction_pc, symbol_bank(), cpu_core->pc, true);
+	}
+}
+
+void CPUTookNMI() {
+	profiler.LogNMI(instruction_pc, cartridge_state.bank_mask, cpu_core->pc);
+	if(budget_monitor.active) {
+		budget_monitor.Call(instruction_pc, symbol_bank(), cpu_core->pc, true);
+	}
+}
+
+//The blitter's IRQ fired, value 1 if the CPU will take it now
+void CPURaisedIRQ() {
+	trace_hardware(HW_BLIT_IRQ, 0xFFFE, 0, !(cpu_core->status & INTERRUPT));
+}
+
+void CPUReturnedFromInterrupt() {
+	profiler.LogRTI(instruction_pc, cartridge_state.bank_mask);
+	if(budget_monitor.active) {
+		budget_monitor.Return(true);
+	}
+}
+
+void CPUSampled(uint16_t address, uint32_t samples) {
+	pc_sampler.Record(address, symbol_bank(), 0xFF - cpu_core->sp, samples);
+}
+
 const char * open_rom_dialog() {
 	char const * lFilterPatterns[1] = {"*.gtr"};
 #ifdef TINYFILEDIALOGS_H
@@ -597,6 +684,8 @@ extern "C" {
 	// 0 on success
 	// -1 on failure (e.g. file by name doesn't exist)
 	int LoadRomFile(const char* filename) {
+		//the previous cartridge's RAM goes to its own file before anything changes
+		nvram_store.Close();
 		std::filesystem::path filepath(filename);
 		currentRomFilePath = filepath.string();
 #ifdef WASM_BUILD
@@ -613,6 +702,8 @@ extern "C" {
 		    nvramPath.replace_extension("xor");
 		    flashFileFullPath = nvramPath.string();
 		}
+		nvramPath.replace_extension("gts");
+		savestateFileFullPath = nvramPath.string();
 		nvramPath.replace_extension("gtrcfg");
 
 		gameconfig = new GameConfig(nvramPath.string().c_str());
@@ -633,22 +724,21 @@ extern "C" {
 			printf("found default source map file location %s\n", defaultSourceMapFilePath.c_str());
 			std::string sourceMapPathString = defaultSourceMapFilePath.string();
 			SourceMap::singleton = new SourceMap(sourceMapPathString);
+			loadedMemoryMap->AssignBanks(SourceMap::singleton->GetSymbolBanks());
 		} else {
 			printf("default source map file %s not found\n", defaultSourceMapFilePath.c_str());
 		}
 
 		printf("loading %s\n", filename);
-		FILE* romFileP = fopen(filename, "rb");
-		if(!romFileP) {
+		//the flash writer reads the current original until it's done
+		flash_store.Flush();
+		if(!rom_image.Open(filename)) {
 			printf("Unable to open file: %s\n", filename);
 			return -1;
 		}
-
-		fseek(romFileP, 0L, SEEK_END);
-		cartridge_state.size = ftell(romFileP);
-		//cartridge_state.rom = new uint8_t [cartridge_state.size];
+		cartridge_state.rom = rom_image.Data();
+		cartridge_state.size = rom_image.Size();
 		cartridge_state.write_mode = false;
-		rewind(romFileP);
 		switch(cartridge_state.size) {
 			case 8192:
 			loadedRomType = RomType::EEPROM8K;
@@ -667,19 +757,31 @@ extern "C" {
 			printf("Unknown ROM type: Size is %d bytes\n", cartridge_state.size);
 			break;
 		}
-		fread(cartridge_state.rom, sizeof(uint8_t), cartridge_state.size, romFileP);
-		fclose(romFileP);
+		switch(loadedRomType) {
+			case RomType::EEPROM8K:
+			exec_coverage.Configure(0x2000, false);
+			break;
+			case RomType::FLASH2M:
+			exec_coverage.Configure(1 << 21, true);
+			break;
+			default:
+			exec_coverage.Configure(0x8000, false);
+			break;
+		}
 		if(cpu_core) {
+			stopMovie();
 			paused = false;
 			cpu_core->Reset();
 			cartridge_state.write_mode = false;
 		}
+		if(rewindBuffer) {
+			rewindBuffer->Clear();
+		}
 
 		if(loadedRomType == RomType::FLASH2M) {
 
-			if(std::filesystem::exists(flashFileFullPath.c_str())) {
-				std::cout << "Loading flash save from " << flashFileFullPath << "\n";
-				LoadModifiedFlash();
+			if(flash_store.Load(cartridge_state.rom, rom_image.Original(), cartridge_state.size, flashFileFullPath)) {
+				std::cout << "Loaded flash save from " << flashFileFullPath << "\n";
 			} else {
 				std::cout << "Couldn't find " << flashFileFullPath << "\n";
 			}
@@ -690,9 +792,7 @@ extern "C" {
 				(cartridge_state.rom[0x1FFFF2] == 'V') &&
 				(cartridge_state.rom[0x1FFFF3] == 'E')) {
 					loadedRomType = RomType::FLASH2M_RAM32K;
-					if(std::filesystem::exists(nvramFileFullPath.c_str())) {
-						LoadNVRAM();
-					}
+					nvram_store.Load(cartridge_state.save_ram, CARTRAMSIZE, nvramFileFullPath);
 				}
 		}
 		return 0;
@@ -742,7 +842,7 @@ bool toolTypeIsOpen() {
 
 void toggleProfilerWindow() {
 	if(!toolTypeIsOpen<ProfilerWindow>()) {
-		toolWindows.push_back(new ProfilerWindow(profiler));
+		toolWindows.push_back(new ProfilerWindow(profiler, pc_sampler, budget_monitor, bank_profiler, blit_timeline, hardware_trace, loadedMemoryMap));
 	} else {
 		closeToolByType<ProfilerWindow>();
 	}
@@ -750,7 +850,7 @@ void toggleProfilerWindow() {
 
 void toggleMemBrowserWindow() {
 	if(!toolTypeIsOpen<MemBrowserWindow>()) {
-		toolWindows.push_back(new MemBrowserWindow(loadedMemoryMap, MemoryReadResolve, GetRAM, *gameconfig));
+		toolWindows.push_back(new MemBrowserWindow(loadedMemoryMap, MemoryReadResolve, GetRAM, *gameconfig, bus_monitor, memory_heatmap));
 	} else {
 		closeToolByType<MemBrowserWindow>();
 	}
@@ -759,7 +859,7 @@ void toggleMemBrowserWindow() {
 void toggleVRAMWindow() {
 	if(!toolTypeIsOpen<VRAMWindow>()) {
 		toolWindows.push_back(new VRAMWindow(vRAM_Surface, gRAM_Surface,
-			&system_state, cpu_core, &cartridge_state));
+			&system_state, cpu_core, &cartridge_state, &memory_heatmap));
 	} else {
 		closeToolByType<VRAMWindow>();
 	}
@@ -767,7 +867,7 @@ void toggleVRAMWindow() {
 
 void toggleSteppingWindow() {
 	if(!toolTypeIsOpen<SteppingWindow>()) {
-		toolWindows.push_back(new SteppingWindow(timekeeper, loadedMemoryMap, cpu_core, *gameconfig, cartridge_state));
+		toolWindows.push_back(new SteppingWindow(timekeeper, loadedMemoryMap, cpu_core, *gameconfig, cartridge_state, system_state, exec_coverage));
 	} else {
 		closeToolByType<SteppingWindow>();
 	}
@@ -781,6 +881,14 @@ void togglePatchingWindow() {
 	}
 }
 
+void toggleDeepProfileRecording() {
+	if(profiler.DeepProfileRecording()) {
+		profiler.DeepProfileStop(loadedMemoryMap, SourceMap::singleton);
+	} else {
+		profiler.DeepProfileStart();
+	}
+}
+
 void doRamDump() {
 	soundcard->dump_ram("audio_debug.dat");
 	ofstream dumpfile ("ram_debug.dat", ios::out | ios::binary);
@@ -798,6 +906,255 @@ void toggleControllerOptionsWindow() {
 
 #endif
 
+//Rebuild the display surfaces for the frames of vram/gram a state load replaced
+void redraw_vram_surfaces() {
+	Uint32 vram_colors[256], gram_colors[256];
+	for(int i = 0; i < 256; ++i) {
+		vram_colors[i] = Palette::ConvertColor(vRAM_Surface, i);
+		gram_colors[i] = Palette::ConvertColor(gRAM_Surface, i);
+	}
+	for(int frame = 0; frame < VIDEO_FRAME_COUNT; ++frame) {
+		if(!(system_state.video_dirty & (1ull << frame))) {
+			continue;
+		}
+		int offset = frame * FRAME_BUFFER_SIZE;
+		const uint8_t* source = system_state.vram + offset;
+		const Uint32* colors = vram_colors;
+		Uint32* pixels = (Uint32*) vRAM_Surface->pixels + offset;
+		if(offset >= VRAM_BUFFER_SIZE) {
+			colors = gram_colors;
+			pixels = (Uint32*) gRAM_Surface->pixels + (offset - VRAM_BUFFER_SIZE);
+		}
+		for(int i = 0; i < FRAME_BUFFER_SIZE; ++i) {
+			pixels[i] = colors[source[i]];
+		}
+	}
+	system_state.video_dirty = 0;
+}
+
+//Flash carts can rewrite themselves so the whole ROM goes into the state,
+//other types are only fingerprinted to catch loading a state into the wrong game
+uint64_t romFingerprint() {
+	uint64_t hash = 14695981039346656037ULL;
+	if(romIsBanked()) return hash;
+	for(int i = 0; i < cartridge_state.size; ++i) {
+		hash = (hash ^ cartridge_state.rom[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+void SaveState(std::vector<uint8_t>& out) {
+	blitter->CatchUp();
+	out.clear();
+	out.reserve(sizeof(SystemState) + VIDEO_ARENA_SIZE + sizeof(CartridgeState) + AUDIO_RAM_SIZE + (romIsBanked() ? cartridge_state.size : 0) + 1024);
+	StateWriter writer(out);
+	uint32_t version = SAVESTATE_VERSION;
+	writer.Write(SAVESTATE_MAGIC, 4);
+	writer.Put(version);
+	writer.Put(loadedRomType);
+	writer.Put(cartridge_state.size);
+	writer.Put(romFingerprint());
+
+	writer.Section("SYS ");
+	writer.Put(system_state.dma_control);
+	writer.Put(system_state.dma_control_irq);
+	writer.Put(system_state.banking);
+	writer.Put(system_state.ram);
+	writer.Put(system_state.ram_initialized);
+	writer.Write(system_state.vram, VIDEO_ARENA_SIZE);
+	writer.Put(system_state.VIA_regs);
+	writer.Put(rng);
+
+	writer.Section("CART");
+	writer.Put(cartridge_state.bank_shifter);
+	writer.Put(cartridge_state.bank_mask);
+	writer.Put(cartridge_state.write_mode);
+	writer.Put(cartridge_state.save_ram);
+	if(romIsBanked()) {
+		writer.Write(cartridge_state.rom, cartridge_state.size);
+	}
+
+	writer.Section("TIME");
+	writer.Put(timekeeper.totalCyclesCount);
+	writer.Put(timekeeper.cycles_since_vsync);
+	writer.Put(timekeeper.actual_cycles);
+
+	writer.Section("CPU ");
+	writer.Put(cpu_core->GetState());
+
+	blitter->SaveState(writer);
+	soundcard->SaveState(writer);
+	joysticks->SaveState(writer);
+	writer.Section("END ");
+}
+
+//Reads straight into the live machine, so a failed load is rolled back from a backup
+bool readState(const uint8_t* data, size_t size) {
+	StateReader reader(data, size);
+	char magic[4];
+	uint32_t version;
+	RomType romType;
+	int romSize;
+	uint64_t fingerprint;
+	reader.Read(magic, 4);
+	reader.Get(version);
+	reader.Get(romType);
+	reader.Get(romSize);
+	reader.Get(fingerprint);
+	if(!reader.Ok() || (memcmp(magic, SAVESTATE_MAGIC, 4) != 0)) {
+		printf("Not a savestate\n");
+		return false;
+	}
+	if(version != SAVESTATE_VERSION) {
+		printf("Savestate version %u isn't supported (expected %u)\n", version, SAVESTATE_VERSION);
+		return false;
+	}
+	if((romType != loadedRomType) || (romSize != cartridge_state.size) || (fingerprint != romFingerprint())) {
+		printf("Savestate was made with a different ROM\n");
+		return false;
+	}
+
+	mos6502State cpuState;
+	reader.Section("SYS ");
+	reader.Get(system_state.dma_control);
+	reader.Get(system_state.dma_control_irq);
+	reader.Get(system_state.banking);
+	reader.Get(system_state.ram);
+	reader.Get(system_state.ram_initialized);
+	//only frames that differ get copied and redrawn
+	const uint8_t* video = reader.Take(VIDEO_ARENA_SIZE);
+	for(int frame = 0; video && (frame < VIDEO_FRAME_COUNT); ++frame) {
+		size_t offset = frame * FRAME_BUFFER_SIZE;
+		if(memcmp(system_state.vram + offset, video + offset, FRAME_BUFFER_SIZE) != 0) {
+			memcpy(system_state.vram + offset, video + offset, FRAME_BUFFER_SIZE);
+			system_state.video_dirty |= (1ull << frame);
+		}
+	}
+	reader.Get(system_state.VIA_regs);
+	reader.Get(rng);
+
+	reader.Section("CART");
+	reader.Get(cartridge_state.bank_shifter);
+	reader.Get(cartridge_state.bank_mask);
+	reader.Get(cartridge_state.write_mode);
+	reader.Get(cartridge_state.save_ram);
+	if(romIsBanked()) {
+		//only touch blocks that differ so unchanged ROM pages stay shared
+		const uint8_t* rom = reader.Take(cartridge_state.size);
+		for(size_t offset = 0; rom && (offset < (size_t) cartridge_state.size); offset += FLASH_BLOCK_SIZE) {
+			size_t length = std::min((size_t) FLASH_BLOCK_SIZE, cartridge_state.size - offset);
+			if(memcmp(cartridge_state.rom + offset, rom + offset, length) != 0) {
+				memcpy(cartridge_state.rom + offset, rom + offset, length);
+			}
+		}
+	}
+
+	reader.Section("TIME");
+	reader.Get(timekeeper.totalCyclesCount);
+	reader.Get(timekeeper.cycles_since_vsync);
+	reader.Get(timekeeper.actual_cycles);
+
+	reader.Section("CPU ");
+	reader.Get(cpuState);
+	if(!reader.Ok()) {
+		return false;
+	}
+	cpu_core->SetState(cpuState, &system_state.dma_control_irq);
+
+	if(!blitter->LoadState(reader) || !soundcard->LoadState(reader) || !joysticks->LoadState(reader)) {
+		return false;
+	}
+	return reader.Section("END ");
+}
+
+bool LoadState(const uint8_t* data, size_t size) {
+	static std::vector<uint8_t> backup;
+	SaveState(backup);
+	if(!readState(data, size)) {
+		printf("Savestate is damaged or incomplete\n");
+		readState(backup.data(), backup.size());
+		return false;
+	}
+	if(romIsBanked()) {
+		flash_store.MarkAllDirty();
+		nvram_store.MarkDirty();
+	}
+	redraw_vram_surfaces();
+	return true;
+}
+
+bool SaveStateToFile(const std::string& path) {
+	std::vector<uint8_t> buffer;
+	SaveState(buffer);
+	ofstream file(path, ios::out | ios::binary | ios::trunc);
+	if(!file.is_open()) {
+		printf("Unable to write savestate %s\n", path.c_str());
+		return false;
+	}
+	file.write((char*) buffer.data(), buffer.size());
+	file.close();
+	printf("Saved state to %s\n", path.c_str());
+	return true;
+}
+
+bool LoadStateFromFile(const std::string& path) {
+	ifstream file(path, ios::in | ios::binary);
+	if(!file.is_open()) {
+		printf("No savestate at %s\n", path.c_str());
+		return false;
+	}
+	std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if(!LoadState(buffer.data(), buffer.size())) {
+		return false;
+	}
+	printf("Loaded state from %s\n", path.c_str());
+	return true;
+}
+
+//Savestate for an overrun, next to the quick save and named after it
+void saveBudgetState() {
+	if(currentRomFilePath.empty()) {
+		budget_monitor.SavestateWritten("");
+		return;
+	}
+	std::filesystem::path path(savestateFileFullPath);
+	path.replace_filename(path.stem().string() + "." + budget_monitor.SavestateTag() + ".gts");
+	budget_monitor.SavestateWritten(SaveStateToFile(path.string()) ? path.string() : "");
+}
+
+//Flight recording and a savestate to go with it, named after the quick save
+void dumpFlightRecorder() {
+	if(currentRomFilePath.empty()) {
+		flight_recorder.Dump("flight_recording.gtfr", false);
+		return;
+	}
+	std::filesystem::path path(savestateFileFullPath);
+	std::string stem = path.stem().string() + "." + flight_recorder.PendingReason() + "_" + std::to_string(timekeeper.totalCyclesCount);
+	path.replace_filename(stem + ".gtfr");
+	if(flight_recorder.Dump(path.string(), romIsBanked())) {
+		path.replace_extension("gts");
+		SaveStateToFile(path.string());
+	}
+}
+
+void dumpFlightRecorderHotkey() {
+	flight_recorder.Trigger("hotkey");
+	if(flight_recorder.DumpPending()) {
+		dumpFlightRecorder();
+	}
+}
+
+void quickSave() {
+	if(currentRomFilePath.empty()) return;
+	SaveStateToFile(savestateFileFullPath);
+}
+
+void quickLoad() {
+	if(currentRomFilePath.empty()) return;
+	stopMovie();
+	LoadStateFromFile(savestateFileFullPath);
+}
+
 void toggleFullScreen() {
 	if(isFullScreen) {
 		SDL_SetWindowFullscreen(mainWindow, 0);
@@ -831,6 +1188,10 @@ HotkeyAssignment hotkeys[] = {
 	{&toggleFullScreen, SDLK_F11},
 	{&toggleMute, SDLK_m},
 #if !defined(WASM_BUILD) && !defined(WRAPPER_MODE)
+	{&quickSave, SDLK_F2},
+	{&quickLoad, SDLK_F3},
+	{&toggleDeepProfileRecording, SDLK_F4},
+	{&dumpFlightRecorderHotkey, SDLK_F5},
 	{&doRamDump, SDLK_F6},
 	{&toggleSteppingWindow, SDLK_F7},
 	{&takeScreenShot, SDLK_F8},
@@ -898,6 +1259,12 @@ void refreshScreen() {
 						LoadRomFile(rom_file_name);
 					}	
 				}
+				if(ImGui::MenuItem("Save State (F2)")) {
+					quickSave();
+				}
+				if(ImGui::MenuItem("Load State (F3)")) {
+					quickLoad();
+				}
 				if(ImGui::MenuItem("Exit")) {
 					running = false;
 				}
@@ -941,8 +1308,11 @@ void refreshScreen() {
 				if(ImGui::MenuItem("Dump RAM to file (F6)")) {
 					doRamDump();
 				}
-				if(ImGui::MenuItem("Deep Profile Single Vsync")) {
-					vsyncProfileArmed = true;
+				if(ImGui::MenuItem("Deep Profile Single Vsync", NULL, false, !profiler.DeepProfileRecording())) {
+					profiler.deepProfileArmedFrames = 1;
+				}
+				if(ImGui::MenuItem(profiler.DeepProfileRecording() ? "Stop Deep Profile (F4)" : "Record Deep Profile (F4)")) {
+					toggleDeepProfileRecording();
 				}
 				ImGui::EndMenu();
 			}
@@ -1001,7 +1371,6 @@ void refreshScreen() {
 			resetQueued = 2;
 			showMenu = false;
 			setMenuMute(showMenu);
-			joysticks->Reset();
 		}
 
 		if(ImGui::Selectable("Exit")) {
@@ -1026,6 +1395,131 @@ double last_raf_time = 0;
 double frame_time_accumulator = 0;
 #endif
 
+//Run the main CPU for the given number of cycles and bring the rest of the
+//system along with it, delivering the vsync NMI when one comes due.
+void emulateCycles(int32_t cycles) {
+	bool movieBatch = (cycles != 0) && (movie.GetMode() != Movie::IDLE);
+	if(movieBatch) {
+		uint8_t reset = movie.BeginBatch(cycles);
+		if(reset != MOVIE_RESET_NONE) {
+			resetSystem(reset == MOVIE_RESET_HARD);
+		}
+		uint16_t pad1 = joysticks->Buttons(0);
+		uint16_t pad2 = joysticks->Buttons(1);
+		movie.SyncButtons(pad1, pad2);
+		joysticks->OverrideButtons(movie.Playing(), pad1, pad2);
+	}
+	timekeeper.actual_cycles = timekeeper.totalCyclesCount;
+	cpu_core->sampleInterval = pc_sampler.enabled ? pc_sampler.interval : 0;
+	attach_exec_coverage();
+	if(cycles) {
+		cpu_core->Run(cycles, timekeeper.totalCyclesCount);
+	}
+	timekeeper.actual_cycles = timekeeper.totalCyclesCount - timekeeper.actual_cycles;
+	if(budget_monitor.active) {
+		budget_monitor.AddCycles(timekeeper.actual_cycles);
+	}
+	if(cpu_core->waiting && (timekeeper.actual_cycles < (uint64_t) cycles)) {
+		//the main CPU doesn't skip through WAI itself, the rest of the batch is spent there
+		cpu_core->CountSampleCycles(cpu_core->pc - 1, cycles - timekeeper.actual_cycles);
+	}
+	if(cpu_core->illegalOpcode) {
+		printf("Hit illegal opcode %x\npc = %x\n", cpu_core->illegalOpcodeSrc, cpu_core->pc);
+		paused = true;
+		flight_recorder.Trigger("illegal_opcode");
+	} else if((timekeeper.clock_mode == CLOCKMODE_NORMAL) && (timekeeper.actual_cycles == 0)) {
+		profiler.zeroConsec++;
+		if(profiler.zeroConsec == 10) {
+			printf("(Got stuck at 0x%x)\n", cpu_core->pc);
+			paused = true;
+			flight_recorder.Trigger("stuck");
+		}
+		timekeeper.totalCyclesCount += cycles;
+	} else {
+		profiler.zeroConsec = 0;
+	}
+
+	timekeeper.totalCyclesCount -= timekeeper.actual_cycles;
+	timekeeper.totalCyclesCount += cycles;
+	timekeeper.cycles_since_vsync += cycles;
+	bool frameEnded = false;
+	if(timekeeper.cycles_since_vsync >= timekeeper.cycles_per_vsync) {
+		timekeeper.cycles_since_vsync -= timekeeper.cycles_per_vsync;
+		frameEnded = true;
+		if(system_state.dma_control & DMA_VSYNC_NMI_BIT) {
+			if(profiler.deepProfileArmedFrames) {
+				profiler.DeepProfileStart();
+				profiler.deepProfileFramesLeft = profiler.deepProfileArmedFrames;
+				profiler.deepProfileArmedFrames = 0;
+			} else if(profiler.deepProfileFramesLeft && (--profiler.deepProfileFramesLeft == 0)) {
+				profiler.DeepProfileStop(loadedMemoryMap, SourceMap::singleton);
+			}
+			cpu_core->NMI();
+		}
+		if(hardware_trace.enabled) {
+			bool nmi = (system_state.dma_control & DMA_VSYNC_NMI_BIT) != 0;
+			hardware_trace.EndFrame(instruction_pc, symbol_bank(), nmi ? cpu_core->pc : 0, nmi);
+		}
+		if(!profiler.measure_by_frameflip) {
+			profiler.ResetTimers();
+			profiler.last_blitter_activity = blitter->pixels_this_frame;
+			blitter->pixels_this_frame = 0;
+		}
+		if(memory_heatmap.enabled && memory_heatmap.decay) {
+			memory_heatmap.Decay();
+		}
+		budget_monitor.EndFrame();
+		if(bank_profiler.enabled) {
+			bank_profiler.EndFrame();
+		}
+		if(blit_timeline.enabled) {
+			blit_timeline.EndFrame();
+		}
+	}
+	blitter->CatchUp();
+	soundcard->CatchUp();
+	if(movieBatch && (movie.GetMode() != Movie::IDLE)) {
+		movie.EndBatch();
+		if(!movie.Playing()) {
+			joysticks->OverrideButtons(false);
+		}
+	}
+	if(frameEnded && rewindBuffer) {
+		rewindBuffer->FrameEnded();
+	}
+	if(budget_monitor.SavestatePending()) {
+		saveBudgetState();
+	}
+	if(flight_recorder.DumpPending()) {
+		dumpFlightRecorder();
+	}
+}
+
+//Load the keyframe before the target batch, then play up to it
+void seekMovie(uint32_t target) {
+	if(!movie.Seek(target)) {
+		return;
+	}
+	while(movie.Playing() && (movie.Batch() < target)) {
+		emulateCycles(timekeeper.cycles_per_vsync);
+	}
+}
+
+//Start the movie asked for on the command line, once a ROM is loaded.
+//A recording starts from a hard reset with a known seed so it can be reproduced.
+void startMovie() {
+	if(EmulatorConfig::playFile != NULL) {
+		if(movie.Load(EmulatorConfig::playFile) && (EmulatorConfig::movieSeek != 0)) {
+			seekMovie(EmulatorConfig::movieSeek);
+		}
+	} else if(EmulatorConfig::recordFile != NULL) {
+		rng.Seed(EmulatorConfig::seed);
+		resetSystem(true);
+		movie.StartRecording(EmulatorConfig::seed);
+		printf("Recording movie to %s (seed %llu)\n", EmulatorConfig::recordFile, (unsigned long long) EmulatorConfig::seed);
+	}
+}
+
 EM_BOOL mainloop(double time, void* userdata) {
 #ifdef WASM_BUILD
         double delta_time = time - last_raf_time;
@@ -1042,7 +1536,6 @@ EM_BOOL mainloop(double time, void* userdata) {
 #else
 	if(!paused) {
 #endif
-			timekeeper.actual_cycles = timekeeper.totalCyclesCount;
 #ifndef WASM_BUILD
 			switch(timekeeper.clock_mode) {
 				case CLOCKMODE_NORMAL:
@@ -1051,7 +1544,7 @@ EM_BOOL mainloop(double time, void* userdata) {
 					break;
 				case CLOCKMODE_SINGLE:
 					cpu_core->freeze = false;
-					Disassembler::Decode(MemoryReadResolve, loadedMemoryMap, cpu_core->pc, 32);
+					Disassembler::Decode(MemoryReadResolve, loadedMemoryMap, cpu_core->pc, 32, cartridge_state.bank_mask);
 					intended_cycles = 1;
 					timekeeper.clock_mode = CLOCKMODE_STOPPED;
 					break;
@@ -1059,26 +1552,14 @@ EM_BOOL mainloop(double time, void* userdata) {
 					intended_cycles = 0;
 					break;
 			}
-			if(intended_cycles) {
-				cpu_core->Run(intended_cycles, timekeeper.totalCyclesCount);
-			}
 #else
 			intended_cycles = timekeeper.cycles_per_vsync;
-			cpu_core->Run(intended_cycles, timekeeper.totalCyclesCount);
 #endif
-			timekeeper.actual_cycles = timekeeper.totalCyclesCount - timekeeper.actual_cycles;
-			if(cpu_core->illegalOpcode) {
-				printf("Hit illegal opcode %x\npc = %x\n", cpu_core->illegalOpcodeSrc, cpu_core->pc);
-				paused = true;
-			} else if((timekeeper.clock_mode == CLOCKMODE_NORMAL) && (timekeeper.actual_cycles == 0)) {
-				profiler.zeroConsec++;
-				if(profiler.zeroConsec == 10) {
-					printf("(Got stuck at 0x%x)\n", cpu_core->pc);
-					paused = true;
-				}
-				timekeeper.totalCyclesCount += intended_cycles;
+			if(rewinding && rewindBuffer) {
+				stopMovie();
+				rewindBuffer->StepBack();
 			} else {
-				profiler.zeroConsec = 0;
+				emulateCycles(intended_cycles);
 			}
 
 #ifndef WASM_BUILD
@@ -1127,38 +1608,9 @@ EM_BOOL mainloop(double time, void* userdata) {
 				timekeeper.frameCount++;
 			}
 #endif
-			timekeeper.totalCyclesCount -= timekeeper.actual_cycles;
-			timekeeper.totalCyclesCount += intended_cycles;
-			timekeeper.cycles_since_vsync += intended_cycles;
-			if(timekeeper.cycles_since_vsync >= timekeeper.cycles_per_vsync) {
-				timekeeper.cycles_since_vsync -= timekeeper.cycles_per_vsync;
-				if(system_state.dma_control & DMA_VSYNC_NMI_BIT) {
-					cpu_core->NMI();
-					if(vsyncProfileArmed) {
-						profiler.DeepProfileStart();
-						vsyncProfileArmed = false;
-						vsyncProfileRunning = true;
-					} else if(vsyncProfileRunning) {
-						profiler.DeepProfileStop(loadedMemoryMap, SourceMap::singleton);
-						vsyncProfileRunning = false;
-					}
-				}
-				if(!profiler.measure_by_frameflip) {
-					profiler.ResetTimers();
-					profiler.last_blitter_activity = blitter->pixels_this_frame;
-					blitter->pixels_this_frame = 0;
-				}
-			}
 		} else {
 				SDL_Delay(16);
 		}
-		blitter->CatchUp();
-		
-
-		if(EmulatorConfig::noSound) {
-			AudioCoprocessor::fill_audio(AudioCoprocessor::singleton_acp_state, NULL, intended_cycles / AudioCoprocessor::singleton_acp_state->cycles_per_sample);
-		}
-
 		while( SDL_PollEvent( &e ) != 0 )
         {
 #ifndef WASM_BUILD
@@ -1218,6 +1670,9 @@ EM_BOOL mainloop(double time, void* userdata) {
 						case SDLK_BACKQUOTE:
 							gofast = (e.type == SDL_KEYDOWN);
 							break;
+						case SDLK_BACKSPACE:
+							rewinding = (e.type == SDL_KEYDOWN);
+							break;
 						case SDLK_r:
 							//TODO add menu item for reset
 							if(e.type == SDL_KEYDOWN) {
@@ -1289,21 +1744,94 @@ EM_BOOL mainloop(double time, void* userdata) {
 
 	if(resetQueued) {
 		paused = false;
-		if(lshift || rshift || (resetQueued == 2)) {
-			randomize_memory();
-			randomize_vram();
+		bool hard = lshift || rshift || (resetQueued == 2);
+		if(movie.Recording()) {
+			//done at the start of the next batch, where playback will do it too
+			movie.QueueReset(hard);
+		} else {
+			stopMovie();
+			resetSystem(hard);
 		}
-		cpu_core->Reset();
-		cartridge_state.write_mode = false;
-		joysticks->Reset();
 		resetQueued = 0;
 	}
 	return running;
 }
 
+//Reports asked for on the command line, written once emulation is over.
+//Returns false if a cycle budget check failed.
+bool writeReports() {
+	if(EmulatorConfig::acpReportFile != NULL) {
+		soundcard->write_budget_report(EmulatorConfig::acpReportFile);
+	}
+	if(EmulatorConfig::busReportFile != NULL) {
+		bus_monitor.WriteJSON(EmulatorConfig::busReportFile);
+	}
+	if(EmulatorConfig::sampleReportFile != NULL) {
+		pc_sampler.WriteJSON(EmulatorConfig::sampleReportFile, loadedMemoryMap, SourceMap::singleton);
+	}
+	if(EmulatorConfig::coverageFile != NULL) {
+		exec_coverage.WriteLcov(EmulatorConfig::coverageFile, SourceMap::singleton);
+	}
+	if(EmulatorConfig::budgetReportFile != NULL) {
+		budget_monitor.WriteJSON(EmulatorConfig::budgetReportFile);
+	}
+	if(EmulatorConfig::bankReportFile != NULL) {
+		bank_profiler.WriteJSON(EmulatorConfig::bankReportFile, loadedMemoryMap);
+	}
+	if(EmulatorConfig::blitTimelineFile != NULL) {
+		blit_timeline.WriteTrace(blit_timeline.traceFile);
+	}
+	if(EmulatorConfig::hardwareTraceFile != NULL) {
+		hardware_trace.WriteTrace(hardware_trace.traceFile, loadedMemoryMap);
+	}
+	return (EmulatorConfig::budgetReportFile == NULL) || budget_monitor.Passed();
+}
+
+//Headless mode: run as fast as possible, sending ACP output to a .wav file
+int renderAudioToFile() {
+	InputScript script;
+	if(EmulatorConfig::inputScript != NULL) {
+		if(!script.Load(EmulatorConfig::inputScript)) {
+			return 1;
+		}
+	}
+	if(!soundcard->StartCapture(EmulatorConfig::wavFile)) {
+		return 1;
+	}
+	uint32_t frameLimit = EmulatorConfig::frameLimit;
+	if((frameLimit == 0) && movie.Playing()) {
+		frameLimit = movie.Length() - movie.Batch();
+	} else if(frameLimit == 0) {
+		frameLimit = 60 * 60;
+		printf("No --frames or --seconds given, rendering %u frames\n", frameLimit);
+	}
+	printf("Rendering audio to %s\n", EmulatorConfig::wavFile);
+	if(EmulatorConfig::deepProfileFile != NULL) {
+		profiler.DeepProfileStart();
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+	uint32_t frame;
+	for(frame = 0; (frame < frameLimit) && !paused; ++frame) {
+		joysticks->SetHeldButtons(script.ButtonsAt(frame));
+		intended_cycles = timekeeper.cycles_per_vsync;
+		emulateCycles(intended_cycles);
+	}
+	soundcard->StopCapture();
+	stopMovie();
+	if(profiler.DeepProfileRecording()) {
+		profiler.DeepProfileStop(loadedMemoryMap, SourceMap::singleton);
+	}
+	bool reportsPassed = writeReports();
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	printf("Rendered %u frames in %.2fs (%.1fx realtime)\n", frame, elapsed, (frame / 60.0) / (elapsed > 0 ? elapsed : 1));
+	//budget checks fail the run
+	return reportsPassed ? 0 : 1;
+}
+
 int main(int argC, char* argV[]) {
-	srand(time(NULL));
-	cartridge_state.rom = new uint8_t[1 << 21];
+	cartridge_state.rom = rom_image.Data();
 
 	const char* rom_file_name = NULL;
 
@@ -1319,6 +1847,56 @@ int main(int argC, char* argV[]) {
 	}
 #endif
 
+	if(EmulatorConfig::wavFile != NULL) {
+		//fixed seed so the same ROM and input script always render the same file
+		if(!EmulatorConfig::fixedSeed) {
+			EmulatorConfig::seed = 0;
+			EmulatorConfig::fixedSeed = true;
+		}
+		EmulatorConfig::noSound = true;
+		EmulatorConfig::noJoystick = true;
+	}
+	if(!EmulatorConfig::fixedSeed) {
+		EmulatorConfig::seed = (uint64_t) time(NULL);
+	}
+	rng.Seed(EmulatorConfig::seed);
+	bus_monitor.enabled = (EmulatorConfig::busReportFile != NULL);
+	pc_sampler.enabled = (EmulatorConfig::sampleReportFile != NULL);
+	exec_coverage.enabled = (EmulatorConfig::coverageFile != NULL);
+	bank_profiler.enabled = (EmulatorConfig::bankReportFile != NULL);
+	if(EmulatorConfig::blitTimelineFile != NULL) {
+		blit_timeline.enabled = true;
+		blit_timeline.traceFile = EmulatorConfig::blitTimelineFile;
+	}
+	if(EmulatorConfig::hardwareTraceFile != NULL) {
+		hardware_trace.enabled = true;
+		hardware_trace.traceFile = EmulatorConfig::hardwareTraceFile;
+	}
+	if(EmulatorConfig::hardwareTraceKinds != NULL) {
+		hardware_trace.kinds = HardwareTrace::KindMask(EmulatorConfig::hardwareTraceKinds);
+	}
+	if(EmulatorConfig::deepProfileFile != NULL) {
+		profiler.deepProfileTraceFile = EmulatorConfig::deepProfileFile;
+	}
+	if(EmulatorConfig::flightQueryFile != NULL) {
+		//read a dump back and quit, symbols come from the ROM's map as usual
+		FlightQuery query;
+		if((EmulatorConfig::flightFilter != NULL) && !query.Parse(EmulatorConfig::flightFilter)) {
+			return 1;
+		}
+		query.last = EmulatorConfig::flightLast;
+		query.hot = EmulatorConfig::flightHot;
+		MemoryMap* memory_map = NULL;
+		if(rom_file_name != NULL) {
+			std::filesystem::path mapPath = std::filesystem::path(rom_file_name).parent_path().append("../build/out.map");
+			if(std::filesystem::exists(mapPath)) {
+				memory_map = new MemoryMap(mapPath.string());
+			}
+		}
+		return FlightRecorder::Query(EmulatorConfig::flightQueryFile, query, memory_map);
+	}
+	flight_recorder.Allocate((size_t) EmulatorConfig::flightRecorderMillions * 1000000);
+
 #ifdef DEFAULT_ROM_PATH
 	if(argC == 1) {
 		int execPathLength = wai_getExecutablePath(NULL, 0, NULL);
@@ -1335,18 +1913,21 @@ int main(int argC, char* argV[]) {
 	}
 #endif
 
-	//cartridge_state.rom = new uint8_t [cartridge_state.size];
-		for(int i = 0; i < cartridge_state.size; i++) {
-			cartridge_state.rom[i] = 0;
-		}
-
 	joysticks = new JoystickAdapter();
-	soundcard = new AudioCoprocessor();
+	soundcard = new AudioCoprocessor(&timekeeper);
 	cpu_core = new mos6502(MemoryRead, MemoryWrite, CPUStopped, MemorySync);
+	cpu_core->IRQTaken = CPUTookIRQ;
+	cpu_core->NMITaken = CPUTookNMI;
+	cpu_core->IRQRaised = CPURaisedIRQ;
+	cpu_core->Returned = CPUReturnedFromInterrupt;
+	cpu_core->Sampled = CPUSampled;
 	cpu_core->Reset();
 	cartridge_state.write_mode = false;
 	blitter = new Blitter(cpu_core, &timekeeper, &system_state, vRAM_Surface);
+	blitter->heatmap = &memory_heatmap;
+	blitter->timeline = &blit_timeline;
 	randomize_memory();
+	soundcard->RandomizeMemory(rng);
 	
 	SDL_Init(SDL_INIT_VIDEO);
 	atexit(SDL_Quit);
@@ -1359,6 +1940,20 @@ int main(int argC, char* argV[]) {
 	SDL_SetColorKey(vRAM_Surface, SDL_FALSE, 0);
 	SDL_SetColorKey(gRAM_Surface, SDL_FALSE, 0);
 
+	if(EmulatorConfig::wavFile != NULL) {
+		randomize_vram();
+		if(!rom_file_name || LoadRomFile(rom_file_name) == -1) {
+			printf("A ROM file is required to render audio\n");
+			return 1;
+		}
+		startMovie();
+		return renderAudioToFile();
+	}
+
+	if(EmulatorConfig::rewindMegabytes != 0) {
+		rewindBuffer = new RewindBuffer((size_t) EmulatorConfig::rewindMegabytes << 20, EmulatorConfig::rewindInterval, SaveState, LoadState);
+	}
+
 	mainWindow = SDL_CreateWindow(WINDOW_TITLE, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
 	mainRenderer = SDL_CreateRenderer(mainWindow, -1, EmulatorConfig::defaultRendererFlags);
 	framebufferTexture = SDL_CreateTexture(mainRenderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, GT_WIDTH, GT_HEIGHT * 2);
@@ -1400,23 +1995,33 @@ int main(int argC, char* argV[]) {
 		}
 #endif
 		
+	} else {
+		startMovie();
 	}
 
+	int exitStatus = 0;
 #ifdef WASM_BUILD
 
 	emscripten_request_animation_frame_loop(mainloop, 0);
 #else
 	SDL_RaiseWindow(mainWindow);
+	if(EmulatorConfig::deepProfileFile != NULL) {
+		profiler.DeepProfileStart();
+	}
 	while(running) {
 		mainloop(0, NULL);
 	}
+	stopMovie();
+	if(profiler.DeepProfileRecording()) {
+		profiler.DeepProfileStop(loadedMemoryMap, SourceMap::singleton);
+	}
 	joysticks->SaveBindings();
-#endif
-
-#ifndef WASM_BUILD
-	if(savingThread.joinable()) {
-		savingThread.join();
+	if(!writeReports()) {
+		exitStatus = 1;
 	}
 #endif
-	return 0;
+
+	nvram_store.Close();
+	flash_store.Flush();
+	return exitStatus;
 }
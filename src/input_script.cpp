@@ -0,0 +1,59 @@
+#include "input_script.h"
+#include "joystick_adapter.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+
+static uint16_t parseButton(const std::string& name) {
+    if(name == "UP") return GameTankButtons::UP;
+    if(name == "DOWN") return GameTankButtons::DOWN;
+    if(name == "LEFT") return GameTankButtons::LEFT;
+    if(name == "RIGHT") return GameTankButtons::RIGHT;
+    if(name == "A") return GameTankButtons::A;
+    if(name == "B") return GameTankButtons::B;
+    if(name == "C") return GameTankButtons::C;
+    if(name == "START") return GameTankButtons::START;
+    return (uint16_t) std::stoul(name, nullptr, 0);
+}
+
+bool InputScript::Load(const char* path) {
+    std::ifstream file(path);
+    if(!file.is_open()) {
+        printf("Unable to open input script %s\n", path);
+        return false;
+    }
+    std::string line;
+    int lineNum = 0;
+    while(std::getline(file, line)) {
+        ++lineNum;
+        if(line.empty() || line[0] == '#') continue;
+        std::istringstream iss(line);
+        InputScriptEntry entry;
+        if(!(iss >> entry.frame)) continue;
+        entry.buttons = 0;
+        std::string token;
+        while(iss >> token) {
+            try {
+                entry.buttons |= parseButton(token);
+            } catch(const std::exception&) {
+                printf("Input script line %d: unknown button %s\n", lineNum, token.c_str());
+            }
+        }
+        entries.push_back(entry);
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const InputScriptEntry& a, const InputScriptEntry& b) { return a.frame < b.frame; });
+    cursor = 0;
+    current = 0;
+    return true;
+}
+
+//Frames must be asked for in increasing order
+uint16_t InputScript::ButtonsAt(uint32_t frame) {
+    while((cursor < entries.size()) && (entries[cursor].frame <= frame)) {
+        current = entries[cursor].buttons;
+        ++cursor;
+    }
+    return current;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Scripted gamepad input for headless runs.
+// Each line of the script is "<frame> <buttons...>" where buttons are
+// UP DOWN LEFT RIGHT A B C START (or a numeric mask). The buttons stay held
+// from that frame until the next line. Lines starting with # are ignored.
+typedef struct InputScriptEntry {
+    uint32_t frame;
+    uint16_t buttons;
+} InputScriptEntry;
+
+class InputScript {
+private:
+    std::vector<InputScriptEntry> entries;
+    size_t cursor = 0;
+    uint16_t current = 0;
+public:
+    bool Load(const char* path);
+    uint16_t ButtonsAt(uint32_t frame);
+};
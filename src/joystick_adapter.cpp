@@ -25,14 +25,30 @@ JoystickAdapter::~JoystickAdapter() {
 	gGameController = NULL;
 }
 
+//The buttons the game sees on a port, before the select latch picks a byte
+uint16_t JoystickAdapter::Buttons(uint8_t portNum) {
+	if(portNum % 2) {
+		return overridden ? override2Mask : pad2Mask;
+	}
+	return overridden ? override1Mask : (pad1Mask | held1Mask);
+}
+
+//While enabled the ports report the given masks and ignore live input (movie playback)
+void JoystickAdapter::OverrideButtons(bool enabled, uint16_t pad1, uint16_t pad2) {
+	overridden = enabled;
+	override1Mask = pad1;
+	override2Mask = pad2;
+}
+
 uint8_t JoystickAdapter::read(uint8_t portNum, bool stateful) {
 	uint8_t outbyte = 0xFF;
+	uint16_t buttons = Buttons(portNum);
 	if(portNum % 2) {
 		
 		if(pad2State) {
-			outbyte = (uint8_t) (pad2Mask >> 8);
+			outbyte = (uint8_t) (buttons >> 8);
 		} else {
-			outbyte = (uint8_t) pad2Mask;
+			outbyte = (uint8_t) buttons;
 		}
 		if(stateful) {
 			pad1State = false;
@@ -41,9 +57,9 @@ uint8_t JoystickAdapter::read(uint8_t portNum, bool stateful) {
 	} else {
 		
 		if(pad1State) {
-			outbyte = (uint8_t) ((pad1Mask | held1Mask) >> 8);
+			outbyte = (uint8_t) (buttons >> 8);
 		} else {
-			outbyte = (uint8_t) (pad1Mask | held1Mask);
+			outbyte = (uint8_t) buttons;
 		}
 		if(stateful) {
 			pad2State = false;
@@ -203,4 +219,18 @@ void JoystickAdapter::Reset() {
 	for(int i = 0; i < (BUTTON_COUNT*2); ++i) {
 		button_press_counts[i] = 0;
 	}
-}
\ No newline at end of file
+}
+
+//Only the select latches are emulated state, the button masks follow live input
+void JoystickAdapter::SaveState(StateWriter& writer) {
+	writer.Section("JOYS");
+	writer.Put(pad1State);
+	writer.Put(pad2State);
+}
+
+bool JoystickAdapter::LoadState(StateReader& reader) {
+	reader.Section("JOYS");
+	reader.Get(pad1State);
+	reader.Get(pad2State);
+	return reader.Ok();
+}
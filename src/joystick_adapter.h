@@ -1,6 +1,7 @@
 #pragma once
 #include "SDL_inc.h"
 #include <vector>
+#include "savestate.h"
 namespace GameTankButtons {
 	enum GamepadButtonMask {
 		UP = 0b0000100000001000,
@@ -57,6 +58,9 @@ private:
 	uint16_t pad1Mask = 0;
 	uint16_t pad2Mask = 0;
 	uint16_t held1Mask = 0;
+	bool overridden = false;
+	uint16_t override1Mask = 0;
+	uint16_t override2Mask = 0;
 	uint8_t button_press_counts[BUTTON_COUNT*2] = {
 		0, 0, 0, 0, 0, 0, 0, 0,
 		0, 0, 0, 0, 0, 0, 0, 0,
@@ -68,7 +72,11 @@ public:
 	uint8_t read(uint8_t portNum, bool stateful);
 	void update(SDL_Event *e);
 	void SetHeldButtons(uint16_t heldMask);
+	uint16_t Buttons(uint8_t portNum);
+	void OverrideButtons(bool enabled, uint16_t pad1 = 0, uint16_t pad2 = 0);
 	std::vector<InputBinding> bindings;
 	void SaveBindings();
 	void Reset();
+	void SaveState(StateWriter& writer);
+	bool LoadState(StateReader& reader);
 };
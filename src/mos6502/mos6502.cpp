@@ -1,5 +1,6 @@
 
 #include "mos6502.h"
+#include <cstring>
 
 mos6502::mos6502(BusRead r, BusWrite w, CPUEvent stp, BusRead sync)
 {
@@ -926,8 +927,8 @@ uint16_t mos6502::Addr_ABS()
 	uint16_t addrH;
 	uint16_t addr;
 
-	addrL = Read(pc++);
-	addrH = Read(pc++);
+	addrL = MemRead(pc++);
+	addrH = MemRead(pc++);
 
 	addr = addrL + (addrH << 8);
 
@@ -936,7 +937,7 @@ uint16_t mos6502::Addr_ABS()
 
 uint16_t mos6502::Addr_ZER()
 {
-	return Read(pc++);
+	return MemRead(pc++);
 }
 
 uint16_t mos6502::Addr_IMP()
@@ -949,7 +950,7 @@ uint16_t mos6502::Addr_REL()
 	uint16_t offset;
 	uint16_t addr;
 
-	offset = (uint16_t)Read(pc++);
+	offset = (uint16_t)MemRead(pc++);
 	if (offset & 0x80) offset |= 0xFF00;
 	addr = pc + (int16_t)offset;
 
@@ -965,17 +966,17 @@ uint16_t mos6502::Addr_ABI()
 	uint16_t abs;
 	uint16_t addr;
 
-	addrL = Read(pc++);
-	addrH = Read(pc++);
+	addrL = MemRead(pc++);
+	addrH = MemRead(pc++);
 
 	abs = (addrH << 8) | addrL;
 
-	effL = Read(abs);
+	effL = MemRead(abs);
 
 #ifndef CMOS_INDIRECT_JMP_FIX
-	effH = Read((abs & 0xFF00) + ((abs + 1) & 0x00FF) );
+	effH = MemRead((abs & 0xFF00) + ((abs + 1) & 0x00FF) );
 #else
-	effH = Read(abs + 1);
+	effH = MemRead(abs + 1);
 #endif
 
 	addr = effL + 0x100 * effH;
@@ -992,18 +993,18 @@ uint16_t mos6502::Addr_AIX()
 	uint16_t abs;
 	uint16_t addr;
 
-	addrL = Read(pc++);
-	addrH = Read(pc++);
+	addrL = MemRead(pc++);
+	addrH = MemRead(pc++);
 
 	// Offset the calculated absolute address by X
 	abs = ((addrH << 8) | addrL) + X;
 
-	effL = Read(abs);
+	effL = MemRead(abs);
 
 #ifndef CMOS_INDIRECT_JMP_FIX
-	effH = Read((abs & 0xFF00) + ((abs + 1) & 0x00FF) );
+	effH = MemRead((abs & 0xFF00) + ((abs + 1) & 0x00FF) );
 #else
-	effH = Read(abs + 1);
+	effH = MemRead(abs + 1);
 #endif
 
 	addr = effL + 0x100 * effH;
@@ -1014,13 +1015,13 @@ uint16_t mos6502::Addr_AIX()
 
 uint16_t mos6502::Addr_ZEX()
 {
-	uint16_t addr = (Read(pc++) + X) % 256;
+	uint16_t addr = (MemRead(pc++) + X) % 256;
 	return addr;
 }
 
 uint16_t mos6502::Addr_ZEY()
 {
-	uint16_t addr = (Read(pc++) + Y) % 256;
+	uint16_t addr = (MemRead(pc++) + Y) % 256;
 	return addr;
 }
 
@@ -1031,8 +1032,8 @@ uint16_t mos6502::Addr_ABX()
 	uint16_t addrL;
 	uint16_t addrH;
 
-	addrL = Read(pc++);
-	addrH = Read(pc++);
+	addrL = MemRead(pc++);
+	addrH = MemRead(pc++);
 
 	addrBase = addrL + (addrH << 8);
 	addr = addrBase + X;
@@ -1050,8 +1051,8 @@ uint16_t mos6502::Addr_ABY()
 	uint16_t addrL;
 	uint16_t addrH;
 
-	addrL = Read(pc++);
-	addrH = Read(pc++);
+	addrL = MemRead(pc++);
+	addrH = MemRead(pc++);
 
 	addrBase = addrL + (addrH << 8);
 	addr = addrBase + Y;
@@ -1069,9 +1070,9 @@ uint16_t mos6502::Addr_INX()
 	uint16_t zeroH;
 	uint16_t addr;
 
-	zeroL = (Read(pc++) + X) % 256;
+	zeroL = (MemRead(pc++) + X) % 256;
 	zeroH = (zeroL + 1) % 256;
-	addr = Read(zeroL) + (Read(zeroH) << 8);
+	addr = MemRead(zeroL) + (MemRead(zeroH) << 8);
 
 	return addr;
 }
@@ -1083,9 +1084,9 @@ uint16_t mos6502::Addr_INY()
 	uint16_t addr;
 	uint16_t addrBase;
 
-	zeroL = Read(pc++);
+	zeroL = MemRead(pc++);
 	zeroH = (zeroL + 1) % 256;
-	addrBase = Read(zeroL) + (Read(zeroH) << 8);
+	addrBase = MemRead(zeroL) + (MemRead(zeroH) << 8);
 	addr = addrBase + Y;
 
 	// An extra cycle is required if a page boundary is crossed
@@ -1100,9 +1101,9 @@ uint16_t mos6502::Addr_ZPI()
 	uint16_t zeroH;
 	uint16_t addr;
 
-	zeroL = Read(pc++);
+	zeroL = MemRead(pc++);
 	zeroH = (zeroL + 1) % 256;
-	addr = Read(zeroL) + (Read(zeroH) << 8);
+	addr = MemRead(zeroL) + (MemRead(zeroH) << 8);
 
 	return addr;
 }
@@ -1113,7 +1114,7 @@ void mos6502::Reset()
 	Y = 0x00;
 	X = 0x00;
 
-	pc = (Read(rstVectorH) << 8) + Read(rstVectorL); // load PC from reset vector
+	pc = (MemRead(rstVectorH) << 8) + MemRead(rstVectorL); // load PC from reset vector
 
 	sp = 0xFD;
 
@@ -1127,7 +1128,7 @@ void mos6502::Reset()
 
 void mos6502::StackPush(uint8_t byte)
 {
-	Write(0x0100 + sp, byte);
+	MemWrite(0x0100 + sp, byte);
 	if(sp == 0x00) sp = 0xFF;
 	else sp--;
 }
@@ -1136,7 +1137,7 @@ uint8_t mos6502::StackPop()
 {
 	if(sp == 0xFF) sp = 0x00;
 	else sp++;
-	return Read(0x0100 + sp);
+	return MemRead(0x0100 + sp);
 }
 
 void mos6502::IRQ()
@@ -1150,7 +1151,10 @@ void mos6502::IRQ()
 		StackPush(pc & 0xFF);
 		StackPush(status);
 		SET_INTERRUPT(1);
-		pc = (Read(irqVectorH) << 8) + Read(irqVectorL);
+		pc = (MemRead(irqVectorH) << 8) + MemRead(irqVectorL);
+		if(IRQTaken != NULL) {
+			IRQTaken();
+		}
 	}
 	return;
 }
@@ -1159,8 +1163,12 @@ void mos6502::ScheduleIRQ(uint32_t cycles, bool *gate) {
 	irq_timer = cycles;
 	irq_gate = gate;
 	if(cycles == 0) {
-		if((irq_gate == NULL) || (*irq_gate)) 
+		if((irq_gate == NULL) || (*irq_gate)) {
+			if(IRQRaised != NULL) {
+				IRQRaised();
+			}
 			IRQ();
+		}
 	}
 }
 
@@ -1177,10 +1185,57 @@ void mos6502::NMI()
 	StackPush(pc & 0xFF);
 	StackPush(status);
 	SET_INTERRUPT(1);
-	pc = (Read(nmiVectorH) << 8) + Read(nmiVectorL);
+	pc = (MemRead(nmiVectorH) << 8) + MemRead(nmiVectorL);
+	if(NMITaken != NULL) {
+		NMITaken();
+	}
 	return;
 }
 
+void mos6502::SetFlatMemory(uint8_t *mem, uint16_t mask, uint16_t writeTrap)
+{
+	flatMem = mem;
+	flatMask = mask;
+	flatWriteTrap = writeTrap;
+}
+
+mos6502State mos6502::GetState()
+{
+	mos6502State state;
+	memset(&state, 0, sizeof(state)); //keep padding stable so identical states compare equal
+	state.A = A;
+	state.X = X;
+	state.Y = Y;
+	state.sp = sp;
+	state.status = status;
+	state.pc = pc;
+	state.irq_timer = irq_timer;
+	state.irq_line = irq_line;
+	state.waiting = waiting;
+	state.freeze = freeze;
+	state.illegalOpcode = illegalOpcode;
+	state.illegalOpcodeSrc = illegalOpcodeSrc;
+	return state;
+}
+
+void mos6502::SetState(const mos6502State &state, bool *gate)
+{
+	A = state.A;
+	X = state.X;
+	Y = state.Y;
+	sp = state.sp;
+	status = state.status;
+	pc = state.pc;
+	irq_timer = state.irq_timer;
+	irq_gate = gate;
+	irq_line = state.irq_line;
+	waiting = state.waiting;
+	freeze = state.freeze;
+	illegalOpcode = state.illegalOpcode;
+	illegalOpcodeSrc = state.illegalOpcodeSrc;
+	opExtraCycles = 0;
+}
+
 void mos6502::Freeze()
 {
 	freeze = true;
@@ -1207,27 +1262,38 @@ void mos6502::Run(
 				if(cyclesRemaining >= irq_timer) {
 					cycleCount += irq_timer;
 					cyclesRemaining -= irq_timer;
+					CountSampleCycles(pc - 1, irq_timer);
 					irq_timer = 0;
 					if((irq_gate == NULL) || (*irq_gate)) {
+						if(IRQRaised != NULL) {
+							IRQRaised();
+						}
 						irq_line = true;
 						IRQ();
 					}
 				} else {
 					irq_timer -= cyclesRemaining;
 					cycleCount += cyclesRemaining;
+					CountSampleCycles(pc - 1, cyclesRemaining);
 					cyclesRemaining = 0;
 					break;
 
 				}
 			} else {
+				if(idleSkip) {
+					cycleCount += cyclesRemaining;
+					CountSampleCycles(pc - 1, cyclesRemaining);
+					cyclesRemaining = 0;
+				}
 				break;
 			}
 		} else if(irq_line) {
 			IRQ();
 		}
 		// fetch
+		uint16_t opcodeAddr = pc;
 		if(Sync == NULL) {
-			opcode = Read(pc++);
+			opcode = MemRead(pc++);
 		} else {
 			opcode = Sync(pc++);
 		}
@@ -1237,9 +1303,39 @@ void mos6502::Run(
 			break;
 		}
 
+		// JMP * or BRA * with nothing to break the loop, burn the rest of the run
+		if(idleSkip && (irq_timer == 0) && (cycleMethod == CYCLE_COUNT) &&
+			(((opcode == 0x4C) && ((MemRead(pc) | (MemRead(pc + 1) << 8)) == opcodeAddr)) ||
+			 ((opcode == 0x80) && (MemRead(pc) == 0xFE)))) {
+			// charge what the loop would take when run, page crossing as Op_BRA sees it
+			int32_t loopCycles = InstrTable[opcode].cycles;
+			if((opcode == 0x80) && !addressesSamePage(opcodeAddr + 2, opcodeAddr)) {
+				loopCycles++;
+			}
+			int32_t loops = (cyclesRemaining + loopCycles - 1) / loopCycles;
+			cycleCount += loops * loopCycles;
+			cyclesRemaining -= loops * loopCycles;
+			if(cycleProfile) {
+				cycleProfile[opcodeAddr & cycleProfileMask] += loops * loopCycles;
+			}
+			CountSampleCycles(opcodeAddr, loops * loopCycles);
+			if(execOpcodes) {
+				ExecCounter &counter = execPages[opcodeAddr >> 13][opcodeAddr & 0x1FFF];
+				counter.count += loops;
+				counter.cycles += loops * loopCycles;
+				execOpcodes[opcode].count += loops;
+				execOpcodes[opcode].cycles += loops * loopCycles;
+			}
+			pc = opcodeAddr;
+			break;
+		}
+
 		// decode
 		instr = InstrTable[opcode];
 
+		// RTI can swap cycleProfile, its own cycles go to the profile it started in
+		uint64_t *profile = cycleProfile;
+
 		// execute
 		Exec(instr);
 		if(illegalOpcode) {
@@ -1251,6 +1347,17 @@ void mos6502::Run(
 		opExtraCycles = 0;
 
 		cycleCount += elapsedCycles;
+		if(profile) {
+			profile[opcodeAddr & cycleProfileMask] += elapsedCycles;
+		}
+		CountSampleCycles(opcodeAddr, elapsedCycles);
+		if(execOpcodes) {
+			ExecCounter &counter = execPages[opcodeAddr >> 13][opcodeAddr & 0x1FFF];
+			counter.count++;
+			counter.cycles += elapsedCycles;
+			execOpcodes[opcode].count++;
+			execOpcodes[opcode].cycles += elapsedCycles;
+		}
 		cyclesRemaining -=
 			(cycleMethod == CYCLE_COUNT )       ? elapsedCycles
 			/* cycleMethod == INST_COUNT */   : 1;
@@ -1262,6 +1369,9 @@ void mos6502::Run(
 			}
 			if(irq_timer == 0) {
 				if((irq_gate == NULL) || (*irq_gate)) {
+					if(IRQRaised != NULL) {
+						IRQRaised();
+					}
 					IRQ();
 					irq_line = true;
 				}
@@ -1284,7 +1394,7 @@ void mos6502::Op_ILLEGAL(uint16_t src)
 
 void mos6502::Op_ADC(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	unsigned int tmp = m + A + (IF_CARRY() ? 1 : 0);
 
 	SET_ZERO(!(tmp & 0xFF));
@@ -1317,7 +1427,7 @@ void mos6502::Op_ADC(uint16_t src)
 
 void mos6502::Op_AND(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	uint8_t res = m & A;
 	SET_NEGATIVE(res & 0x80);
 	SET_ZERO(!res);
@@ -1328,13 +1438,13 @@ void mos6502::Op_AND(uint16_t src)
 
 void mos6502::Op_ASL(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	SET_CARRY(m & 0x80);
 	m <<= 1;
 	m &= 0xFF;
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
-	Write(src, m);
+	MemWrite(src, m);
 	return;
 }
 
@@ -1392,7 +1502,7 @@ void mos6502::Op_BEQ(uint16_t src)
 
 void mos6502::Op_BIT(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	uint8_t res = m & A;
 	SET_NEGATIVE(res & 0x80);
 	status = (status & 0x3F) | (uint8_t)(m & 0xC0);
@@ -1446,7 +1556,7 @@ void mos6502::Op_BRK(uint16_t src)
 	StackPush(pc & 0xFF);
 	StackPush(status | BREAK);
 	SET_INTERRUPT(1);
-	pc = (Read(irqVectorH) << 8) + Read(irqVectorL);
+	pc = (MemRead(irqVectorH) << 8) + MemRead(irqVectorL);
 	return;
 }
 
@@ -1513,7 +1623,7 @@ void mos6502::Op_CLV(uint16_t src)
 
 void mos6502::Op_CMP(uint16_t src)
 {
-	unsigned int tmp = A - Read(src);
+	unsigned int tmp = A - MemRead(src);
 	SET_CARRY(tmp < 0x100);
 	SET_NEGATIVE(tmp & 0x80);
 	SET_ZERO(!(tmp & 0xFF));
@@ -1522,7 +1632,7 @@ void mos6502::Op_CMP(uint16_t src)
 
 void mos6502::Op_CPX(uint16_t src)
 {
-	unsigned int tmp = X - Read(src);
+	unsigned int tmp = X - MemRead(src);
 	SET_CARRY(tmp < 0x100);
 	SET_NEGATIVE(tmp & 0x80);
 	SET_ZERO(!(tmp & 0xFF));
@@ -1531,7 +1641,7 @@ void mos6502::Op_CPX(uint16_t src)
 
 void mos6502::Op_CPY(uint16_t src)
 {
-	unsigned int tmp = Y - Read(src);
+	unsigned int tmp = Y - MemRead(src);
 	SET_CARRY(tmp < 0x100);
 	SET_NEGATIVE(tmp & 0x80);
 	SET_ZERO(!(tmp & 0xFF));
@@ -1540,11 +1650,11 @@ void mos6502::Op_CPY(uint16_t src)
 
 void mos6502::Op_DEC(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	m = (m - 1) % 256;
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
-	Write(src, m);
+	MemWrite(src, m);
 	return;
 }
 
@@ -1580,7 +1690,7 @@ void mos6502::Op_DEY(uint16_t src)
 
 void mos6502::Op_EOR(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	m = A ^ m;
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
@@ -1589,11 +1699,11 @@ void mos6502::Op_EOR(uint16_t src)
 
 void mos6502::Op_INC(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	m = (m + 1) % 256;
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
-	Write(src, m);
+	MemWrite(src, m);
 }
 
 void mos6502::Op_INC_ACC(uint16_t src)
@@ -1638,7 +1748,7 @@ void mos6502::Op_JSR(uint16_t src)
 
 void mos6502::Op_LDA(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
 	A = m;
@@ -1646,7 +1756,7 @@ void mos6502::Op_LDA(uint16_t src)
 
 void mos6502::Op_LDX(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
 	X = m;
@@ -1654,7 +1764,7 @@ void mos6502::Op_LDX(uint16_t src)
 
 void mos6502::Op_LDY(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
 	Y = m;
@@ -1662,12 +1772,12 @@ void mos6502::Op_LDY(uint16_t src)
 
 void mos6502::Op_LSR(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	SET_CARRY(m & 0x01);
 	m >>= 1;
 	SET_NEGATIVE(0);
 	SET_ZERO(!m);
-	Write(src, m);
+	MemWrite(src, m);
 }
 
 void mos6502::Op_LSR_ACC(uint16_t src)
@@ -1687,7 +1797,7 @@ void mos6502::Op_NOP(uint16_t src)
 
 void mos6502::Op_ORA(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	m = A | m;
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
@@ -1751,14 +1861,14 @@ void mos6502::Op_PLY(uint16_t src)
 
 void mos6502::Op_ROL(uint16_t src)
 {
-	uint16_t m = Read(src);
+	uint16_t m = MemRead(src);
 	m <<= 1;
 	if (IF_CARRY()) m |= 0x01;
 	SET_CARRY(m > 0xFF);
 	m &= 0xFF;
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
-	Write(src, m);
+	MemWrite(src, m);
 	return;
 }
 
@@ -1777,14 +1887,14 @@ void mos6502::Op_ROL_ACC(uint16_t src)
 
 void mos6502::Op_ROR(uint16_t src)
 {
-	uint16_t m = Read(src);
+	uint16_t m = MemRead(src);
 	if (IF_CARRY()) m |= 0x100;
 	SET_CARRY(m & 0x01);
 	m >>= 1;
 	m &= 0xFF;
 	SET_NEGATIVE(m & 0x80);
 	SET_ZERO(!m);
-	Write(src, m);
+	MemWrite(src, m);
 	return;
 }
 
@@ -1805,6 +1915,10 @@ void mos6502::Op_RTI(uint16_t src)
 {
 	uint8_t lo, hi;
 
+	if(Returned != NULL) {
+		Returned();
+	}
+
 	status = StackPop();
 
 	lo = StackPop();
@@ -1827,7 +1941,7 @@ void mos6502::Op_RTS(uint16_t src)
 
 void mos6502::Op_SBC(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	unsigned int tmp = A - m - (IF_CARRY() ? 0 : 1);
 	SET_NEGATIVE(tmp & 0x80);
 	SET_ZERO(!(tmp & 0xFF));
@@ -1869,25 +1983,25 @@ void mos6502::Op_SEI(uint16_t src)
 
 void mos6502::Op_STA(uint16_t src)
 {
-	Write(src, A);
+	MemWrite(src, A);
 	return;
 }
 
 void mos6502::Op_STZ(uint16_t src)
 {
-	Write(src, 0);
+	MemWrite(src, 0);
 	return;
 }
 
 void mos6502::Op_STX(uint16_t src)
 {
-	Write(src, X);
+	MemWrite(src, X);
 	return;
 }
 
 void mos6502::Op_STY(uint16_t src)
 {
-	Write(src, Y);
+	MemWrite(src, Y);
 	return;
 }
 
@@ -1953,18 +2067,18 @@ void mos6502::Op_BRA(uint16_t src)
 
 void mos6502::Op_TRB(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	SET_ZERO(m & A);
 	m = m & ~A;
-	Write(src, m);
+	MemWrite(src, m);
 }
 
 void mos6502::Op_TSB(uint16_t src)
 {
-	uint8_t m = Read(src);
+	uint8_t m = MemRead(src);
 	SET_ZERO(m & A);
 	m = m | A;
-	Write(src, m);
+	MemWrite(src, m);
 }
 
 void mos6502::Op_BBRx(uint8_t mask, uint8_t val, uint16_t offset)
@@ -1987,64 +2101,64 @@ void mos6502::Op_BBRx(uint8_t mask, uint8_t val, uint16_t offset)
 
 void mos6502::Op_BBR0(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBRx(0x01, val, offset);
 }
 
 void mos6502::Op_BBR1(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBRx(0x02, val, offset);
 }
 
 void mos6502::Op_BBR2(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBRx(0x04, val, offset);
 }
 
 void mos6502::Op_BBR3(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBRx(0x08, val, offset);
 }
 
 void mos6502::Op_BBR4(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBRx(0x10, val, offset);
 }
 
 void mos6502::Op_BBR5(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBRx(0x20, val, offset);
 }
 
 void mos6502::Op_BBR6(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBRx(0x40, val, offset);
 }
 
 void mos6502::Op_BBR7(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBRx(0x80, val, offset);
 }
@@ -2069,64 +2183,64 @@ void mos6502::Op_BBSx(uint8_t mask, uint8_t val, uint16_t offset)
 
 void mos6502::Op_BBS0(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBSx(0x01, val, offset);
 }
 
 void mos6502::Op_BBS1(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBSx(0x02, val, offset);
 }
 
 void mos6502::Op_BBS2(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBSx(0x04, val, offset);
 }
 
 void mos6502::Op_BBS3(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBSx(0x08, val, offset);
 }
 
 void mos6502::Op_BBS4(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBSx(0x10, val, offset);
 }
 
 void mos6502::Op_BBS5(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBSx(0x20, val, offset);
 }
 
 void mos6502::Op_BBS6(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBSx(0x40, val, offset);
 }
 
 void mos6502::Op_BBS7(uint16_t src)
 {
-	auto val = Read(Read(pc++));
-	uint16_t offset = (uint16_t) Read(pc++);
+	auto val = MemRead(MemRead(pc++));
+	uint16_t offset = (uint16_t) MemRead(pc++);
 
 	Op_BBSx(0x80, val, offset);
 }
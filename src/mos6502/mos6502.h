@@ -39,6 +39,25 @@ using namespace std;
 
 
 
+// Everything needed to resume the CPU exactly where it was.
+// The blit IRQ gate is a host pointer and is supplied again on restore.
+struct mos6502State {
+	uint8_t A, X, Y, sp, status;
+	uint16_t pc;
+	uint32_t irq_timer;
+	bool irq_line;
+	bool waiting;
+	bool freeze;
+	bool illegalOpcode;
+	uint16_t illegalOpcodeSrc;
+};
+
+// Times an instruction ran and the cycles it took
+struct ExecCounter {
+	uint64_t count;
+	uint64_t cycles;
+};
+
 class mos6502
 {
 private:
@@ -193,11 +212,29 @@ private:
 	typedef void (*CPUEvent)(void);
 	typedef void (*BusWrite)(uint16_t, uint8_t);
 	typedef uint8_t (*BusRead)(uint16_t);
+	typedef void (*SampleEvent)(uint16_t, uint32_t);
 	BusRead Read;
 	BusWrite Write;
 	CPUEvent Stopped;
 	BusRead Sync;
 
+	// Optional flat memory: a small RAM mirrored across the whole address space
+	// is read and written directly instead of through the callbacks.
+	// Writes to addresses matching flatWriteTrap still go to Write afterwards.
+	uint8_t *flatMem = NULL;
+	uint16_t flatMask = 0;
+	uint16_t flatWriteTrap = 0;
+	inline uint8_t MemRead(uint16_t addr) {
+		return flatMem ? flatMem[addr & flatMask] : Read(addr);
+	}
+	inline void MemWrite(uint16_t addr, uint8_t value) {
+		if(flatMem) {
+			flatMem[addr & flatMask] = value;
+			if(!(addr & flatWriteTrap)) return;
+		}
+		Write(addr, value);
+	}
+
 	// stack operations
 	inline void StackPush(uint8_t byte);
 	inline uint8_t StackPop();
@@ -219,6 +256,44 @@ public:
 	bool waiting;
 	uint16_t illegalOpcodeSrc;
 
+	// When set, time spent in WAI or in a jump/branch to itself with no
+	// interrupt pending is skipped in one step instead of executed.
+	// Leave off when Sync is used for breakpoints, the skipped fetches don't happen.
+	bool idleSkip = false;
+	// When set, every instruction's cycles are added to cycleProfile[pc & cycleProfileMask]
+	uint64_t *cycleProfile = NULL;
+	uint16_t cycleProfileMask = 0;
+	// Called when RTI executes, before it pops anything
+	CPUEvent Returned = NULL;
+	// Called when an IRQ or NMI is taken, once pc holds the handler address
+	CPUEvent IRQTaken = NULL;
+	CPUEvent NMITaken = NULL;
+	// Called when a scheduled IRQ fires, before the CPU takes it or not
+	CPUEvent IRQRaised = NULL;
+	// When sampleInterval is set, Sampled gets the address of the instruction
+	// running every sampleInterval cycles, with how many samples fell in it
+	uint32_t sampleInterval = 0;
+	uint32_t sampleCountdown = 0;
+	SampleEvent Sampled = NULL;
+	// When execOpcodes is set, every instruction is counted in
+	// execPages[address >> 13][address & 0x1FFF] and execOpcodes[opcode].
+	// The owner points the 8K pages at its counters and repoints them as banks change.
+	ExecCounter *execPages[8] = {NULL};
+	ExecCounter *execOpcodes = NULL;
+	inline void CountSampleCycles(uint16_t addr, uint32_t cycles) {
+		if(sampleInterval == 0) return;
+		if((sampleCountdown == 0) || (sampleCountdown > sampleInterval)) {
+			sampleCountdown = sampleInterval;
+		}
+		if(cycles < sampleCountdown) {
+			sampleCountdown -= cycles;
+			return;
+		}
+		cycles -= sampleCountdown;
+		sampleCountdown = sampleInterval - (cycles % sampleInterval);
+		Sampled(addr, 1 + cycles / sampleInterval);
+	}
+
 	// registers
 	uint8_t A; // accumulator
 	uint8_t X; // X-index
@@ -243,6 +318,9 @@ public:
 	void ScheduleIRQ(uint32_t cycles, bool *gate);
 	void ClearIRQ();
 	void Reset();
+	void SetFlatMemory(uint8_t *mem, uint16_t mask, uint16_t writeTrap);
+	mos6502State GetState();
+	void SetState(const mos6502State &state, bool *gate);
 	void Run(
 		int32_t cycles,
 		uint64_t& cycleCount,
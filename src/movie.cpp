@@ -0,0 +1,342 @@
+#include "movie.h"
+#include "savestate.h"
+#include "state_delta.h"
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstring>
+
+#define MOVIE_PAD1    0x01
+#define MOVIE_PAD2    0x02
+#define MOVIE_CYCLES  0x04
+#define MOVIE_SOFT    0x08
+#define MOVIE_HARD    0x10
+#define MOVIE_DIGEST  0x20
+//A byte with the top bit set stands for a run of 1-128 batches where nothing changed
+#define MOVIE_QUIET   0x80
+#define MOVIE_MAX_QUIET_RUN 128
+
+void Movie::StartRecording(uint64_t seed) {
+    this->seed = seed;
+    mode = RECORDING;
+    batch = 0;
+    length = 0;
+    stream.clear();
+    keyframes.clear();
+    pad1 = 0;
+    pad2 = 0;
+    cycles = 0;
+    digest = 0;
+    queued_reset = MOVIE_RESET_NONE;
+    quiet_run = 0;
+    desynced = false;
+}
+
+void Movie::Stop() {
+    mode = IDLE;
+    queued_reset = MOVIE_RESET_NONE;
+}
+
+void Movie::QueueReset(bool hard) {
+    queued_reset = hard ? MOVIE_RESET_HARD : MOVIE_RESET_SOFT;
+}
+
+void Movie::FlushQuietRun() {
+    if(quiet_run != 0) {
+        stream.push_back((uint8_t) (MOVIE_QUIET | (quiet_run - 1)));
+        quiet_run = 0;
+    }
+}
+
+void Movie::TakeKeyframe() {
+    FlushQuietRun();
+    Keyframe keyframe;
+    keyframe.batch = batch;
+    keyframe.stream_offset = (uint32_t) stream.size();
+    keyframe.pad1 = pad1;
+    keyframe.pad2 = pad2;
+    keyframe.cycles = cycles;
+    keyframe.digest = digest;
+    save(scratch);
+    if(keyframes.empty() || (scratch.size() != keyframes[0].data.size())) {
+        keyframe.full = true;
+        keyframe.data = scratch;
+    } else {
+        keyframe.full = false;
+        EncodeStateDelta(keyframes[0].data.data(), scratch.data(), scratch.size(), keyframe.data);
+    }
+    keyframes.push_back(std::move(keyframe));
+}
+
+//Rebuild the full state stored in a keyframe
+static void expand_keyframe(const std::vector<uint8_t>& first, const std::vector<uint8_t>& data, bool full, std::vector<uint8_t>& out) {
+    if(full) {
+        out = data;
+    } else {
+        out = first;
+        ApplyStateDelta(out.data(), data.data(), data.size());
+    }
+}
+
+//Playback reached a keyframe on its own, so the state should match it exactly
+bool Movie::CheckKeyframe() {
+    size_t index = batch / MOVIE_KEYFRAME_INTERVAL;
+    if(index >= keyframes.size()) {
+        return true;
+    }
+    const Keyframe& keyframe = keyframes[index];
+    std::vector<uint8_t> expected;
+    expand_keyframe(keyframes[0].data, keyframe.data, keyframe.full, expected);
+    save(scratch);
+    return expected == scratch;
+}
+
+bool Movie::ReadBatch() {
+    if(quiet_run != 0) {
+        --quiet_run;
+        return true;
+    }
+    if(stream_pos >= stream.size()) {
+        return false;
+    }
+    uint8_t flags = stream[stream_pos++];
+    if(flags & MOVIE_QUIET) {
+        quiet_run = flags & ~MOVIE_QUIET;
+        return true;
+    }
+    size_t needed = ((flags & MOVIE_PAD1) ? 2 : 0) + ((flags & MOVIE_PAD2) ? 2 : 0)
+        + ((flags & MOVIE_CYCLES) ? 4 : 0) + ((flags & MOVIE_DIGEST) ? 2 : 0);
+    if(needed > (stream.size() - stream_pos)) {
+        return false;
+    }
+    if(flags & MOVIE_PAD1) {
+        memcpy(&pad1, &stream[stream_pos], 2);
+        stream_pos += 2;
+    }
+    if(flags & MOVIE_PAD2) {
+        memcpy(&pad2, &stream[stream_pos], 2);
+        stream_pos += 2;
+    }
+    if(flags & MOVIE_CYCLES) {
+        memcpy(&cycles, &stream[stream_pos], 4);
+        stream_pos += 4;
+    }
+    if(flags & MOVIE_DIGEST) {
+        memcpy(&digest, &stream[stream_pos], 2);
+        stream_pos += 2;
+    }
+    if(flags & MOVIE_HARD) {
+        reset = MOVIE_RESET_HARD;
+    } else if(flags & MOVIE_SOFT) {
+        reset = MOVIE_RESET_SOFT;
+    }
+    return true;
+}
+
+//Start of a batch. Returns the reset to perform before running it.
+//When playing back, cycles is replaced by the recorded batch length.
+uint8_t Movie::BeginBatch(int32_t& cycles) {
+    reset = MOVIE_RESET_NONE;
+    read_hash = 2166136261u;
+    if(mode == RECORDING) {
+        if((batch % MOVIE_KEYFRAME_INTERVAL) == 0) {
+            TakeKeyframe();
+        }
+        reset = queued_reset;
+        queued_reset = MOVIE_RESET_NONE;
+        batch_cycles = cycles;
+    } else if(mode == PLAYING) {
+        if(((batch % MOVIE_KEYFRAME_INTERVAL) == 0) && (batch != 0) && !desynced && !CheckKeyframe()) {
+            printf("Movie desynced before batch %u (state differs from keyframe)\n", batch);
+            desynced = true;
+        }
+        if(!ReadBatch()) {
+            printf("Movie data ends early at batch %u\n", batch);
+            Stop();
+            return MOVIE_RESET_NONE;
+        }
+        cycles = this->cycles;
+        expected_digest = digest;
+    }
+    return reset;
+}
+
+void Movie::SyncButtons(uint16_t& pad1, uint16_t& pad2) {
+    if(mode == RECORDING) {
+        batch_pad1 = pad1;
+        batch_pad2 = pad2;
+    } else if(mode == PLAYING) {
+        pad1 = this->pad1;
+        pad2 = this->pad2;
+    }
+}
+
+void Movie::PortRead(uint8_t port, uint64_t cycle) {
+    uint32_t values[2] = {(uint32_t) cycle, port};
+    for(uint32_t value : values) {
+        read_hash = (read_hash ^ value) * 16777619u;
+    }
+}
+
+void Movie::EndBatch() {
+    uint16_t batch_digest = (uint16_t) (read_hash ^ (read_hash >> 16));
+    if(mode == RECORDING) {
+        uint8_t flags = 0;
+        if(batch_pad1 != pad1) flags |= MOVIE_PAD1;
+        if(batch_pad2 != pad2) flags |= MOVIE_PAD2;
+        if(batch_cycles != cycles) flags |= MOVIE_CYCLES;
+        if(batch_digest != digest) flags |= MOVIE_DIGEST;
+        if(reset == MOVIE_RESET_SOFT) flags |= MOVIE_SOFT;
+        if(reset == MOVIE_RESET_HARD) flags |= MOVIE_HARD;
+        if(flags == 0) {
+            if(++quiet_run == MOVIE_MAX_QUIET_RUN) {
+                FlushQuietRun();
+            }
+        } else {
+            FlushQuietRun();
+            StateWriter writer(stream);
+            writer.Put(flags);
+            if(flags & MOVIE_PAD1) writer.Put(batch_pad1);
+            if(flags & MOVIE_PAD2) writer.Put(batch_pad2);
+            if(flags & MOVIE_CYCLES) writer.Put(batch_cycles);
+            if(flags & MOVIE_DIGEST) writer.Put(batch_digest);
+            pad1 = batch_pad1;
+            pad2 = batch_pad2;
+            cycles = batch_cycles;
+            digest = batch_digest;
+        }
+        ++batch;
+        length = batch;
+    } else if(mode == PLAYING) {
+        if((batch_digest != expected_digest) && !desynced) {
+            printf("Movie desynced at batch %u (gamepad reads differ)\n", batch);
+            desynced = true;
+        }
+        ++batch;
+        if(batch >= length) {
+            printf("Movie finished after %u batches%s\n", length, desynced ? " (desynced)" : "");
+            Stop();
+        }
+    }
+}
+
+bool Movie::Save(const char* path) {
+    FlushQuietRun();
+    std::vector<uint8_t> out;
+    StateWriter writer(out);
+    uint32_t version = MOVIE_VERSION;
+    uint32_t interval = MOVIE_KEYFRAME_INTERVAL;
+    writer.Write(MOVIE_MAGIC, 4);
+    writer.Put(version);
+    writer.Put(seed);
+    writer.Put(interval);
+    writer.Put(length);
+    writer.Put((uint32_t) stream.size());
+    writer.Write(stream.data(), stream.size());
+    writer.Put((uint32_t) keyframes.size());
+    for(auto& keyframe : keyframes) {
+        writer.Section("KEYF");
+        writer.Put(keyframe.batch);
+        writer.Put(keyframe.stream_offset);
+        writer.Put(keyframe.pad1);
+        writer.Put(keyframe.pad2);
+        writer.Put(keyframe.cycles);
+        writer.Put(keyframe.digest);
+        writer.Put(keyframe.full);
+        writer.Put((uint32_t) keyframe.data.size());
+        writer.Write(keyframe.data.data(), keyframe.data.size());
+    }
+    writer.Section("END ");
+
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!file.is_open()) {
+        printf("Unable to write movie %s\n", path);
+        return false;
+    }
+    file.write((char*) out.data(), out.size());
+    printf("Saved movie to %s (%u batches, %zu keyframes)\n", path, length, keyframes.size());
+    return true;
+}
+
+bool Movie::Load(const char* path) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if(!file.is_open()) {
+        printf("Unable to open movie %s\n", path);
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    StateReader reader(data.data(), data.size());
+    uint32_t version = 0, interval = 0, stream_size = 0, keyframe_count = 0;
+    if(!reader.Section(MOVIE_MAGIC) || !reader.Get(version) || (version != MOVIE_VERSION)) {
+        printf("%s is not a movie this emulator can play\n", path);
+        return false;
+    }
+    reader.Get(seed);
+    reader.Get(interval);
+    reader.Get(length);
+    reader.Get(stream_size);
+    if(!reader.Ok() || (interval != MOVIE_KEYFRAME_INTERVAL) || (stream_size > data.size())) {
+        printf("Movie %s is damaged\n", path);
+        return false;
+    }
+    stream.resize(stream_size);
+    reader.Read(stream.data(), stream_size);
+    reader.Get(keyframe_count);
+    keyframes.clear();
+    for(uint32_t i = 0; (i < keyframe_count) && reader.Ok(); ++i) {
+        Keyframe keyframe;
+        uint32_t size = 0;
+        reader.Section("KEYF");
+        reader.Get(keyframe.batch);
+        reader.Get(keyframe.stream_offset);
+        reader.Get(keyframe.pad1);
+        reader.Get(keyframe.pad2);
+        reader.Get(keyframe.cycles);
+        reader.Get(keyframe.digest);
+        reader.Get(keyframe.full);
+        reader.Get(size);
+        if(!reader.Ok() || (size > data.size()) || (keyframe.stream_offset > stream_size)
+            || (keyframe.batch != (i * MOVIE_KEYFRAME_INTERVAL)) || (!keyframe.full && (i == 0))) {
+            break;
+        }
+        keyframe.data.resize(size);
+        reader.Read(keyframe.data.data(), size);
+        keyframes.push_back(std::move(keyframe));
+    }
+    if((keyframes.size() != keyframe_count) || !reader.Section("END ") || keyframes.empty()) {
+        printf("Movie %s is damaged\n", path);
+        keyframes.clear();
+        return false;
+    }
+    printf("Loaded movie %s (%u batches, seed %llu)\n", path, length, (unsigned long long) seed);
+    return Seek(0);
+}
+
+//Jump to the keyframe at or before the target batch. The caller runs the
+//remaining batches to land exactly on the target.
+bool Movie::Seek(uint32_t target) {
+    if(keyframes.empty()) {
+        return false;
+    }
+    size_t index = target / MOVIE_KEYFRAME_INTERVAL;
+    if(index >= keyframes.size()) {
+        index = keyframes.size() - 1;
+    }
+    const Keyframe& keyframe = keyframes[index];
+    expand_keyframe(keyframes[0].data, keyframe.data, keyframe.full, scratch);
+    if(!load(scratch.data(), scratch.size())) {
+        printf("Movie keyframe %zu doesn't fit the loaded ROM\n", index);
+        Stop();
+        return false;
+    }
+    batch = keyframe.batch;
+    stream_pos = keyframe.stream_offset;
+    pad1 = keyframe.pad1;
+    pad2 = keyframe.pad2;
+    cycles = keyframe.cycles;
+    digest = keyframe.digest;
+    quiet_run = 0;
+    desynced = false;
+    mode = (batch < length) ? PLAYING : IDLE;
+    return true;
+}
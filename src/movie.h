@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+#define MOVIE_MAGIC "GTEM"
+#define MOVIE_VERSION 1
+//Batches between embedded savestates, 10 seconds at normal speed
+#define MOVIE_KEYFRAME_INTERVAL 600
+
+enum MovieReset : uint8_t {
+    MOVIE_RESET_NONE,
+    MOVIE_RESET_SOFT,
+    MOVIE_RESET_HARD,
+};
+
+// Deterministic input recording and playback.
+// A movie is a list of batches, one per call to emulateCycles. Each batch stores
+// the cycles run, both gamepad masks, any reset before it, and a digest of the
+// cycles at which the game read the gamepad ports. Only fields that changed are
+// written and runs of unchanged batches collapse into a single byte.
+// Every MOVIE_KEYFRAME_INTERVAL batches a savestate is embedded (as a delta
+// against the first one) so playback can start anywhere by loading the
+// keyframe before it, without running the movie from the beginning.
+class Movie {
+public:
+    typedef void (*SaveFunc)(std::vector<uint8_t>&);
+    typedef bool (*LoadFunc)(const uint8_t*, size_t);
+    enum Mode {
+        IDLE,
+        RECORDING,
+        PLAYING,
+    };
+private:
+    struct Keyframe {
+        uint32_t batch;
+        uint32_t stream_offset;
+        uint16_t pad1;
+        uint16_t pad2;
+        int32_t cycles;
+        uint16_t digest;
+        bool full;
+        std::vector<uint8_t> data;
+    };
+
+    SaveFunc save;
+    LoadFunc load;
+    Mode mode = IDLE;
+    uint64_t seed = 0;
+    uint32_t batch = 0;
+    uint32_t length = 0;
+    std::vector<uint8_t> stream;
+    size_t stream_pos = 0;
+    std::vector<Keyframe> keyframes;
+    std::vector<uint8_t> scratch;
+
+    //values the next batch is compared against
+    uint16_t pad1 = 0;
+    uint16_t pad2 = 0;
+    int32_t cycles = 0;
+    uint16_t digest = 0;
+
+    //batch in progress
+    uint8_t reset = MOVIE_RESET_NONE;
+    uint8_t queued_reset = MOVIE_RESET_NONE;
+    uint16_t batch_pad1 = 0;
+    uint16_t batch_pad2 = 0;
+    int32_t batch_cycles = 0;
+    uint32_t read_hash = 0;
+    uint16_t expected_digest = 0;
+    uint32_t quiet_run = 0;
+    bool desynced = false;
+
+    void FlushQuietRun();
+    void TakeKeyframe();
+    bool CheckKeyframe();
+    bool ReadBatch();
+public:
+    Movie(SaveFunc save, LoadFunc load) : save(save), load(load) {};
+
+    void StartRecording(uint64_t seed);
+    bool Save(const char* path);
+    bool Load(const char* path);
+    bool Seek(uint32_t target);
+    void Stop();
+
+    uint8_t BeginBatch(int32_t& cycles);
+    void SyncButtons(uint16_t& pad1, uint16_t& pad2);
+    void PortRead(uint8_t port, uint64_t cycle);
+    void EndBatch();
+    void QueueReset(bool hard);
+
+    Mode GetMode() const { return mode; }
+    bool Recording() const { return mode == RECORDING; }
+    bool Playing() const { return mode == PLAYING; }
+    uint32_t Batch() const { return batch; }
+    uint32_t Length() const { return length; }
+    uint64_t Seed() const { return seed; }
+};
@@ -0,0 +1,130 @@
+#include "nvram_store.h"
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+
+NVRAMStore::~NVRAMStore() {
+    Close();
+#ifndef WASM_BUILD
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    if(writer.joinable()) {
+        writer.join();
+    }
+#endif
+}
+
+//Attach to a cartridge's RAM, filling it from the save file if there is one
+bool NVRAMStore::Load(uint8_t* ram, size_t size, const std::string& path) {
+    Close();
+    this->ram = ram;
+    this->size = size;
+    this->path = path;
+    dirty = false;
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if(!file.is_open()) {
+        return false;
+    }
+    printf("LOADING %s\n", path.c_str());
+    file.read((char*) ram, size);
+    return true;
+}
+
+//Write out anything outstanding and detach (ROM change)
+void NVRAMStore::Close() {
+    Flush();
+    ram = NULL;
+}
+
+void NVRAMStore::RequestSave() {
+    if((ram == NULL) || !dirty) {
+        return;
+    }
+    dirty = false;
+#ifdef WASM_BUILD
+    pending.assign(ram, ram + size);
+    WriteFile(path, pending);
+#else
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto now = std::chrono::steady_clock::now();
+        if(!has_pending) {
+            first_request = now;
+        }
+        pending.assign(ram, ram + size);
+        pending_path = path;
+        has_pending = true;
+        due = std::min(now + std::chrono::milliseconds(NVRAM_SAVE_DELAY_MS),
+            first_request + std::chrono::milliseconds(NVRAM_SAVE_MAX_DELAY_MS));
+        if(!writer.joinable()) {
+            writer = std::thread(&NVRAMStore::WriterLoop, this);
+        }
+    }
+    wake.notify_one();
+#endif
+}
+
+//Save now and wait for the file to be written
+void NVRAMStore::Flush() {
+    RequestSave();
+#ifndef WASM_BUILD
+    std::unique_lock<std::mutex> guard(lock);
+    if(!has_pending && !busy) {
+        return;
+    }
+    flush_now = true;
+    wake.notify_one();
+    idle.wait(guard, [this] { return !has_pending && !busy; });
+#endif
+}
+
+#ifndef WASM_BUILD
+void NVRAMStore::WriterLoop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while(true) {
+        wake.wait(guard, [this] { return stopping || has_pending; });
+        if(!has_pending) {
+            break;
+        }
+        while(!stopping && !flush_now && (std::chrono::steady_clock::now() < due)) {
+            wake.wait_until(guard, due);
+        }
+        std::vector<uint8_t> data;
+        data.swap(pending);
+        std::string target = pending_path;
+        has_pending = false;
+        flush_now = false;
+        busy = true;
+        guard.unlock();
+        WriteFile(target, data);
+        guard.lock();
+        busy = false;
+        idle.notify_all();
+    }
+}
+#endif
+
+void NVRAMStore::WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+    printf("SAVING %s\n", path.c_str());
+    std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!file.is_open()) {
+        printf("Unable to write %s\n", temp_path.c_str());
+        return;
+    }
+    file.write((char*) data.data(), data.size());
+    file.close();
+    if(!file) {
+        printf("Unable to write %s\n", temp_path.c_str());
+        return;
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if(error) {
+        printf("Unable to replace %s: %s\n", path.c_str(), error.message().c_str());
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+#ifndef WASM_BUILD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#endif
+
+//Quiet time after the last save request before the file is written
+#define NVRAM_SAVE_DELAY_MS 500
+//Longest a request waits when new ones keep arriving
+#define NVRAM_SAVE_MAX_DELAY_MS 5000
+
+// Write-behind saving for battery backed cartridge RAM.
+// Writes to the RAM only set a dirty flag. A save request copies the RAM and
+// hands the copy to a background thread, which waits for requests to stop
+// coming before writing, so a burst of them turns into a single write.
+// The file is written under a temporary name and renamed over the old one,
+// so an interrupted save never leaves a half written file behind.
+class NVRAMStore {
+private:
+    uint8_t* ram = NULL;
+    size_t size = 0;
+    std::string path;
+    bool dirty = false;
+
+    //handed to the writer
+    std::vector<uint8_t> pending;
+    std::string pending_path;
+    bool has_pending = false;
+#ifndef WASM_BUILD
+    std::chrono::steady_clock::time_point first_request;
+    std::chrono::steady_clock::time_point due;
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool busy = false;
+    bool flush_now = false;
+    bool stopping = false;
+    void WriterLoop();
+#endif
+
+    static void WriteFile(const std::string& path, const std::vector<uint8_t>& data);
+public:
+    ~NVRAMStore();
+    bool Load(uint8_t* ram, size_t size, const std::string& path);
+    void Close();
+    void MarkDirty() { dirty = true; }
+    void RequestSave();
+    void Flush();
+};
@@ -0,0 +1,92 @@
+#include "page_arena.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#if defined(_WIN32)
+#include <malloc.h>
+#elif !defined(WASM_BUILD)
+#include <sys/mman.h>
+#define PAGE_ARENA_MMAP
+#endif
+
+static size_t arena_alignment(size_t size) {
+    return (size >= PAGE_ARENA_HUGE_PAGE_SIZE / 4) ? PAGE_ARENA_HUGE_PAGE_SIZE : PAGE_ARENA_ALIGNMENT;
+}
+
+static size_t round_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+#ifdef PAGE_ARENA_MMAP
+
+uint8_t* AllocatePageArena(size_t size) {
+    size_t alignment = arena_alignment(size);
+    size_t length = round_up(size, alignment);
+    //over-reserve so an aligned start can be cut out of it
+    size_t reserved = length + alignment;
+    void* block = mmap(NULL, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(block == MAP_FAILED) {
+        perror("Unable to allocate emulator memory");
+        abort();
+    }
+    uintptr_t start = round_up((uintptr_t) block, alignment);
+    size_t head = start - (uintptr_t) block;
+    if(head != 0) {
+        munmap(block, head);
+    }
+    if(reserved - head - length != 0) {
+        munmap((void*) (start + length), reserved - head - length);
+    }
+#ifdef MADV_HUGEPAGE
+    if(alignment == PAGE_ARENA_HUGE_PAGE_SIZE) {
+        madvise((void*) start, length, MADV_HUGEPAGE);
+    }
+#endif
+    return (uint8_t*) start;
+}
+
+void FreePageArena(uint8_t* arena, size_t size) {
+    if(arena) {
+        munmap(arena, round_up(size, arena_alignment(size)));
+    }
+}
+
+void ClearPageArena(uint8_t* arena, size_t size) {
+    if(arena && (madvise(arena, round_up(size, PAGE_ARENA_ALIGNMENT), MADV_DONTNEED) != 0)) {
+        memset(arena, 0, size);
+    }
+}
+
+#else
+
+uint8_t* AllocatePageArena(size_t size) {
+    size_t alignment = arena_alignment(size);
+    size_t length = round_up(size, alignment);
+#ifdef _WIN32
+    uint8_t* arena = (uint8_t*) _aligned_malloc(length, alignment);
+#else
+    uint8_t* arena = (uint8_t*) aligned_alloc(alignment, length);
+#endif
+    if(!arena) {
+        printf("Unable to allocate emulator memory\n");
+        abort();
+    }
+    memset(arena, 0, length);
+    return arena;
+}
+
+void FreePageArena(uint8_t* arena, size_t size) {
+#ifdef _WIN32
+    _aligned_free(arena);
+#else
+    free(arena);
+#endif
+}
+
+void ClearPageArena(uint8_t* arena, size_t size) {
+    if(arena) {
+        memset(arena, 0, size);
+    }
+}
+
+#endif
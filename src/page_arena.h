@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#define PAGE_ARENA_ALIGNMENT 4096
+//Arenas at least this big start on a huge page boundary
+#define PAGE_ARENA_HUGE_PAGE_SIZE (2 << 20)
+
+// Zeroed, page aligned memory for large emulator buffers, kept apart from
+// the small structures the CPU touches all the time. Big arenas are aligned
+// to a huge page and, where the OS supports it, flagged so they can be backed
+// by one.
+uint8_t* AllocatePageArena(size_t size);
+void FreePageArena(uint8_t* arena, size_t size);
+//Zeroes an arena in place. Where the OS allows its pages are handed back
+//instead, so ones nothing touches again stay unbacked.
+void ClearPageArena(uint8_t* arena, size_t size);
@@ -0,0 +1,97 @@
+#include "rewind_buffer.h"
+#include "state_delta.h"
+#include <cstring>
+
+RewindBuffer::RewindBuffer(size_t budget, uint32_t interval, SaveFunc save, LoadFunc load)
+    : save(save), load(load), interval(interval ? interval : 1), arena(budget) {
+}
+
+void RewindBuffer::Clear() {
+    entries.clear();
+    head = 0;
+    has_current = false;
+    frames_since_capture = 0;
+}
+
+size_t RewindBuffer::Snapshots() const {
+    return entries.size() + (has_current ? 1 : 0);
+}
+
+size_t RewindBuffer::BytesUsed() const {
+    size_t total = current.size();
+    for(auto& entry : entries) {
+        total += entry.length;
+    }
+    return total;
+}
+
+//Entries sit in the arena in the order they were written, wrapping to the start
+//when one doesn't fit at the end, so the space a new entry needs is always
+//taken from the oldest ones.
+void RewindBuffer::Store(const std::vector<uint8_t>& delta) {
+    size_t length = delta.size();
+    if(length > arena.size()) {
+        //a single step bigger than the whole buffer, history can't reach past it
+        entries.clear();
+        head = 0;
+        return;
+    }
+    size_t offset = head;
+    if((offset + length) > arena.size()) {
+        offset = 0;
+    }
+    while(!entries.empty()) {
+        const Entry& oldest = entries.front();
+        bool overlaps = (oldest.offset < (offset + length)) && (offset < (oldest.offset + oldest.length));
+        if(!overlaps) {
+            break;
+        }
+        entries.pop_front();
+    }
+    if(length != 0) {
+        memcpy(arena.data() + offset, delta.data(), length);
+    }
+    entries.push_back({offset, length});
+    head = offset + length;
+}
+
+void RewindBuffer::FrameEnded() {
+    if(++frames_since_capture < interval) {
+        return;
+    }
+    frames_since_capture = 0;
+    save(scratch);
+    if(has_current && (scratch.size() == current.size())) {
+        EncodeStateDelta(current.data(), scratch.data(), current.size(), encoded);
+        Store(encoded);
+    } else {
+        //first snapshot, or a different ROM changed the state layout
+        entries.clear();
+        head = 0;
+    }
+    current.swap(scratch);
+    has_current = true;
+}
+
+//Go back one snapshot. If frames have run since the newest one, go back to it first.
+bool RewindBuffer::StepBack() {
+    if(!has_current) {
+        return false;
+    }
+    if(frames_since_capture == 0) {
+        if(entries.empty()) {
+            load(current.data(), current.size());
+            return false;
+        }
+        const Entry& newest = entries.back();
+        ApplyStateDelta(current.data(), arena.data() + newest.offset, newest.length);
+        head = newest.offset;
+        entries.pop_back();
+    }
+    frames_since_capture = 0;
+    if(!load(current.data(), current.size())) {
+        Clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <deque>
+
+// Keeps a bounded history of savestates for rewinding.
+// The newest snapshot is held in full. Older ones are stored as deltas
+// against the snapshot after them (see state_delta.h). Stepping back applies
+// the newest delta to the full copy. When the arena fills up the oldest deltas are dropped.
+class RewindBuffer {
+public:
+    typedef void (*SaveFunc)(std::vector<uint8_t>&);
+    typedef bool (*LoadFunc)(const uint8_t*, size_t);
+private:
+    struct Entry {
+        size_t offset;
+        size_t length;
+    };
+    SaveFunc save;
+    LoadFunc load;
+    uint32_t interval;
+    uint32_t frames_since_capture = 0;
+    std::vector<uint8_t> arena;
+    size_t head = 0; //arena offset just past the newest entry
+    std::deque<Entry> entries;
+    std::vector<uint8_t> current;
+    std::vector<uint8_t> scratch;
+    std::vector<uint8_t> encoded;
+    bool has_current = false;
+
+    void Store(const std::vector<uint8_t>& delta);
+public:
+    RewindBuffer(size_t budget, uint32_t interval, SaveFunc save, LoadFunc load);
+    void FrameEnded();
+    bool StepBack();
+    void Clear();
+    size_t Snapshots() const;
+    size_t BytesUsed() const;
+    uint32_t Interval() const { return interval; }
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Lock-free single-producer/single-consumer ring buffer.
+// Capacity must be a power of two. One thread may push while another pops.
+template <typename T, size_t Capacity>
+class RingBuffer {
+    static_assert((Capacity & (Capacity - 1)) == 0, "RingBuffer capacity must be a power of two");
+private:
+    T data[Capacity];
+    alignas(64) std::atomic<size_t> head{0}; //next slot to write, owned by producer
+    alignas(64) std::atomic<size_t> tail{0}; //next slot to read, owned by consumer
+public:
+    bool push(const T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if((h - tail.load(std::memory_order_acquire)) == Capacity) {
+            return false;
+        }
+        data[h & (Capacity - 1)] = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = data[t & (Capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return Capacity;
+    }
+
+    //Consumer side only
+    void clear() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+
+// Seeded generator for the values real hardware leaves undefined
+// (power-on memory contents, open bus reads). Unlike rand() it is owned by
+// the emulator and stored in savestates, so a run can be reproduced from its seed.
+// SplitMix64: small state, fast, and plenty random for garbage bytes.
+class Rng {
+private:
+    uint64_t state = 0;
+public:
+    void Seed(uint64_t seed) {
+        state = seed;
+    }
+
+    uint64_t Next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint8_t NextByte() {
+        return (uint8_t) (Next() >> 56);
+    }
+
+    //The byte NextByte would return, without advancing. For debugger reads.
+    uint8_t PeekByte() const {
+        Rng copy = *this;
+        return copy.NextByte();
+    }
+};
@@ -0,0 +1,123 @@
+#include "rom_image.h"
+#include <cstdio>
+#include <cstring>
+#ifdef ROM_IMAGE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef ROM_IMAGE_MMAP
+
+RomImage::RomImage() {
+    data = (uint8_t*) mmap(NULL, ROM_IMAGE_CAPACITY, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED) {
+        perror("Unable to reserve ROM memory");
+        data = NULL;
+    }
+}
+
+RomImage::~RomImage() {
+    UnmapOriginal();
+    if(data) {
+        munmap(data, ROM_IMAGE_CAPACITY);
+    }
+}
+
+void RomImage::UnmapOriginal() {
+    if(original_map) {
+        munmap(original_map, original_map_size);
+    }
+    original_map = NULL;
+    original_map_size = 0;
+    original = NULL;
+}
+
+//Builds the new image at a fresh address and only swaps it in once every
+//mapping worked, so a file that can't be opened or mapped leaves the current
+//ROM as it was.
+bool RomImage::Open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    size_t file_size = (size_t) info.st_size;
+    if(file_size > ROM_IMAGE_CAPACITY) {
+        printf("ROM is larger than %d bytes, only the start is used\n", ROM_IMAGE_CAPACITY);
+        file_size = ROM_IMAGE_CAPACITY;
+    }
+
+    void* fresh = mmap(NULL, ROM_IMAGE_CAPACITY, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(fresh == MAP_FAILED) {
+        perror("Unable to map ROM");
+        close(fd);
+        return false;
+    }
+    void* fresh_original = NULL;
+    if(file_size != 0) {
+        //MAP_FIXED only ever replaces the part of the reservation just made
+        if(mmap(fresh, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            perror("Unable to map ROM");
+            munmap(fresh, ROM_IMAGE_CAPACITY);
+            close(fd);
+            return false;
+        }
+        fresh_original = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(fresh_original == MAP_FAILED) {
+            perror("Unable to map ROM");
+            munmap(fresh, ROM_IMAGE_CAPACITY);
+            close(fd);
+            return false;
+        }
+    }
+    close(fd);
+
+    if(data) {
+        munmap(data, ROM_IMAGE_CAPACITY);
+    }
+    UnmapOriginal();
+    data = (uint8_t*) fresh;
+    original_map = fresh_original;
+    original_map_size = file_size;
+    original = (const uint8_t*) fresh_original;
+    size = file_size;
+    return true;
+}
+
+#else
+
+RomImage::RomImage() {
+    data = new uint8_t[ROM_IMAGE_CAPACITY]();
+}
+
+RomImage::~RomImage() {
+    delete[] data;
+}
+
+bool RomImage::Open(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if(!file) {
+        return false;
+    }
+    fseek(file, 0L, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+    if(file_size > ROM_IMAGE_CAPACITY) {
+        printf("ROM is larger than %d bytes, only the start is used\n", ROM_IMAGE_CAPACITY);
+        file_size = ROM_IMAGE_CAPACITY;
+    }
+    memset(data, 0, ROM_IMAGE_CAPACITY);
+    size = fread(data, sizeof(uint8_t), file_size, file);
+    fclose(file);
+    original_copy.assign(data, data + size);
+    original = original_copy.data();
+    return true;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//Largest cartridge, the 2M flash. The working image is always this big.
+#define ROM_IMAGE_CAPACITY (1 << 21)
+
+#if !defined(_WIN32) && !defined(WASM_BUILD)
+#define ROM_IMAGE_MMAP
+#endif
+
+// The cartridge ROM as the emulator sees it.
+// Where mmap is available the working image is a private mapping of the ROM
+// file, so every emulator running the same ROM shares its pages through the
+// page cache and a page is only copied when flash writes change it. A second
+// read-only mapping keeps the untouched original for flash saves to diff against.
+// The rest of the capacity past the end of the file reads as zero.
+// Opening a ROM maps it at a new address, so Data() has to be fetched again.
+// Elsewhere both are plain copies read from the file.
+class RomImage {
+private:
+    uint8_t* data = NULL;
+    const uint8_t* original = NULL;
+    size_t size = 0;
+#ifdef ROM_IMAGE_MMAP
+    void* original_map = NULL;
+    size_t original_map_size = 0;
+    void UnmapOriginal();
+#else
+    std::vector<uint8_t> original_copy;
+#endif
+public:
+    RomImage();
+    ~RomImage();
+    bool Open(const char* path);
+    uint8_t* Data() { return data; }
+    const uint8_t* Original() const { return original; }
+    size_t Size() const { return size; }
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <type_traits>
+
+#define SAVESTATE_MAGIC "GTES"
+#define SAVESTATE_VERSION 3
+
+// Binary savestate serialization.
+// Each component writes a four character section tag followed by its fields
+// in a fixed order, so a reader can tell when it has walked off the format.
+// Values are stored in host byte order, states aren't meant to move between machines.
+class StateWriter {
+private:
+    std::vector<uint8_t>& out;
+public:
+    StateWriter(std::vector<uint8_t>& out) : out(out) {};
+
+    void Write(const void* data, size_t size) {
+        const uint8_t* bytes = (const uint8_t*) data;
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    template <typename T>
+    void Put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "savestate fields must be plain data");
+        Write(&value, sizeof(T));
+    }
+
+    void Section(const char* tag) {
+        Write(tag, 4);
+    }
+};
+
+class StateReader {
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+    bool ok = true;
+public:
+    StateReader(const uint8_t* data, size_t size) : data(data), size(size) {};
+
+    bool Read(void* dest, size_t count) {
+        if(!ok || (count > (size - pos))) {
+            ok = false;
+            return false;
+        }
+        memcpy(dest, data + pos, count);
+        pos += count;
+        return true;
+    }
+
+    //Points at the next count bytes in place, NULL if there aren't that many
+    const uint8_t* Take(size_t count) {
+        if(!ok || (count > (size - pos))) {
+            ok = false;
+            return NULL;
+        }
+        const uint8_t* found = data + pos;
+        pos += count;
+        return found;
+    }
+
+    template <typename T>
+    bool Get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "savestate fields must be plain data");
+        return Read(&value, sizeof(T));
+    }
+
+    bool Section(const char* tag) {
+        char found[4];
+        if(!Read(found, 4) || (memcmp(found, tag, 4) != 0)) {
+            ok = false;
+        }
+        return ok;
+    }
+
+    bool Ok() const {
+        return ok;
+    }
+};
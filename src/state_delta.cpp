@@ -0,0 +1,82 @@
+#include "state_delta.h"
+#include <cstring>
+
+//Runs of unchanged bytes shorter than this are folded into the literal around them
+#define DELTA_MIN_SKIP 8
+
+static void put_varint(std::vector<uint8_t>& out, size_t value) {
+    while(value >= 0x80) {
+        out.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+static size_t get_varint(const uint8_t*& cursor) {
+    size_t value = 0;
+    int shift = 0;
+    uint8_t b;
+    do {
+        b = *(cursor++);
+        value |= ((size_t) (b & 0x7F)) << shift;
+        shift += 7;
+    } while(b & 0x80);
+    return value;
+}
+
+//Delta format: repeated [unchanged byte count][changed byte count][changed bytes XORed]
+void EncodeStateDelta(const uint8_t* older, const uint8_t* newer, size_t size, std::vector<uint8_t>& encoded) {
+    encoded.clear();
+    size_t i = 0;
+    while(i < size) {
+        size_t start = i;
+        while(((i + 8) <= size) && (memcmp(older + i, newer + i, 8) == 0)) {
+            i += 8;
+        }
+        while((i < size) && (older[i] == newer[i])) {
+            ++i;
+        }
+        if(i >= size) {
+            break;
+        }
+        size_t skip = i - start;
+
+        size_t literal = i;
+        size_t same = 0;
+        while(i < size) {
+            if(older[i] == newer[i]) {
+                if(++same == DELTA_MIN_SKIP) {
+                    break;
+                }
+            } else {
+                same = 0;
+            }
+            ++i;
+        }
+        size_t literal_end = (i < size) ? (i + 1 - same) : (i - same);
+        i = literal_end;
+
+        put_varint(encoded, skip);
+        put_varint(encoded, literal_end - literal);
+        size_t out = encoded.size();
+        encoded.resize(out + (literal_end - literal));
+        for(size_t k = literal; k < literal_end; ++k) {
+            encoded[out++] = older[k] ^ newer[k];
+        }
+    }
+}
+
+void ApplyStateDelta(uint8_t* state, const uint8_t* delta, size_t length) {
+    const uint8_t* cursor = delta;
+    const uint8_t* end = delta + length;
+    uint8_t* pos = state;
+    while(cursor < end) {
+        pos += get_varint(cursor);
+        size_t count = get_varint(cursor);
+        for(size_t k = 0; k < count; ++k) {
+            pos[k] ^= cursor[k];
+        }
+        pos += count;
+        cursor += count;
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Compact difference between two savestates of the same size.
+// The delta is the XOR of the two states, run-length encoded so the bytes that
+// didn't change cost almost nothing. Applying a delta to either state gives the other.
+void EncodeStateDelta(const uint8_t* older, const uint8_t* newer, size_t size, std::vector<uint8_t>& out);
+void ApplyStateDelta(uint8_t* state, const uint8_t* delta, size_t length);
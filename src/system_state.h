@@ -1,5 +1,7 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
+#include "page_arena.h"
 
 const int RAMSIZE = 32768;
 const int CARTRAMSIZE = 32768;
@@ -7,6 +9,11 @@ const int FRAME_BUFFER_SIZE = 16384;
 
 #define VRAM_BUFFER_SIZE (FRAME_BUFFER_SIZE*2)
 #define GRAM_BUFFER_SIZE (FRAME_BUFFER_SIZE*32)
+#define VIDEO_ARENA_SIZE (VRAM_BUFFER_SIZE + GRAM_BUFFER_SIZE)
+//vram frames come first, then gram
+#define VIDEO_FRAME_COUNT (VIDEO_ARENA_SIZE / FRAME_BUFFER_SIZE)
+
+#define CACHE_LINE_SIZE 64
 
 #define BANK_GRAM_MASK  0b00000111
 #define BANK_VRAM_MASK  0b00001000
@@ -22,20 +29,50 @@ enum RomType {
 	FLASH2M_RAM32K,
 };
 
-struct SystemState {
+// Console state, laid out for the CPU's sake.
+// The registers share the first cache line and RAM starts on the next one,
+// so everything touched per instruction sits in one compact block. Video
+// memory is 544K the CPU only reaches through DMA and lives in its own page
+// aligned arena, allocated once; vram and gram never move.
+// video_dirty has a bit per 16K frame of the arena that was replaced behind
+// the display surfaces' back (loading a state) and still has to be redrawn.
+struct alignas(CACHE_LINE_SIZE) SystemState {
     uint8_t dma_control;
     bool dma_control_irq;
     uint8_t banking;
+    uint8_t VIA_regs[16];
 
-    uint8_t ram[RAMSIZE];
-    bool ram_initialized[RAMSIZE];
+    uint8_t* vram;
+    uint8_t* gram;
+    uint64_t video_dirty = 0;
 
-    uint8_t vram[VRAM_BUFFER_SIZE];
-    uint8_t gram[GRAM_BUFFER_SIZE];
-    
-    uint8_t VIA_regs[16];
+    alignas(CACHE_LINE_SIZE) uint8_t ram[RAMSIZE];
+    //one bit per RAM byte, set by the first write
+    uint64_t ram_initialized[RAMSIZE / 64];
+
+    SystemState() {
+        vram = AllocatePageArena(VIDEO_ARENA_SIZE);
+        gram = vram + VRAM_BUFFER_SIZE;
+    }
+    ~SystemState() {
+        FreePageArena(vram, VIDEO_ARENA_SIZE);
+    }
+    SystemState(const SystemState&) = delete;
+    SystemState& operator=(const SystemState&) = delete;
+
+    bool RamInitialized(uint32_t address) const {
+        return (ram_initialized[address >> 6] >> (address & 63)) & 1;
+    }
+    void MarkRamInitialized(uint32_t address) {
+        ram_initialized[address >> 6] |= (1ull << (address & 63));
+    }
+    void ClearRamInitialized() {
+        memset(ram_initialized, 0, sizeof(ram_initialized));
+    }
 };
 
+static_assert(VIDEO_FRAME_COUNT <= 64, "video_dirty has a bit per frame");
+
 struct CartridgeState
 {
     int size = 8192;
@@ -0,0 +1,104 @@
+#include "wav_writer.h"
+#include <cstring>
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+WavWriter::WavWriter(const char* path, int sample_rate) : sample_rate(sample_rate) {
+    file = fopen(path, "wb");
+    if(!file) {
+        printf("Unable to open %s for writing\n", path);
+        return;
+    }
+    WriteHeader(0);
+    pending.reserve(WAV_WRITER_BLOCK_SAMPLES);
+    writer = std::thread(&WavWriter::WriterThread, this);
+}
+
+WavWriter::~WavWriter() {
+    Close();
+}
+
+bool WavWriter::IsOpen() {
+    return file != NULL;
+}
+
+void WavWriter::WriteHeader(uint32_t data_bytes) {
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    put32(header + 4, 36 + data_bytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put32(header + 16, 16);              //fmt chunk size
+    put16(header + 20, 1);               //PCM
+    put16(header + 22, 1);               //mono
+    put32(header + 24, sample_rate);
+    put32(header + 28, sample_rate * 2); //byte rate
+    put16(header + 32, 2);               //block align
+    put16(header + 34, 16);              //bits per sample
+    memcpy(header + 36, "data", 4);
+    put32(header + 40, data_bytes);
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), file);
+}
+
+void WavWriter::Write(const int16_t* samples, size_t count) {
+    if(!file) return;
+    pending.insert(pending.end(), samples, samples + count);
+    if(pending.size() >= WAV_WRITER_BLOCK_SAMPLES) {
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            queue.emplace_back(std::move(pending));
+        }
+        queue_ready.notify_one();
+        pending = std::vector<int16_t>();
+        pending.reserve(WAV_WRITER_BLOCK_SAMPLES);
+    }
+}
+
+void WavWriter::WriterThread() {
+    std::unique_lock<std::mutex> guard(queue_lock);
+    while(true) {
+        queue_ready.wait(guard, [this] { return closing || !queue.empty(); });
+        while(!queue.empty()) {
+            std::vector<int16_t> block = std::move(queue.front());
+            queue.pop_front();
+            guard.unlock();
+            //PCM samples are little-endian, same as every host we build for
+            fwrite(block.data(), sizeof(int16_t), block.size(), file);
+            samples_written += block.size();
+            guard.lock();
+        }
+        if(closing) break;
+    }
+}
+
+void WavWriter::Close() {
+    if(!file) return;
+    {
+        std::lock_guard<std::mutex> guard(queue_lock);
+        if(!pending.empty()) {
+            queue.emplace_back(std::move(pending));
+        }
+        closing = true;
+    }
+    queue_ready.notify_one();
+    if(writer.joinable()) {
+        writer.join();
+    }
+    WriteHeader(samples_written * sizeof(int16_t));
+    fclose(file);
+    file = NULL;
+}
+
+uint64_t WavWriter::SamplesWritten() {
+    return samples_written;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#define WAV_WRITER_BLOCK_SAMPLES 65536
+
+// Streams 16-bit mono PCM to a .wav file.
+// Samples are batched on the calling thread and written out by a background
+// thread, so rendering never waits on disk.
+class WavWriter {
+private:
+    FILE* file = NULL;
+    int sample_rate;
+    uint64_t samples_written = 0;
+    std::vector<int16_t> pending;
+    std::deque<std::vector<int16_t>> queue;
+    std::mutex queue_lock;
+    std::condition_variable queue_ready;
+    std::thread writer;
+    bool closing = false;
+    void WriterThread();
+    void WriteHeader(uint32_t data_bytes);
+public:
+    WavWriter(const char* path, int sample_rate);
+    ~WavWriter();
+    bool IsOpen();
+    void Write(const int16_t* samples, size_t count);
+    void Close();
+    uint64_t SamplesWritten();
+};